@@ -1,18 +1,115 @@
 #include "ILI9341.h"
-#include <chrono>
+#include <algorithm>
+#include <climits>
+#include <cmath>
 #include <cstdarg>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#if ILI9341_STATS
+#define ILI9341_COUNT(field, amount) countStat(&ILI9341BusStats::field, amount)
+#define ILI9341_PRIMITIVE(primitive) StatsScope statsScope(*this, primitive)
+#else
+#define ILI9341_COUNT(field, amount)
+#define ILI9341_PRIMITIVE(primitive)
+#endif
+
+#if defined(__MBED__)
+/*
+  ILI9341(PinName, PinName, PinName, PinName, PinName, PinName) initializes class and all needed pins for ILI9341 Display.
+*/
+ILI9341::ILI9341(PinName mosi, PinName miso, PinName clk, PinName cs, PinName rst, PinName dc)
+{
+  ownedBus = new ILI9341MbedBus(mosi, miso, clk, cs, rst, dc);
+  bus = ownedBus;
+  init();
+}
+#endif
+
+/*
+  ILI9341(ILI9341Bus&) initializes class for a display connected through any ILI9341Bus implementation.
+*/
+ILI9341::ILI9341(ILI9341Bus& bus) : bus(&bus), ownedBus(NULL)
+{
+  init();
+}
 
 /*
-  ILI9341(SPI*, PinName, PinName, PinName) initializes class and all needed pins for ILI9341 Display.
+  void init(void) sets the driver state shared by all constructors.
 */
-ILI9341::ILI9341(PinName mosi, PinName miso, PinName clk, PinName cs, PinName rst, PinName dc) : spi(mosi, miso, clk), chipSelect(cs), reset(rst), dataCommand(dc)
+void ILI9341::init(void)
 {
+  initState = INIT_IDLE;
+  initTable = NULL;
+  initIndex = 0;
+  panelAwake = false;
+#if defined(__MBED__)
+  initQueue = NULL;
+#endif
   orientation = 0;
   width = ILI9341_TFTWIDTH;
   height = ILI9341_TFTHEIGHT;
+  scrollTop = 0;
+  scrollHeight = ILI9341_TFTHEIGHT;
+  scrollOffset = 0;
+  activeBuffer = 0;
+  asyncMode = false;
+  selected = false;
+  batchDepth = 0;
+  queueBuffer = NULL;
+  queueLength = 0;
+  canvas = NULL;
+  dirtyCount = 0;
+  flushingCanvas = false;
+
+  windowValid = false;
+  skippedCommands = 0;
+  yieldBytes = ILI9341_YIELD_BYTES;
+  holdBytes = 0;
+  resetClip();
+#if ILI9341_STATS
+  currentPrimitive = ILI9341_PRIMITIVE_OTHER;
+  resetStats();
+#endif
+
+  for(auto i = 0; i < ILI9341_GLYPH_CACHE_ENTRIES; i++)
+  {
+    glyphCache[i].pixels = NULL;
+  }
+  glyphCacheBudget = 0;
+  glyphCacheUsed = 0;
+  glyphCacheClock = 0;
+  glyphCacheHits = 0;
+  glyphCacheMisses = 0;
+}
+
+/*
+  ~ILI9341() releases the glyph cache and the bus created by the pin constructor.
+*/
+ILI9341::~ILI9341()
+{
+  setGlyphCacheBudget(0);
+  bus->waitIdle();
+  delete ownedBus;
 }
 
+#define ILI9341_MADCTL_ROTATION_0   (ILI9341_MADCTL_MX | ILI9341_MADCTL_BGR)
+
+// MADCTL value and logical size of each rotation (the glass of the module is mirrored in X)
+static constexpr struct
+{
+  uint8_t madctl;
+  uint16_t width;
+  uint16_t height;
+} rotations[4] =
+{
+  {ILI9341_MADCTL_ROTATION_0, ILI9341_TFTWIDTH, ILI9341_TFTHEIGHT},
+  {ILI9341_MADCTL_MV | ILI9341_MADCTL_BGR, ILI9341_TFTHEIGHT, ILI9341_TFTWIDTH},
+  {ILI9341_MADCTL_MY | ILI9341_MADCTL_BGR, ILI9341_TFTWIDTH, ILI9341_TFTHEIGHT},
+  {ILI9341_MADCTL_MX | ILI9341_MADCTL_MY | ILI9341_MADCTL_MV | ILI9341_MADCTL_BGR, ILI9341_TFTHEIGHT, ILI9341_TFTWIDTH}
+};
+
 // ILI9341 initialization commands (Source: https://github.com/adafruit/Adafruit_ILI9341/blob/master/Adafruit_ILI9341.cpp)
 static const uint8_t initCommands[] = 
 {
@@ -27,16 +124,16 @@ static const uint8_t initCommands[] =
   ILI9341_PWCTR2, 1, 0x10,
   ILI9341_VMCTR1, 2, 0x3E, 0x28,
   ILI9341_VMCTR2, 1, 0x86,
-  ILI9341_MADCTL, 1, (ILI9341_MADCTL_MX | ILI9341_MADCTL_BGR),
+  ILI9341_MADCTL, 1, ILI9341_MADCTL_ROTATION_0,
   ILI9341_VSCRSADD, 1, 0x00,
-  ILI9341_PIXFMT, 1, 0x55,
+  ILI9341_PIXFMT, 1, ILI9341Pixel::colmod,
   ILI9341_FRMCTR1, 2, 0x00, 0x18,
   ILI9341_DFUNCTR, 3, 0x08, 0x82, 0x27,
   0xF2, 1, 0x00,
   ILI9341_GAMMASET, 1, 0x01,
   ILI9341_GMCTRP1, 15, 0x0F, 0x31, 0x2B, 0x0C, 0x0E, 0x08, 0x4E, 0xF1, 0x37, 0x07, 0x10, 0x03, 0x0E, 0x09, 0x00,
   ILI9341_GMCTRN1, 15, 0x00, 0x0E, 0x14, 0x03, 0x11, 0x07, 0x31, 0xC1, 0x48, 0x08, 0x0F, 0x0C, 0x31, 0x36, 0x0F,
-  ILI9341_SLPOUT, 0x00,
+  ILI9341_SLPOUT, ILI9341_INIT_DELAY, 5,  // Supply and clock settle time before the next command
   ILI9341_DISPON, 0x00,
   0x00 
 };
@@ -159,432 +256,2007 @@ static const unsigned char font[] =
 };
 
 /*
-  void initialize(void) executes initialization commands for ILI9341 chip.
+  void initialize(const uint8_t*) resets the display and sends an init table (NULL = the built-in one), blocking for
+  the delays in between. See beginInitialize for the steps.
 */
-void ILI9341::initialize(void)
+void ILI9341::initialize(const uint8_t* table)
 {
-  spi.format(8, 3);
-  spi.frequency(40000000);
-  chipSelect = 1;
-  dataCommand = 1;
-  
-  reset = 1;
-  ThisThread::sleep_for(chrono::milliseconds(5));
-  reset = 0;
-  ThisThread::sleep_for(chrono::milliseconds(20));
-  reset = 1;
-  ThisThread::sleep_for(chrono::milliseconds(150));
-  
-  // Execute initialization commands for IL9341 chip
-  uint8_t index = 0x00;
-  uint8_t cmd = 0x00;
-  uint8_t numArgs = 0x00;
-  while((cmd = initCommands[index++]) > 0x00)
-  {
-    numArgs = initCommands[index++];
-
-    writeCommand(cmd);
-
-    if(numArgs == 0x00)
-    {
-      ThisThread::sleep_for(chrono::milliseconds(150));
-    }
-    else
-    {
-      uint8_t oldIndex = index;
-      for(; index < oldIndex + numArgs; index++)
-      {
-        spi.write(initCommands[index]);
-      }
-    }
+  uint32_t ms;
 
-    chipSelect = 1; 
+  beginInitialize(table);
+  while((ms = initializeStep()) > 0)
+  {
+    bus->delay(ms);
   }
 }
 
+#if defined(__MBED__)
 /*
-  void setAddrWindow(uint16_t, uint16_t, uint16_t, uint16_t) define an area to recieve a stream of pixels.
+  void initialize(EventQueue&, Callback<void()>, const uint8_t*) runs the initialization as events on queue, so the
+  caller continues while the display waits out its delays. ready is called from the queue once the display can be
+  drawn on. Nothing else may use the display before that.
 */
-void ILI9341::setAddrWindow(uint16_t x, uint16_t y, uint16_t w, uint16_t h)
+void ILI9341::initialize(EventQueue& queue, Callback<void()> ready, const uint8_t* table)
 {
-  uint16_t x2 = (x + w - 1);
-  uint16_t y2 = (y + h - 1);
-
-  writeCommand(ILI9341_CASET);  // Column address set
-
-  spi.format(16, 3);
-  spi.write(x);
-  spi.write(x2);
-  spi.format(8, 3);
-  chipSelect = 1;
-
-  writeCommand(ILI9341_PASET);  // Row address set
-
-  spi.format(16, 3);
-  spi.write(y);
-  spi.write(y2);
-  spi.format(8, 3);
-  chipSelect = 1;
-
-  writeCommand(ILI9341_RAMWR);  // Write to RAM
+  initQueue = &queue;
+  initReady = ready;
+  beginInitialize(table);
+  queue.call(this, &ILI9341::initializeEvent);
 }
 
 /*
-  void writeCommand(uint8_t) writes a ILI9341 command via SPI.
+  void initializeEvent(void) runs the next initialization step and schedules the one after it.
 */
-void ILI9341::writeCommand(uint8_t cmd)
+void ILI9341::initializeEvent(void)
 {
-  dataCommand = 0;
-  chipSelect = 0;
-  spi.write(cmd);
-  dataCommand = 1;
+  uint32_t ms = initializeStep();
+
+  if(ms > 0)
+  {
+    initQueue->call_in(chrono::milliseconds(ms), this, &ILI9341::initializeEvent);
+  }
+  else if(initReady)
+  {
+    initReady();
+  }
 }
+#endif
 
 /*
-  void drawPixel(uint16_t, uint16_t, uint16_t) draws a pixel with a specific color on the display.
+  void beginInitialize(const uint8_t*) starts the initialization state machine with an init table (NULL = the built-in
+  one, see ILI9341_INIT_DELAY for the format). The driver state is reset to rotation 0 without scrolling; the steps
+  are then run by initializeStep: a 1 ms reset pulse, the reset recovery time (ILI9341_RESET_MS, or 120 ms if this
+  driver woke the panel before) and the table with the delays it asks for.
 */
-void ILI9341::drawPixel(uint16_t x, uint16_t y, uint16_t color)
+void ILI9341::beginInitialize(const uint8_t* table)
 {
-  setAddrWindow(x, y, 1, 1);
+  ILI9341_PRIMITIVE(ILI9341_PRIMITIVE_INITIALIZE);
+
+  bus->begin();
+  ILI9341_COUNT(formatSwitches, 1);
+  selected = false;
 
-  spi.format(16, 3);
-  spi.write(color);
-  spi.format(8, 3);
+  invalidateWindow();
+  scrollTop = 0;
+  scrollHeight = ILI9341_TFTHEIGHT;
+  scrollOffset = 0;
+  orientation = 0;
+  width = ILI9341_TFTWIDTH;
+  height = ILI9341_TFTHEIGHT;
+  resetClip();
 
-  chipSelect = 1;
+  initTable = (table != NULL) ? table : initCommands;
+  initIndex = 0;
+  initState = INIT_RESET;
 }
 
 /*
-  void drawVLine(uint16_t, uint16_t, uint16_t, uint16_t) draws a vertical line on the display.
+  uint32_t initializeStep(void) runs the initialization until the next delay and returns its length in milliseconds.
+  The next call must not come earlier. Returns 0 once the display is ready.
 */
-void ILI9341::drawVLine(uint16_t x, uint16_t y, uint16_t h, uint16_t color)
+uint32_t ILI9341::initializeStep(void)
 {
-  setAddrWindow(x, y, 1, h);
+  ILI9341_PRIMITIVE(ILI9341_PRIMITIVE_INITIALIZE);
 
-  spi.format(16, 3);
-  for(auto i = 0; i < h; i++)
+  switch(initState)
   {
-    spi.write(color);
+    case INIT_RESET:
+      bus->setReset(0);
+      initState = INIT_WAKE;
+      return 1;                     // The reset pulse needs at least 10 us
+
+    case INIT_WAKE:
+      bus->setReset(1);
+      initState = INIT_COMMANDS;
+      return panelAwake ? 120 : ILI9341_RESET_MS;
+
+    case INIT_COMMANDS:
+      while(initTable[initIndex] != 0x00)
+      {
+        uint8_t cmd = initTable[initIndex++];
+        uint8_t count = initTable[initIndex++];
+        uint8_t numArgs = count & ~ILI9341_INIT_DELAY;
+
+        writeCommand(cmd);
+        if(numArgs > 0x00)
+        {
+          writeData(&initTable[initIndex], numArgs);
+          initIndex += numArgs;
+        }
+        endTransaction();
+
+        if(cmd == ILI9341_SLPOUT)
+        {
+          panelAwake = true;
+        }
+
+        // The bus is released during the delay, so a shared bus stays usable for other devices
+        if((count & ILI9341_INIT_DELAY) && (initTable[initIndex++] > 0))
+        {
+          return initTable[initIndex - 1];
+        }
+      }
+      initState = INIT_DONE;
+      return 0;
+
+    default:
+      return 0;
   }
-  spi.format(8, 3);
+}
 
-  chipSelect = 1;
+/*
+  bool isInitialized(void) returns true once the initialization has finished.
+*/
+bool ILI9341::isInitialized(void)
+{
+  return initState == INIT_DONE;
 }
 
 /*
-  void drawHLine(uint16_t, uint16_t, uint16_t, uint16_t) draws a horizontal line on the display.
+  void setWindow(uint16_t, uint16_t, uint16_t, uint16_t) programs the inclusive column/row ranges of the address
+  window, leaving out the ranges the controller already holds.
 */
-void ILI9341::drawHLine(uint16_t x, uint16_t y, uint16_t w, uint16_t color)
+void ILI9341::setWindow(uint16_t x, uint16_t y, uint16_t x2, uint16_t y2)
 {
-  setAddrWindow(x, y, w, 1);
+  // Only program the column/row ranges that differ from the window already set in the controller
+  if(windowValid && (x == windowX0) && (x2 == windowX1))
+  {
+    skippedCommands++;
+  }
+  else
+  {
+    writeCommand(ILI9341_CASET);  // Column address set
+
+    uint8_t range[4] = {(uint8_t)(x >> 8), (uint8_t)(x & 0xFF), (uint8_t)(x2 >> 8), (uint8_t)(x2 & 0xFF)};
+    writeData(range, 4);
+
+    windowX0 = x;
+    windowX1 = x2;
+  }
 
-  spi.format(16, 3);
-  for(auto i = 0; i < w; i++)
+  if(windowValid && (y == windowY0) && (y2 == windowY1))
   {
-    spi.write(color);
+    skippedCommands++;
+  }
+  else
+  {
+    writeCommand(ILI9341_PASET);  // Row address set
+
+    uint8_t range[4] = {(uint8_t)(y >> 8), (uint8_t)(y & 0xFF), (uint8_t)(y2 >> 8), (uint8_t)(y2 & 0xFF)};
+    writeData(range, 4);
+
+    windowY0 = y;
+    windowY1 = y2;
   }
-  spi.format(8, 3);
 
-  chipSelect = 1;
+  windowValid = true;
 }
 
 /*
-  void setRotation(uint8_t) sets rotation of display (input from 0-4)
+  void setAddrWindow(uint16_t, uint16_t, uint16_t, uint16_t) define an area to recieve a stream of pixels.
+  The chip select stays asserted so the window can be filled with writePixels/writeColor followed by endWrite.
+  The ranges are sent as bytes, so the SPI format never has to change, and the chip select stays asserted
+  from CASET to the end of the pixel data.
 */
-void ILI9341::setRotation(uint8_t rot)
+void ILI9341::setAddrWindow(uint16_t x, uint16_t y, uint16_t w, uint16_t h)
 {
-  uint8_t rotation = rot % 4;
+  ILI9341_PRIMITIVE(ILI9341_PRIMITIVE_PIXEL_STREAM);
 
-  writeCommand(ILI9341_MADCTL);
-  switch(rotation)
+  uint16_t x2 = (x + w - 1);
+  uint16_t y2 = (y + h - 1);
+
+  if(canvasActive())
   {
-    case 0:
-      spi.write(ILI9341_MADCTL_MX | ILI9341_MADCTL_BGR);
-      width = ILI9341_TFTWIDTH;
-      height = ILI9341_TFTHEIGHT;
-      break;
-    case 1:
-      spi.write(ILI9341_MADCTL_MV | ILI9341_MADCTL_BGR);
-      width = ILI9341_TFTHEIGHT;
-      height = ILI9341_TFTWIDTH;
-      break;
-    case 2:
-      spi.write(ILI9341_MADCTL_MY | ILI9341_MADCTL_BGR);
-      width = ILI9341_TFTWIDTH;
-      height = ILI9341_TFTHEIGHT;
-      break;
-    case 3:
-      spi.write(ILI9341_MADCTL_MX | ILI9341_MADCTL_MY | ILI9341_MADCTL_MV | ILI9341_MADCTL_BGR);
-      width = ILI9341_TFTHEIGHT;
-      height = ILI9341_TFTWIDTH;
-      break;
+    canvasWindow = {x, y, x2, y2};
+    canvasCursorX = x;
+    canvasCursorY = y;
+    markDirty(canvasWindow);
+    return;
   }
 
-  chipSelect = 1;
+  setWindow(x, y, x2, y2);
+  writeCommand(ILI9341_RAMWR);  // Write to RAM
+  ILI9341_COUNT(windowSetups, 1);
 }
 
 /*
-  void drawRectangle(uint16_t, uint16_t, uint16_t, uint16_t, uint16_t) draws a rectangle on the display.
+  void pauseWrite(void) releases the chip select in the middle of a pixel stream, e.g. to let another device on a
+  shared bus read the data to be drawn next. Unlike endWrite() it leaves open batches alone, so the bus is freed
+  even inside the caller's startWrite/endWrite. Resume the stream with continueWrite().
 */
-void ILI9341::drawRectangle(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t color)
+void ILI9341::pauseWrite(void)
 {
-  drawHLine(x, y, w, color);
-  drawHLine(x, y + h - 1, w, color);
-  drawVLine(x, y, h, color);
-  drawVLine(x + w - 1, y, h, color);
+  ILI9341_PRIMITIVE(ILI9341_PRIMITIVE_PIXEL_STREAM);
+
+  if(selected)
+  {
+    selectBus(false);
+  }
 }
 
 /*
-  void fillRectangle(uint16_t, uint16_t, uint16_t, uint16_t, uint16_t) draws a filled rectangle on the display. 
+  void continueWrite(void) resumes a pixel stream that was paused with pauseWrite(). The chip select is asserted
+  again and RAMWRCONT continues the memory write where it stopped; nothing else may be sent to the display in
+  between.
 */
-void ILI9341::fillRectangle(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t color)
+void ILI9341::continueWrite(void)
 {
-  setAddrWindow(x, y, w, h);
+  ILI9341_PRIMITIVE(ILI9341_PRIMITIVE_PIXEL_STREAM);
 
-  spi.format(16, 3);
-  for(auto i = 0; i < h; i++)
+  if(canvasActive())
   {
-    for(auto j = 0; j < w; j++)
-    {
-      spi.write(color);
-    }
+    return;                       // The canvas keeps its own write position
   }
-  spi.format(8, 3);
 
-  chipSelect = 1;
+  writeCommand(ILI9341_RAMWRCONT);  // Continue memory write
 }
 
 /*
-  void fillBackground(uint16_t) fills the background of the display with a specific color.
-  While sending color pixels display will be turned off so that the long drawing animation 
-  will not be shown.
+  void readPixels(uint16_t, uint16_t, uint16_t, uint16_t, uint16_t*) reads a w * h area back into out as RGB565,
+  row by row. The controller answers RAMRD with a dummy byte and 18-bit pixels (one left aligned byte per color
+  component), which are read in line buffer sized blocks at the slower read clock and packed back into RGB565.
+  In canvas mode areas inside the canvas are copied from the canvas. Parts outside the screen are left untouched.
 */
-void ILI9341::fillBackground(uint16_t color)
+void ILI9341::readPixels(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t* out)
 {
-  writeCommand(ILI9341_DISPOFF);
-  fillRectangle(0, 0, width, height, color);
-  writeCommand(ILI9341_DISPON);
-}
+  ILI9341_PRIMITIVE(ILI9341_PRIMITIVE_READ_PIXELS);
 
-/*
-  void drawCircleHelper(uint16_t, uint16_t, uint16_t, uint8_t, uint16_t) draws a circle (corners are selectable)
-  using Bresenham algorythm.
+  if((x >= width) || (y >= height) || (w == 0) || (h == 0))
+  {
+    return;
+  }
 
-  Source: https://www.geeksforgeeks.org/bresenhams-circle-drawing-algorithm/
-*/
-void ILI9341::drawCircleHelper(uint16_t xc, uint16_t yc, uint16_t r, uint8_t corners, uint16_t color)
-{
-  int16_t x = 0;
-  int16_t y = r;
-  int16_t d = 3 - 2 * r;
+  uint16_t stride = w;
+  w = std::min<uint16_t>(w, width - x);
+  h = std::min<uint16_t>(h, height - y);
 
-  while(y >= x)
+  if(canvasActive() && (x >= canvasArea.x0) && (x + w - 1 <= canvasArea.x1) && (y >= canvasArea.y0) && (y + h - 1 <= canvasArea.y1))
   {
-    x++;
+    uint16_t canvasWidth = canvasArea.x1 - canvasArea.x0 + 1;
 
-    if(d > 0)
-    {
-      y--;
-      d = d + 4 * (x - y) + 10;
-    }
-    else
+    for(uint16_t row = 0; row < h; row++)
     {
-      d = d + 4 * x + 6;
+      memcpy(&out[row * stride], &canvas[(y + row - canvasArea.y0) * canvasWidth + (x - canvasArea.x0)], w * sizeof(uint16_t));
     }
+    return;
+  }
 
-    if(corners & 0x01)
-    {
-      drawPixel(xc - y, yc - x, color);
-      drawPixel(xc - x, yc - y, color);
-    }
-    if(corners & 0x02)
-    {
-      drawPixel(xc + x, yc - y, color);
-      drawPixel(xc + y, yc - x, color);
-    }
-    if(corners & 0x04)
+  flushQueue();
+  waitIdle();
+
+  setWindow(x, y, x + w - 1, y + h - 1);
+  writeCommand(ILI9341_RAMRD);
+  bus->setReadMode(true);
+  ILI9341_COUNT(formatSwitches, 1);
+
+  uint8_t* buffer = lineBuffer[activeBuffer];
+  const size_t blockPixels = sizeof(lineBuffer[0]) / 3;
+  size_t remaining = (size_t)w * h;
+  uint16_t column = 0;
+  uint16_t* dst = out;
+
+  readData(buffer, 1);  // Dummy byte
+
+  while(remaining > 0)
+  {
+    size_t count = std::min(remaining, blockPixels);
+    const uint8_t* src = buffer;
+
+    if(yieldDue())
     {
-      drawPixel(xc + x, yc + y, color);
-      drawPixel(xc + y, yc + x, color);
+      yieldBus(ILI9341_RAMRDCONT);
+      readData(buffer, 1);  // Dummy byte
     }
-    if(corners & 0x08)
+
+    readData(buffer, count * 3);
+    for(size_t i = 0; i < count; i++)
     {
-      drawPixel(xc - y, yc + x, color);
-      drawPixel(xc - x, yc + y, color);
+      *dst++ = ((src[0] & 0xF8) << 8) | ((src[1] & 0xFC) << 3) | (src[2] >> 3);
+      src += 3;
+
+      if(++column == w)
+      {
+        column = 0;
+        dst += stride - w;
+      }
     }
+    remaining -= count;
   }
+
+  bus->setReadMode(false);
+  ILI9341_COUNT(formatSwitches, 1);
+  endTransaction();
 }
 
 /*
-  void drawCircle(uint16_t, uint16_t, uint16_t, uint16_t) draws a circle to the display.
+  uint16_t getWidth(void) returns the width of the display in the current rotation.
 */
-void ILI9341::drawCircle(uint16_t xc, uint16_t yc, uint16_t r, uint16_t color)
+uint16_t ILI9341::getWidth(void)
 {
-  drawCircleHelper(xc, yc, r, 0xF, color);
+  return width;
 }
 
 /*
-  void fillCircleHelper(uint16_t, uint16_t, uint16_t, uint8_t, uint16_t) draws a filled circle 
-  (top half and bottom half are selectable) using Bresenham algorythm.
-
-  Source: https://www.geeksforgeeks.org/bresenhams-circle-drawing-algorithm/
+  uint16_t getHeight(void) returns the height of the display in the current rotation.
 */
-void ILI9341::fillCircleHelper(uint16_t xc, uint16_t yc, uint16_t r, uint8_t corners, uint16_t color)
+uint16_t ILI9341::getHeight(void)
 {
-  int16_t x = 0;
-  int16_t y = r;
-  int16_t d = 3 - 2 * r;
-
-  while(y >= x)
-  {
-    x++;
-
-    if(d > 0)
-    {
-      y--;
-      d = d + 4 * (x - y) + 10;
-    }
-    else
-    {
-      d = d + 4 * x + 6;
-    }
+  return height;
+}
 
-    if(corners & 0x01)
-    {
-      drawVLine(xc + x, yc - y, 2 * y, color);
-      drawVLine(xc + y, yc - x, 2 * x, color);
-    }
-    if(corners & 0x02)
-    {
-      drawVLine(xc - x, yc - y, 2 * y, color);
-      drawVLine(xc - y, yc - x, 2 * x, color);
-    }
-  }
+/*
+  uint32_t getSkippedCommands(void) returns the number of CASET/PASET commands that setAddrWindow left out
+  because the controller already held the same range.
+*/
+uint32_t ILI9341::getSkippedCommands(void)
+{
+  return skippedCommands;
 }
 
 /*
-  void fillCircle(uint16_t, uint16_t, uint16_t, uint16_t) draws a filled circle to the display.
+  void setYieldBytes(uint32_t) sets how many bytes may be sent on a shared bus before the chip select is released
+  for other devices (default ILI9341_YIELD_BYTES, 0 = hold the bus for whole primitives and batches). A smaller
+  value lowers the latency the display imposes on other devices at the cost of more bus reconfigurations.
 */
-void ILI9341::fillCircle(uint16_t xc, uint16_t yc, uint16_t r, uint16_t color)
+void ILI9341::setYieldBytes(uint32_t bytes)
 {
-  drawVLine(xc, yc - r, 2 * r, color);
-  fillCircleHelper(xc, yc, r, 0x03, color);
+  yieldBytes = bytes;
 }
 
+#if ILI9341_STATS
 /*
-  int8_t signumFunc(int16_t) returns sign of a number.
+  void getStats(ILI9341Stats&) copies the bus traffic counters, in total and per public primitive.
 */
-int8_t ILI9341::signumFunc(int16_t x)
+void ILI9341::getStats(ILI9341Stats& snapshot)
 {
-  return (x > 0) ? 1 : (x < 0) ? -1 : 0;
+  snapshot = stats;
 }
 
 /*
-  void drawLine(uint16_t, uint16_t, uint16_t, uint16_t, uint16_t) draws a line on the display using Bresenham algorythm.
+  void resetStats(void) clears all bus traffic counters.
+*/
+void ILI9341::resetStats(void)
+{
+  memset(&stats, 0, sizeof(stats));
+  memset(&holdStart, 0, sizeof(holdStart));
+}
 
-  Source: https://de.wikipedia.org/wiki/Bresenham-Algorithmus
+/*
+  uint32_t estimateMicros(const ILI9341BusStats&) converts counters into an estimated time in microseconds:
+  every command and data byte costs 8 clocks at the bus frequency, plus the fixed ILI9341_COST_* overheads
+  for commands, transfers, chip select edges and SPI reconfigurations.
 */
-void ILI9341::drawLine(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, uint16_t color)
+uint32_t ILI9341::estimateMicros(const ILI9341BusStats& counters)
 {
-  int x, y;
-  int dx, dy;     // Distance between points in both dimensions
-  int incx, incy; // Sign of increment 
-  int pdx, pdy;   // Parallelstep in x/y dimension
-  int ddx, ddy;   // Diagonalstep ub x/y dimension
-  int dsd;        // Delta-Slow-Direction
-  int dfd;        // Delta-Fast-Direction
-  int err;        // Error
+  uint64_t frequency = bus->getFrequency();
+  uint64_t bits = 8ULL * (counters.commands + counters.dataBytes);
+  uint64_t overheadNs = (uint64_t)counters.commands * ILI9341_COST_COMMAND_NS +
+    (uint64_t)counters.transfers * ILI9341_COST_TRANSFER_NS +
+    (uint64_t)counters.csToggles * ILI9341_COST_CS_NS +
+    (uint64_t)counters.formatSwitches * ILI9341_COST_FORMAT_NS;
+  uint64_t busNs = (frequency > 0) ? (bits * 1000000000ULL / frequency) : 0;
+
+  return (uint32_t)((busNs + overheadNs) / 1000);
+}
 
-  dx = x1 - x0;
-  dy = y1 - y0;
+/*
+  void countStat(uint32_t ILI9341BusStats::*, uint32_t) adds to a counter in the total and in the running primitive.
+*/
+void ILI9341::countStat(uint32_t ILI9341BusStats::* field, uint32_t amount)
+{
+  stats.total.*field += amount;
+  stats.primitive[currentPrimitive].*field += amount;
+}
 
-  incx = signumFunc(dx);
-  incy = signumFunc(dy);
+/*
+  StatsScope(ILI9341&, ILI9341Primitive) attributes traffic to a primitive unless an outer primitive is running.
+*/
+ILI9341::StatsScope::StatsScope(ILI9341& display, ILI9341Primitive primitive) : display(display)
+{
+  outermost = (display.currentPrimitive == ILI9341_PRIMITIVE_OTHER);
 
-  if(dx < 0)
+  if(outermost)
   {
-    dx = -dx;
+    display.currentPrimitive = primitive;
+    display.stats.primitive[primitive].calls++;
   }
+}
 
-  if(dy < 0)
+/*
+  ~StatsScope() ends the attribution started by the outermost primitive.
+*/
+ILI9341::StatsScope::~StatsScope()
+{
+  if(outermost)
   {
-    dy = -dy;
+    display.currentPrimitive = ILI9341_PRIMITIVE_OTHER;
   }
+}
+#endif
 
-  if(dx > dy)
-  {
-    pdx = incx; pdy = 0;
-    ddx = incx; ddy = incy;
-    dsd = dy;
-    dfd = dx;
-  }
-  else
+/*
+  void invalidateWindow(void) forgets the cached address window, so the next setAddrWindow programs both ranges.
+*/
+void ILI9341::invalidateWindow(void)
+{
+  windowValid = false;
+}
+
+/*
+  void writeCommand(uint8_t) writes a ILI9341 command via SPI.
+*/
+void ILI9341::writeCommand(uint8_t cmd)
+{
+  beginTransaction();
+  if(yieldDue())
   {
-    pdx = 0; pdy = incy;
-    ddx = incx; ddy = incy;
-    dsd = dx;
-    dfd = dy;
+    yieldBus(ILI9341_NOP);
   }
 
-  x = x0;
-  y = y0;
-  err = dfd / 2;
-  drawPixel(x, y, color);
-
-  for(int t = 0; t < dfd; ++t)
-  {
-    err -= dsd;
+  bus->writeCommand(cmd);
+  holdBytes++;
+  ILI9341_COUNT(commands, 1);
+}
 
-    if(err < 0)
-    {
-      err += dfd;
-      x += ddx;
-      y += ddy;
-    }
-    else
-    {
-      x += pdx;
-      y += pdy;
-    }
+/*
+  void readData(uint8_t*, size_t) reads the response of the last command via SPI.
+*/
+void ILI9341::readData(uint8_t* data, size_t length)
+{
+  bus->readData(data, length);
+  holdBytes += length;
+  ILI9341_COUNT(dataBytes, length);
+  ILI9341_COUNT(transfers, 1);
+}
 
-    drawPixel(x, y, color);
-  }
+/*
+  void writeData(const uint8_t*, size_t) writes command parameters via SPI.
+*/
+void ILI9341::writeData(const uint8_t* data, size_t length)
+{
+  bus->writeData(data, length);
+  holdBytes += length;
+  ILI9341_COUNT(dataBytes, length);
+  ILI9341_COUNT(transfers, 1);
 }
 
 /*
-  void drawTriangle(uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, uint16_t) draws a triangle on the display.
+  void setAsync(bool) enables or disables asynchronous (DMA-driven) pixel transfers.
+  In async mode the CPU fills one line buffer while the other is being sent, and primitives
+  may return before the last band is on the wire. Use flush() or isBusy() to synchronize.
+  Buses without asynchronous transfers (e.g. targets without DEVICE_SPI_ASYNCH) stay blocking.
 */
-void ILI9341::drawTriangle(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint16_t color)
+void ILI9341::setAsync(bool enable)
 {
-  drawLine(x0, y0, x1, y1, color);
-  drawLine(x1, y1, x2, y2, color);
-  drawLine(x2, y2, x0, y0, color);
+  waitIdle();
+  asyncMode = enable;
 }
 
 /*
-  void fillTriangle(uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, uint16_t) draws a filled triangle on the display.
+  void flush(void) pushes the damaged regions of the canvas (if any) to the display and waits
+  until all pending pixel transfers have completed.
 */
-void ILI9341::fillTriangle(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint16_t color)
+void ILI9341::flush(void)
 {
-  int16_t a, b, y, last;
+  ILI9341_PRIMITIVE(ILI9341_PRIMITIVE_FLUSH);
+
+  flushCanvas();
+  waitIdle();
+}
+
+/*
+  void waitIdle(void) waits until the asynchronous transfer in flight (if any) has completed.
+*/
+void ILI9341::waitIdle(void)
+{
+  bus->waitIdle();
+}
+
+/*
+  bool isBusy(void) returns true while an asynchronous transfer is still in flight.
+*/
+bool ILI9341::isBusy(void)
+{
+  return bus->isBusy();
+}
+
+/*
+  uint8_t* nextLineBuffer(void) returns the line buffer that is not used by the transfer in flight.
+*/
+uint8_t* ILI9341::nextLineBuffer(void)
+{
+  uint8_t* buffer = lineBuffer[activeBuffer];
+  activeBuffer ^= 1;
+  return buffer;
+}
+
+/*
+  void sendBuffer(const uint8_t*, size_t) sends a block of pixel data. In async mode the transfer
+  is started in the background after the previous one has completed. On a shared bus the stream is
+  interrupted between blocks once the yield budget is used up and resumed with RAMWRCONT.
+*/
+void ILI9341::sendBuffer(const uint8_t* data, size_t length)
+{
+  if(yieldDue())
+  {
+    yieldBus(ILI9341_RAMWRCONT);
+  }
+
+  if(asyncMode)
+  {
+    bus->writeDataAsync(data, length);
+  }
+  else
+  {
+    bus->writeData(data, length);
+  }
+
+  holdBytes += length;
+  ILI9341_COUNT(dataBytes, length);
+  ILI9341_COUNT(transfers, 1);
+}
+
+/*
+  void writePixels(const uint16_t*, size_t) streams a buffer of pixels into the current address window.
+  Pixels are packed into the line buffers and sent with block transfers of ILI9341_LINE_BUFFER_PIXELS.
+*/
+void ILI9341::writePixels(const uint16_t* pixels, size_t count)
+{
+  ILI9341_PRIMITIVE(ILI9341_PRIMITIVE_PIXEL_STREAM);
+
+  if(canvasActive())
+  {
+    canvasWrite(pixels, 0, count);
+    return;
+  }
+
+  while(count > 0)
+  {
+    size_t chunk = (count < ILI9341_LINE_BUFFER_PIXELS) ? count : ILI9341_LINE_BUFFER_PIXELS;
+    uint8_t* buffer = nextLineBuffer();
+
+    for(size_t i = 0; i < chunk; i++)
+    {
+      ILI9341Pixel::pack(&buffer[ILI9341Pixel::bytes * i], pixels[i]);
+    }
+
+    sendBuffer(buffer, chunk * ILI9341Pixel::bytes);
+    pixels += chunk;
+    count -= chunk;
+  }
+}
+
+/*
+  void writeColor(uint16_t, size_t) streams count pixels of a single color into the current address window.
+  A line buffer is filled once and then resent until all pixels are written.
+*/
+void ILI9341::writeColor(uint16_t color, size_t count)
+{
+  ILI9341_PRIMITIVE(ILI9341_PRIMITIVE_PIXEL_STREAM);
+
+  if(canvasActive())
+  {
+    canvasWrite(NULL, color, count);
+    return;
+  }
+
+  size_t chunk = (count < ILI9341_LINE_BUFFER_PIXELS) ? count : ILI9341_LINE_BUFFER_PIXELS;
+  uint8_t* buffer = nextLineBuffer();
+
+  for(size_t i = 0; i < chunk; i++)
+  {
+    ILI9341Pixel::pack(&buffer[ILI9341Pixel::bytes * i], color);
+  }
+
+  while(count > 0)
+  {
+    chunk = (count < ILI9341_LINE_BUFFER_PIXELS) ? count : ILI9341_LINE_BUFFER_PIXELS;
+    sendBuffer(buffer, chunk * ILI9341Pixel::bytes);
+    count -= chunk;
+  }
+}
+
+/*
+  void queueColor(uint16_t, size_t) appends count pixels of a color to the current line buffer and sends it
+  whenever it is full. Used by primitives that build a window from many short runs.
+*/
+void ILI9341::queueColor(uint16_t color, size_t count)
+{
+  if(canvasActive())
+  {
+    canvasWrite(NULL, color, count);
+    return;
+  }
+
+  while(count > 0)
+  {
+    if(queueBuffer == NULL)
+    {
+      queueBuffer = nextLineBuffer();
+      queueLength = 0;
+    }
+
+    while((count > 0) && (queueLength < ILI9341_LINE_BUFFER_PIXELS))
+    {
+      ILI9341Pixel::pack(&queueBuffer[ILI9341Pixel::bytes * queueLength], color);
+      queueLength++;
+      count--;
+    }
+
+    if(queueLength == ILI9341_LINE_BUFFER_PIXELS)
+    {
+      flushQueue();
+    }
+  }
+}
+
+/*
+  void flushQueue(void) sends the pixels collected by queueColor.
+*/
+void ILI9341::flushQueue(void)
+{
+  if(queueBuffer != NULL)
+  {
+    sendBuffer(queueBuffer, queueLength * ILI9341Pixel::bytes);
+    queueBuffer = NULL;
+    queueLength = 0;
+  }
+}
+
+/*
+  void startWrite(void) opens a batch: the chip select stays asserted and the bus configuration stays in place
+  across all primitives until the matching endWrite(). Batches may be nested.
+*/
+void ILI9341::startWrite(void)
+{
+  batchDepth++;
+  beginTransaction();
+}
+
+/*
+  void endWrite(void) closes a batch opened by startWrite, or finishes a pixel stream started with setAddrWindow,
+  and releases the chip select once no batch is open.
+*/
+void ILI9341::endWrite(void)
+{
+  if(batchDepth > 0)
+  {
+    batchDepth--;
+  }
+
+  endTransaction();
+}
+
+/*
+  void beginTransaction(void) asserts the chip select unless it is already asserted. A release that is still
+  waiting for an asynchronous transfer is cancelled by the bus, so back-to-back primitives keep the bus selected.
+*/
+void ILI9341::beginTransaction(void)
+{
+  if(!selected)
+  {
+    selectBus(true);
+  }
+}
+
+/*
+  void endTransaction(void) releases the chip select at the end of a primitive unless a batch is open.
+  If a transfer is still in flight, the bus releases the chip select when it completes.
+*/
+void ILI9341::endTransaction(void)
+{
+  if((batchDepth > 0) || !selected)
+  {
+    return;
+  }
+
+  selectBus(false);
+}
+
+/*
+  void selectBus(bool) asserts or releases the chip select. A shared bus is locked and reconfigured for the display
+  while the chip select is asserted. With statistics enabled, the traffic of the longest assertion is recorded.
+*/
+void ILI9341::selectBus(bool active)
+{
+#if ILI9341_STATS
+  if(active)
+  {
+    holdStart = stats.total;
+  }
+#endif
+
+  bus->select(active);
+  selected = active;
+  holdBytes = 0;
+  ILI9341_COUNT(csToggles, 1);
+
+  if(active && bus->isShared())
+  {
+    ILI9341_COUNT(formatSwitches, 1);
+  }
+
+#if ILI9341_STATS
+  if(!active)
+  {
+    ILI9341BusStats hold;
+
+    hold.calls = 0;
+    hold.commands = stats.total.commands - holdStart.commands;
+    hold.dataBytes = stats.total.dataBytes - holdStart.dataBytes;
+    hold.transfers = stats.total.transfers - holdStart.transfers;
+    hold.csToggles = stats.total.csToggles - holdStart.csToggles;
+    hold.formatSwitches = stats.total.formatSwitches - holdStart.formatSwitches;
+    hold.windowSetups = stats.total.windowSetups - holdStart.windowSetups;
+
+    if(estimateMicros(hold) > estimateMicros(stats.longestHold))
+    {
+      stats.longestHold = hold;
+    }
+  }
+#endif
+}
+
+/*
+  bool yieldDue(void) returns true if the display has used up its share of a shared bus.
+*/
+bool ILI9341::yieldDue(void)
+{
+  return (yieldBytes > 0) && (holdBytes >= yieldBytes) && bus->isShared();
+}
+
+/*
+  void yieldBus(uint8_t) releases the chip select so other devices can use the bus, asserts it again and sends
+  resumeCommand (unless it is ILI9341_NOP) to continue an interrupted memory write or read. The address window
+  and the memory pointer of the controller are not affected by the chip select.
+*/
+void ILI9341::yieldBus(uint8_t resumeCommand)
+{
+  selectBus(false);
+  selectBus(true);
+
+  if(resumeCommand != ILI9341_NOP)
+  {
+    writeCommand(resumeCommand);
+  }
+}
+
+/*
+  void setCanvas(uint16_t*, uint16_t, uint16_t, uint16_t, uint16_t) redirects all drawing into an off-screen
+  RGB565 buffer of w * h pixels covering the screen area at (x, y). The buffer can hold the full frame or a
+  band of it; drawing outside the covered area is discarded. Damaged regions are merged and only sent to
+  the display by flush(). Passing NULL flushes pending regions and returns to direct drawing.
+*/
+void ILI9341::setCanvas(uint16_t* buffer, uint16_t x, uint16_t y, uint16_t w, uint16_t h)
+{
+  flush();
+  canvas = buffer;
+  canvasArea = {x, y, (uint16_t)(x + w - 1), (uint16_t)(y + h - 1)};
+  dirtyCount = 0;
+}
+
+/*
+  bool canvasActive(void) returns true when pixel streams are rendered into the canvas.
+*/
+bool ILI9341::canvasActive(void)
+{
+  return (canvas != NULL) && !flushingCanvas;
+}
+
+/*
+  void canvasWrite(const uint16_t*, uint16_t, size_t) stores a pixel stream (or a single color when pixels
+  is NULL) into the canvas, following the address window the same way the display RAM pointer would.
+*/
+void ILI9341::canvasWrite(const uint16_t* pixels, uint16_t color, size_t count)
+{
+  uint16_t canvasWidth = canvasArea.x1 - canvasArea.x0 + 1;
+
+  while(count > 0)
+  {
+    size_t run = canvasWindow.x1 - canvasCursorX + 1;
+    if(run > count)
+    {
+      run = count;
+    }
+
+    if((canvasCursorY >= canvasArea.y0) && (canvasCursorY <= canvasArea.y1))
+    {
+      uint16_t start = (canvasCursorX > canvasArea.x0) ? canvasCursorX : canvasArea.x0;
+      uint16_t end = canvasCursorX + run - 1;
+      if(end > canvasArea.x1)
+      {
+        end = canvasArea.x1;
+      }
+
+      if(start <= end)
+      {
+        uint16_t* dst = &canvas[(canvasCursorY - canvasArea.y0) * canvasWidth + (start - canvasArea.x0)];
+        for(uint16_t i = start; i <= end; i++)
+        {
+          *dst++ = (pixels != NULL) ? pixels[i - canvasCursorX] : color;
+        }
+      }
+    }
+
+    if(pixels != NULL)
+    {
+      pixels += run;
+    }
+    count -= run;
+    canvasCursorX += run;
+
+    if(canvasCursorX > canvasWindow.x1)
+    {
+      canvasCursorX = canvasWindow.x0;
+      canvasCursorY = (canvasCursorY < canvasWindow.y1) ? canvasCursorY + 1 : canvasWindow.y0;
+    }
+  }
+}
+
+/*
+  void markDirty(Rect) adds a damaged region (clipped to the canvas) to the dirty list. Regions are merged
+  when their union costs no extra pixels; when the list is full the pair with the smallest growth is merged.
+*/
+void ILI9341::markDirty(Rect rect)
+{
+  rect.x0 = (rect.x0 > canvasArea.x0) ? rect.x0 : canvasArea.x0;
+  rect.y0 = (rect.y0 > canvasArea.y0) ? rect.y0 : canvasArea.y0;
+  rect.x1 = (rect.x1 < canvasArea.x1) ? rect.x1 : canvasArea.x1;
+  rect.y1 = (rect.y1 < canvasArea.y1) ? rect.y1 : canvasArea.y1;
+
+  if((rect.x0 > rect.x1) || (rect.y0 > rect.y1))
+  {
+    return;
+  }
+
+  bool merged = true;
+  while(merged)
+  {
+    merged = false;
+    int32_t bestGrowth = INT32_MAX;
+    uint8_t best = 0;
+
+    for(uint8_t i = 0; i < dirtyCount; i++)
+    {
+      Rect u = {std::min(rect.x0, dirty[i].x0), std::min(rect.y0, dirty[i].y0), std::max(rect.x1, dirty[i].x1), std::max(rect.y1, dirty[i].y1)};
+      int32_t areaU = (int32_t)(u.x1 - u.x0 + 1) * (u.y1 - u.y0 + 1);
+      int32_t areaA = (int32_t)(rect.x1 - rect.x0 + 1) * (rect.y1 - rect.y0 + 1);
+      int32_t areaB = (int32_t)(dirty[i].x1 - dirty[i].x0 + 1) * (dirty[i].y1 - dirty[i].y0 + 1);
+      int32_t growth = areaU - areaA - areaB;
+
+      if(growth < bestGrowth)
+      {
+        bestGrowth = growth;
+        best = i;
+      }
+    }
+
+    if((dirtyCount > 0) && ((bestGrowth <= 0) || (dirtyCount == ILI9341_DIRTY_RECTS)))
+    {
+      // Take the merge partner out of the list and retry with the union
+      rect = {std::min(rect.x0, dirty[best].x0), std::min(rect.y0, dirty[best].y0), std::max(rect.x1, dirty[best].x1), std::max(rect.y1, dirty[best].y1)};
+      dirty[best] = dirty[--dirtyCount];
+      merged = true;
+    }
+  }
+
+  dirty[dirtyCount++] = rect;
+}
+
+/*
+  void flushCanvas(void) sends every dirty region of the canvas through its own address window.
+*/
+void ILI9341::flushCanvas(void)
+{
+  if((canvas == NULL) || (dirtyCount == 0))
+  {
+    return;
+  }
+
+  uint16_t canvasWidth = canvasArea.x1 - canvasArea.x0 + 1;
+  flushingCanvas = true;
+
+  for(uint8_t i = 0; i < dirtyCount; i++)
+  {
+    Rect& r = dirty[i];
+    uint16_t w = r.x1 - r.x0 + 1;
+    uint16_t h = r.y1 - r.y0 + 1;
+    const uint16_t* src = &canvas[(r.y0 - canvasArea.y0) * canvasWidth + (r.x0 - canvasArea.x0)];
+
+    setAddrWindow(r.x0, r.y0, w, h);
+    if(w == canvasWidth)
+    {
+      writePixels(src, (size_t)w * h);
+    }
+    else
+    {
+      for(uint16_t row = 0; row < h; row++)
+      {
+        writePixels(src, w);
+        src += canvasWidth;
+      }
+    }
+    endTransaction();
+  }
+
+  dirtyCount = 0;
+  flushingCanvas = false;
+}
+
+/*
+  void drawPixel(int16_t, int16_t, uint16_t) draws a pixel with a specific color on the display.
+*/
+void ILI9341::drawPixel(int16_t x, int16_t y, uint16_t color)
+{
+  ILI9341_PRIMITIVE(ILI9341_PRIMITIVE_DRAW_PIXEL);
+
+  Rect visible;
+  if(!clipArea(x, y, 1, 1, visible))
+  {
+    return;
+  }
+
+  setAddrWindow(visible.x0, visible.y0, 1, 1);
+  writeColor(color, 1);
+  endTransaction();
+}
+
+/*
+  void drawVLine(int16_t, int16_t, uint16_t, uint16_t) draws a vertical line on the display.
+*/
+void ILI9341::drawVLine(int16_t x, int16_t y, uint16_t h, uint16_t color)
+{
+  ILI9341_PRIMITIVE(ILI9341_PRIMITIVE_DRAW_VLINE);
+
+  Rect visible;
+  if(!clipArea(x, y, 1, h, visible))
+  {
+    return;
+  }
+
+  h = visible.y1 - visible.y0 + 1;
+  setAddrWindow(visible.x0, visible.y0, 1, h);
+  writeColor(color, h);
+  endTransaction();
+}
+
+/*
+  void drawHLine(int16_t, int16_t, uint16_t, uint16_t) draws a horizontal line on the display.
+*/
+void ILI9341::drawHLine(int16_t x, int16_t y, uint16_t w, uint16_t color)
+{
+  ILI9341_PRIMITIVE(ILI9341_PRIMITIVE_DRAW_HLINE);
+
+  Rect visible;
+  if(!clipArea(x, y, w, 1, visible))
+  {
+    return;
+  }
+
+  w = visible.x1 - visible.x0 + 1;
+  setAddrWindow(visible.x0, visible.y0, w, 1);
+  writeColor(color, w);
+  endTransaction();
+}
+
+/*
+  void pushClipRect(int16_t, int16_t, uint16_t, uint16_t) restricts drawing to the intersection of the current clip
+  rectangle and the given area until the matching popClipRect(). Clip rectangles nest up to ILI9341_CLIP_DEPTH
+  levels; further pushes are ignored. All primitives except the raw pixel stream (setAddrWindow) honor the clip.
+*/
+void ILI9341::pushClipRect(int16_t x, int16_t y, uint16_t w, uint16_t h)
+{
+  if(clipDepth == ILI9341_CLIP_DEPTH)
+  {
+    return;
+  }
+
+  clipStack[clipDepth++] = clip;
+
+  Rect visible;
+  if(clipArea(x, y, w, h, visible))
+  {
+    clip = visible;
+  }
+  else
+  {
+    clip = {1, 1, 0, 0};  // Empty
+  }
+}
+
+/*
+  void popClipRect(void) restores the clip rectangle that was active before the last pushClipRect().
+*/
+void ILI9341::popClipRect(void)
+{
+  if(clipDepth > 0)
+  {
+    clip = clipStack[--clipDepth];
+  }
+}
+
+/*
+  void getClipRect(int16_t&, int16_t&, uint16_t&, uint16_t&) returns the current clip rectangle (w and h are 0 if
+  it is empty).
+*/
+void ILI9341::getClipRect(int16_t& x, int16_t& y, uint16_t& w, uint16_t& h)
+{
+  x = clip.x0;
+  y = clip.y0;
+  w = (clip.x0 <= clip.x1) ? clip.x1 - clip.x0 + 1 : 0;
+  h = (clip.y0 <= clip.y1) ? clip.y1 - clip.y0 + 1 : 0;
+}
+
+/*
+  void resetClip(void) drops all clip rectangles so that the whole screen is drawable.
+*/
+void ILI9341::resetClip(void)
+{
+  clipDepth = 0;
+  clip = {0, 0, (uint16_t)(width - 1), (uint16_t)(height - 1)};
+}
+
+/*
+  bool clipArea(int32_t, int32_t, int32_t, int32_t, Rect&) trims an area to the clip rectangle. Returns false if
+  nothing of it is visible, so primitives can drop it before touching the bus.
+*/
+bool ILI9341::clipArea(int32_t x, int32_t y, int32_t w, int32_t h, Rect& visible)
+{
+  if((w <= 0) || (h <= 0))
+  {
+    return false;
+  }
+
+  int32_t x0 = std::max<int32_t>(x, clip.x0);
+  int32_t y0 = std::max<int32_t>(y, clip.y0);
+  int32_t x1 = std::min<int32_t>(x + w - 1, clip.x1);
+  int32_t y1 = std::min<int32_t>(y + h - 1, clip.y1);
+
+  if((x0 > x1) || (y0 > y1))
+  {
+    return false;
+  }
+
+  visible = {(uint16_t)x0, (uint16_t)y0, (uint16_t)x1, (uint16_t)y1};
+  return true;
+}
+
+/*
+  void setRotation(uint8_t) sets rotation of display (input from 0-4)
+*/
+void ILI9341::setRotation(uint8_t rot)
+{
+  ILI9341_PRIMITIVE(ILI9341_PRIMITIVE_SET_ROTATION);
+
+  orientation = rot % 4;
+  width = rotations[orientation].width;
+  height = rotations[orientation].height;
+
+  invalidateWindow();
+  writeCommand(ILI9341_MADCTL);
+  writeData(&rotations[orientation].madctl, 1);
+  endTransaction();
+  resetClip();
+}
+
+/*
+  void setScrollArea(uint16_t, uint16_t) splits the panel into a fixed area at the top, a scroll area and a fixed
+  area at the bottom (VSCRDEF) and resets the scroll offset. The areas are counted in rows of the panel's native
+  320 row axis, which is the y axis in rotation 0.
+*/
+void ILI9341::setScrollArea(uint16_t topFixed, uint16_t bottomFixed)
+{
+  ILI9341_PRIMITIVE(ILI9341_PRIMITIVE_SCROLL);
+
+  if(topFixed + bottomFixed >= ILI9341_TFTHEIGHT)
+  {
+    return;
+  }
+
+  scrollTop = topFixed;
+  scrollHeight = ILI9341_TFTHEIGHT - topFixed - bottomFixed;
+
+  uint8_t data[6] =
+  {
+    (uint8_t)(topFixed >> 8), (uint8_t)topFixed,
+    (uint8_t)(scrollHeight >> 8), (uint8_t)scrollHeight,
+    (uint8_t)(bottomFixed >> 8), (uint8_t)bottomFixed
+  };
+
+  writeCommand(ILI9341_VSCRDEF);
+  writeData(data, sizeof(data));
+  endTransaction();
+
+  setScrollOffset(0);
+}
+
+/*
+  void setScrollOffset(uint16_t) moves the content of the scroll area up by offset rows (VSCRSADD). Rows that
+  leave the top of the area reappear at its bottom, so only the frame memory rows that became visible have to be
+  redrawn.
+*/
+void ILI9341::setScrollOffset(uint16_t offset)
+{
+  ILI9341_PRIMITIVE(ILI9341_PRIMITIVE_SCROLL);
+
+  scrollOffset = offset % scrollHeight;
+
+  uint16_t start = scrollTop + scrollOffset;
+  uint8_t data[2] = {(uint8_t)(start >> 8), (uint8_t)start};
+
+  writeCommand(ILI9341_VSCRSADD);
+  writeData(data, sizeof(data));
+  endTransaction();
+}
+
+/*
+  uint16_t getScrollOffset(void) returns the current scroll offset within the scroll area.
+*/
+uint16_t ILI9341::getScrollOffset(void)
+{
+  return scrollOffset;
+}
+
+/*
+  void drawRectangle(int16_t, int16_t, uint16_t, uint16_t, uint16_t) draws a rectangle on the display.
+*/
+void ILI9341::drawRectangle(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t color)
+{
+  ILI9341_PRIMITIVE(ILI9341_PRIMITIVE_DRAW_RECTANGLE);
+
+  Rect visible;
+  if(!clipArea(x, y, w, h, visible))
+  {
+    return;
+  }
+
+  drawHLine(x, y, w, color);
+  drawHLine(x, y + h - 1, w, color);
+  drawVLine(x, y, h, color);
+  drawVLine(x + w - 1, y, h, color);
+}
+
+/*
+  void fillRectangle(int16_t, int16_t, uint16_t, uint16_t, uint16_t) draws a filled rectangle on the display.
+  Only the part inside the clip rectangle is sent.
+*/
+void ILI9341::fillRectangle(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t color)
+{
+  ILI9341_PRIMITIVE(ILI9341_PRIMITIVE_FILL_RECTANGLE);
+
+  Rect visible;
+  if(!clipArea(x, y, w, h, visible))
+  {
+    return;
+  }
+
+  w = visible.x1 - visible.x0 + 1;
+  h = visible.y1 - visible.y0 + 1;
+  setAddrWindow(visible.x0, visible.y0, w, h);
+  writeColor(color, (size_t)w * h);
+  endTransaction();
+}
+
+/*
+  void fillBackground(uint16_t) fills the background of the display with a specific color.
+  While sending color pixels display will be turned off so that the long drawing animation 
+  will not be shown. In canvas mode only the canvas is filled; flush() sends it in one pass.
+*/
+void ILI9341::fillBackground(uint16_t color)
+{
+  ILI9341_PRIMITIVE(ILI9341_PRIMITIVE_FILL_BACKGROUND);
+
+  if(canvasActive())
+  {
+    fillRectangle(0, 0, width, height, color);
+    return;
+  }
+
+  writeCommand(ILI9341_DISPOFF);
+  fillRectangle(0, 0, width, height, color);
+  writeCommand(ILI9341_DISPON);
+  endTransaction();
+}
+
+/*
+  void drawBitmap(int16_t, int16_t, const uint16_t*, uint16_t, uint16_t) draws a w * h RGB565 image (rows of w pixels).
+  The part inside the clip rectangle is sent through a single address window.
+*/
+void ILI9341::drawBitmap(int16_t x, int16_t y, const uint16_t* bitmap, uint16_t w, uint16_t h)
+{
+  ILI9341_PRIMITIVE(ILI9341_PRIMITIVE_DRAW_BITMAP);
+
+  Rect visible;
+  if(!clipArea(x, y, w, h, visible))
+  {
+    return;
+  }
+
+  uint16_t left = visible.x0 - x;
+  uint16_t top = visible.y0 - y;
+  uint16_t cw = visible.x1 - visible.x0 + 1;
+  uint16_t ch = visible.y1 - visible.y0 + 1;
+
+  setAddrWindow(visible.x0, visible.y0, cw, ch);
+  if(cw == w)
+  {
+    writePixels(&bitmap[(size_t)top * w], (size_t)w * ch);
+  }
+  else
+  {
+    for(uint16_t row = 0; row < ch; row++)
+    {
+      writePixels(&bitmap[(size_t)(top + row) * w + left], cw);
+    }
+  }
+  endTransaction();
+}
+
+/*
+  void drawBitmap(int16_t, int16_t, const uint16_t*, uint16_t, uint16_t, uint16_t) draws a w * h RGB565 image and leaves
+  the pixels of transparentColor untouched. Each visible row is split into runs of opaque pixels, which are sent as spans.
+*/
+void ILI9341::drawBitmap(int16_t x, int16_t y, const uint16_t* bitmap, uint16_t w, uint16_t h, uint16_t transparentColor)
+{
+  ILI9341_PRIMITIVE(ILI9341_PRIMITIVE_DRAW_BITMAP);
+
+  Rect visible;
+  if(!clipArea(x, y, w, h, visible))
+  {
+    return;
+  }
+
+  uint16_t left = visible.x0 - x;
+  uint16_t top = visible.y0 - y;
+  uint16_t cw = visible.x1 - visible.x0 + 1;
+  uint16_t ch = visible.y1 - visible.y0 + 1;
+
+  for(uint16_t row = 0; row < ch; row++)
+  {
+    const uint16_t* src = &bitmap[(size_t)(top + row) * w + left];
+    uint16_t i = 0;
+
+    while(i < cw)
+    {
+      while((i < cw) && (src[i] == transparentColor))
+      {
+        i++;
+      }
+
+      uint16_t start = i;
+      while((i < cw) && (src[i] != transparentColor))
+      {
+        i++;
+      }
+
+      if(i > start)
+      {
+        setAddrWindow(visible.x0 + start, visible.y0 + row, i - start, 1);
+        writePixels(&src[start], i - start);
+      }
+    }
+  }
+  endTransaction();
+}
+
+/*
+  void drawBitmap(int16_t, int16_t, const uint8_t*, uint16_t, uint16_t, uint16_t, uint16_t) draws a w * h 1-bit image
+  (rows padded to whole bytes, most significant bit first). Set bits are drawn in foreColor, clear bits in backColor.
+  Like drawChar, the image is drawn transparent when both colors are the same: only runs of set bits are sent.
+*/
+void ILI9341::drawBitmap(int16_t x, int16_t y, const uint8_t* bitmap, uint16_t w, uint16_t h, uint16_t foreColor, uint16_t backColor)
+{
+  ILI9341_PRIMITIVE(ILI9341_PRIMITIVE_DRAW_BITMAP);
+
+  Rect visible;
+  if(!clipArea(x, y, w, h, visible))
+  {
+    return;
+  }
+
+  uint16_t left = visible.x0 - x;
+  uint16_t top = visible.y0 - y;
+  uint16_t right = visible.x1 - x + 1;
+  uint16_t ch = visible.y1 - visible.y0 + 1;
+  uint16_t stride = (w + 7) / 8;
+  bool transparent = (foreColor == backColor);
+
+  if(!transparent)
+  {
+    setAddrWindow(visible.x0, visible.y0, right - left, ch);
+  }
+
+  for(uint16_t row = 0; row < ch; row++)
+  {
+    const uint8_t* src = &bitmap[(size_t)(top + row) * stride];
+    uint16_t i = left;
+
+    while(i < right)
+    {
+      bool set = src[i >> 3] & (0x80 >> (i & 7));
+      uint16_t start = i;
+
+      while((i < right) && ((bool)(src[i >> 3] & (0x80 >> (i & 7))) == set))
+      {
+        i++;
+      }
+
+      if(!transparent)
+      {
+        queueColor(set ? foreColor : backColor, i - start);
+      }
+      else if(set)
+      {
+        setAddrWindow(x + start, visible.y0 + row, i - start, 1);
+        writeColor(foreColor, i - start);
+      }
+    }
+  }
+
+  flushQueue();
+  endTransaction();
+}
+
+/*
+  void drawSprite(int16_t, int16_t, const ILI9341Sprite&) draws an RLE compressed sprite. Runs and literals are
+  decoded straight into the line buffer; consecutive opaque tokens of a row share one address window and skip
+  tokens leave the screen untouched. Only the part inside the clip rectangle is sent.
+*/
+void ILI9341::drawSprite(int16_t x, int16_t y, const ILI9341Sprite& sprite)
+{
+  ILI9341_PRIMITIVE(ILI9341_PRIMITIVE_DRAW_SPRITE);
+
+  Rect visible;
+  if(!clipArea(x, y, sprite.width, sprite.height, visible))
+  {
+    return;
+  }
+
+  uint16_t left = visible.x0 - x;
+  uint16_t right = visible.x1 - x + 1;
+  uint16_t top = visible.y0 - y;
+  uint16_t bottom = visible.y1 - y + 1;
+  const uint16_t* src = sprite.data;
+
+  for(uint16_t row = 0; row < bottom; row++)
+  {
+    uint16_t px = 0;
+    bool spanOpen = false;
+
+    while(px < sprite.width)
+    {
+      uint16_t token = *src++;
+      uint16_t count = token & ILI9341_RLE_COUNT_MASK;
+      uint16_t kind = token & ILI9341_RLE_KIND_MASK;
+      uint16_t start = std::max(px, left);
+      uint16_t end = std::min<uint16_t>(px + count, right);
+      uint16_t shown = ((row >= top) && (start < end)) ? end - start : 0;
+
+      if(kind == ILI9341_RLE_SKIP(0))
+      {
+        spanOpen = false;
+        px += count;
+        continue;
+      }
+
+      if((shown > 0) && !spanOpen)
+      {
+        flushQueue();
+        setAddrWindow(x + start, y + row, right - start, 1);
+        spanOpen = true;
+      }
+
+      if(kind == ILI9341_RLE_REPEAT(0))
+      {
+        queueColor(*src++, shown);
+      }
+      else
+      {
+        for(uint16_t i = 0; i < shown; i++)
+        {
+          queueColor(src[start - px + i], 1);
+        }
+        src += count;
+      }
+
+      px += count;
+    }
+  }
+
+  flushQueue();
+  endTransaction();
+}
+
+/*
+  void drawRun(const ArcShape&, int16_t, int16_t, int16_t, int16_t) draws a horizontal (h == 1) or vertical
+  (w == 1) run of pixels. If the shape is an arc, only the pixels inside its sector are drawn, split into
+  sub-runs with one address window each.
+*/
+void ILI9341::drawRun(const ArcShape& shape, int16_t x, int16_t y, int16_t w, int16_t h)
+{
+  if(!shape.sector)
+  {
+    fillRectangle(x, y, w, h, shape.color);
+    return;
+  }
+
+  int16_t length = (w > h) ? w : h;
+  int16_t start = -1;
+
+  for(int16_t i = 0; i <= length; i++)
+  {
+    bool inside = false;
+
+    if(i < length)
+    {
+      int32_t px = (w > 1) ? (x + i - shape.xc) : (x - shape.xc);
+      int32_t py = (w > 1) ? (y - shape.yc) : (y + i - shape.yc);
+      int32_t crossStart = shape.startX * py - shape.startY * px;
+      int32_t crossEnd = px * shape.endY - py * shape.endX;
+
+      if(shape.wide)
+      {
+        inside = !((crossEnd > 0) && (crossStart < 0));
+      }
+      else
+      {
+        inside = (crossStart >= 0) && (crossEnd >= 0);
+      }
+    }
+
+    if(inside && (start < 0))
+    {
+      start = i;
+    }
+    else if(!inside && (start >= 0))
+    {
+      if(w > 1)
+      {
+        fillRectangle(x + start, y, i - start, 1, shape.color);
+      }
+      else
+      {
+        fillRectangle(x, y + start, 1, i - start, shape.color);
+      }
+      start = -1;
+    }
+  }
+}
+
+/*
+  void emitHRun(const ArcShape&, int16_t, int16_t, int16_t) emits a run of one quadrant that lies on a single row
+  (row offset dy, column offsets dx0..dx1) for every selected quadrant. Mirrored halves that share the vertical
+  axis are merged into one run, so every pixel is sent exactly once.
+*/
+void ILI9341::emitHRun(const ArcShape& shape, int16_t dy, int16_t dx0, int16_t dx1)
+{
+  for(uint8_t half = 0; half < 2; half++)
+  {
+    uint8_t right = (half == 0) ? 0x02 : 0x04;
+    uint8_t left = (half == 0) ? 0x01 : 0x08;
+    int16_t y = (half == 0) ? (shape.yc - dy) : (shape.yc + dy);
+
+    if((half == 1) && (dy == 0))
+    {
+      break;
+    }
+
+    if(shape.fill)
+    {
+      fillRectangle(shape.xc - dx1, y, 2 * dx1 + 1, 1, shape.color);
+      continue;
+    }
+
+    if((dx0 == 0) && (shape.corners & right) && (shape.corners & left))
+    {
+      drawRun(shape, shape.xc - dx1, y, 2 * dx1 + 1, 1);
+      continue;
+    }
+
+    if(shape.corners & right)
+    {
+      drawRun(shape, shape.xc + dx0, y, dx1 - dx0 + 1, 1);
+    }
+    if(shape.corners & left)
+    {
+      int16_t inner = ((dx0 == 0) && (shape.corners & right)) ? 1 : dx0;
+      if(inner <= dx1)
+      {
+        drawRun(shape, shape.xc - dx1, y, dx1 - inner + 1, 1);
+      }
+    }
+  }
+}
+
+/*
+  void emitVRun(const ArcShape&, int16_t, int16_t, int16_t) emits a run of one quadrant that lies on a single column
+  (column offset dx, row offsets dy0..dy1). When filling, the rows dy0..dy1 all have the half-width dx and are sent
+  as one rectangle.
+*/
+void ILI9341::emitVRun(const ArcShape& shape, int16_t dx, int16_t dy0, int16_t dy1)
+{
+  if(shape.fill)
+  {
+    if(dy0 == 0)
+    {
+      fillRectangle(shape.xc - dx, shape.yc - dy1, 2 * dx + 1, 2 * dy1 + 1, shape.color);
+    }
+    else
+    {
+      fillRectangle(shape.xc - dx, shape.yc - dy1, 2 * dx + 1, dy1 - dy0 + 1, shape.color);
+      fillRectangle(shape.xc - dx, shape.yc + dy0, 2 * dx + 1, dy1 - dy0 + 1, shape.color);
+    }
+    return;
+  }
+
+  for(uint8_t side = 0; side < 2; side++)
+  {
+    uint8_t top = (side == 0) ? 0x02 : 0x01;
+    uint8_t bottom = (side == 0) ? 0x04 : 0x08;
+    int16_t x = (side == 0) ? (shape.xc + dx) : (shape.xc - dx);
+
+    if((side == 1) && (dx == 0))
+    {
+      break;
+    }
+
+    if((dy0 == 0) && (shape.corners & top) && (shape.corners & bottom))
+    {
+      drawRun(shape, x, shape.yc - dy1, 1, 2 * dy1 + 1);
+      continue;
+    }
+
+    if(shape.corners & bottom)
+    {
+      drawRun(shape, x, shape.yc + dy0, 1, dy1 - dy0 + 1);
+    }
+    if(shape.corners & top)
+    {
+      int16_t inner = ((dy0 == 0) && (shape.corners & bottom)) ? 1 : dy0;
+      if(inner <= dy1)
+      {
+        drawRun(shape, x, shape.yc - dy1, 1, dy1 - inner + 1);
+      }
+    }
+  }
+}
+
+/*
+  void circleRuns(const ArcShape&, uint16_t) walks one octant of a circle using Bresenham algorythm and
+  collapses the points into row runs (flat octant) and column runs (mirrored steep octant).
+
+  Source: https://www.geeksforgeeks.org/bresenhams-circle-drawing-algorithm/
+*/
+void ILI9341::circleRuns(const ArcShape& shape, uint16_t r)
+{
+  int16_t x = 0;
+  int16_t y = r;
+  int16_t d = 3 - 2 * r;
+  int16_t runStart = 0;
+
+  while(x <= y)
+  {
+    int16_t nextX = x + 1;
+    int16_t nextY = y;
+
+    if(d > 0)
+    {
+      nextY--;
+      d = d + 4 * (nextX - nextY) + 10;
+    }
+    else
+    {
+      d = d + 4 * nextX + 6;
+    }
+
+    // Close the run when the row changes or the octant ends
+    if((nextY != y) || (nextX > nextY))
+    {
+      emitHRun(shape, y, runStart, x);
+
+      // Mirrored column run; the diagonal point already belongs to the row run
+      int16_t last = (x == y) ? x - 1 : x;
+      if(last >= runStart)
+      {
+        emitVRun(shape, y, runStart, last);
+      }
+
+      runStart = nextX;
+    }
+
+    x = nextX;
+    y = nextY;
+  }
+}
+
+/*
+  void ellipseRuns(const ArcShape&, uint16_t, uint16_t) walks one quadrant of an ellipse using the midpoint
+  algorythm. Region 1 (flat) produces row runs, region 2 (steep) produces column runs.
+  Decision variables are scaled by 4 to stay in integer arithmetic.
+*/
+void ILI9341::ellipseRuns(const ArcShape& shape, uint16_t rx, uint16_t ry)
+{
+  int64_t a2 = (int64_t)rx * rx;
+  int64_t b2 = (int64_t)ry * ry;
+  int32_t x = 0;
+  int32_t y = ry;
+  int64_t dx = 0;
+  int64_t dy = 2 * a2 * y;
+  int64_t d = 4 * b2 - 4 * a2 * ry + a2;
+  int32_t runStart = 0;
+
+  // Region 1: x advances every step
+  while(dx < dy)
+  {
+    int32_t nextY = y;
+
+    if(d < 0)
+    {
+      dx += 2 * b2;
+      d += 4 * (dx + b2);
+    }
+    else
+    {
+      nextY--;
+      dx += 2 * b2;
+      dy -= 2 * a2;
+      d += 4 * (dx - dy + b2);
+    }
+
+    if(nextY != y)
+    {
+      emitHRun(shape, y, runStart, x);
+      runStart = x + 1;
+    }
+
+    x++;
+    y = nextY;
+  }
+
+  // A row run still open at the region boundary ends with the first point of region 2
+  if(runStart < x)
+  {
+    emitHRun(shape, y, runStart, x);
+    runStart = y - 1;
+  }
+  else
+  {
+    runStart = y;
+  }
+
+  // Region 2: y advances every step
+  d = b2 * (2 * x + 1) * (2 * x + 1) + 4 * a2 * (int64_t)(y - 1) * (y - 1) - 4 * a2 * b2;
+
+  while(y >= 0)
+  {
+    int32_t nextX = x;
+
+    if(d > 0)
+    {
+      dy -= 2 * a2;
+      d += 4 * (a2 - dy);
+    }
+    else
+    {
+      nextX++;
+      dx += 2 * b2;
+      dy -= 2 * a2;
+      d += 4 * (dx - dy + a2);
+    }
+
+    if(((nextX != x) || (y == 0)) && (runStart >= y))
+    {
+      emitVRun(shape, x, y, runStart);
+    }
+    if(nextX != x)
+    {
+      runStart = y - 1;
+    }
+
+    x = nextX;
+    y--;
+  }
+}
+
+/*
+  void drawCircle(int16_t, int16_t, uint16_t, uint16_t) draws a circle to the display.
+*/
+void ILI9341::drawCircle(int16_t xc, int16_t yc, uint16_t r, uint16_t color)
+{
+  ILI9341_PRIMITIVE(ILI9341_PRIMITIVE_DRAW_CIRCLE);
+
+  Rect visible;
+  if(!clipArea(xc - r, yc - r, 2 * r + 1, 2 * r + 1, visible))
+  {
+    return;
+  }
+
+  ArcShape shape = {xc, yc, 0x0F, false, false, false, 0, 0, 0, 0, color};
+  circleRuns(shape, r);
+}
+
+/*
+  void fillCircle(int16_t, int16_t, uint16_t, uint16_t) draws a filled circle to the display.
+  Every row is sent once; rows of equal width are combined into one rectangle.
+*/
+void ILI9341::fillCircle(int16_t xc, int16_t yc, uint16_t r, uint16_t color)
+{
+  ILI9341_PRIMITIVE(ILI9341_PRIMITIVE_FILL_CIRCLE);
+
+  Rect visible;
+  if(!clipArea(xc - r, yc - r, 2 * r + 1, 2 * r + 1, visible))
+  {
+    return;
+  }
+
+  ArcShape shape = {xc, yc, 0x0F, true, false, false, 0, 0, 0, 0, color};
+  circleRuns(shape, r);
+}
+
+/*
+  void drawEllipse(int16_t, int16_t, uint16_t, uint16_t, uint16_t) draws an ellipse with the radii rx and ry.
+*/
+void ILI9341::drawEllipse(int16_t xc, int16_t yc, uint16_t rx, uint16_t ry, uint16_t color)
+{
+  ILI9341_PRIMITIVE(ILI9341_PRIMITIVE_DRAW_ELLIPSE);
+
+  Rect visible;
+  if(!clipArea(xc - rx, yc - ry, 2 * rx + 1, 2 * ry + 1, visible))
+  {
+    return;
+  }
+
+  if((rx == 0) || (ry == 0))
+  {
+    fillRectangle(xc - rx, yc - ry, 2 * rx + 1, 2 * ry + 1, color);
+    return;
+  }
+
+  ArcShape shape = {xc, yc, 0x0F, false, false, false, 0, 0, 0, 0, color};
+  ellipseRuns(shape, rx, ry);
+}
+
+/*
+  void fillEllipse(int16_t, int16_t, uint16_t, uint16_t, uint16_t) draws a filled ellipse with the radii rx and ry.
+*/
+void ILI9341::fillEllipse(int16_t xc, int16_t yc, uint16_t rx, uint16_t ry, uint16_t color)
+{
+  ILI9341_PRIMITIVE(ILI9341_PRIMITIVE_FILL_ELLIPSE);
+
+  Rect visible;
+  if(!clipArea(xc - rx, yc - ry, 2 * rx + 1, 2 * ry + 1, visible))
+  {
+    return;
+  }
+
+  if((rx == 0) || (ry == 0))
+  {
+    fillRectangle(xc - rx, yc - ry, 2 * rx + 1, 2 * ry + 1, color);
+    return;
+  }
+
+  ArcShape shape = {xc, yc, 0x0F, true, false, false, 0, 0, 0, 0, color};
+  ellipseRuns(shape, rx, ry);
+}
+
+/*
+  void drawArc(int16_t, int16_t, uint16_t, int16_t, int16_t, uint16_t) draws the part of a circle outline
+  between two angles in degrees. 0 degrees points to the right and angles increase clockwise.
+*/
+void ILI9341::drawArc(int16_t xc, int16_t yc, uint16_t r, int16_t startAngle, int16_t endAngle, uint16_t color)
+{
+  ILI9341_PRIMITIVE(ILI9341_PRIMITIVE_DRAW_ARC);
+
+  Rect visible;
+  if(!clipArea(xc - r, yc - r, 2 * r + 1, 2 * r + 1, visible))
+  {
+    return;
+  }
+
+  if(endAngle - startAngle >= 360)
+  {
+    drawCircle(xc, yc, r, color);
+    return;
+  }
+
+  int16_t sweep = (((endAngle - startAngle) % 360) + 360) % 360;
+  float start = startAngle * 3.14159265f / 180.0f;
+  float end = (startAngle + sweep) * 3.14159265f / 180.0f;
+
+  ArcShape shape;
+  shape.xc = xc;
+  shape.yc = yc;
+  shape.corners = 0x0F;
+  shape.fill = false;
+  shape.sector = true;
+  shape.wide = (sweep > 180);
+  shape.startX = (int32_t)lroundf(cosf(start) * 16384);
+  shape.startY = (int32_t)lroundf(sinf(start) * 16384);
+  shape.endX = (int32_t)lroundf(cosf(end) * 16384);
+  shape.endY = (int32_t)lroundf(sinf(end) * 16384);
+  shape.color = color;
+  circleRuns(shape, r);
+}
+
+/*
+  int8_t signumFunc(int16_t) returns sign of a number.
+*/
+int8_t ILI9341::signumFunc(int16_t x)
+{
+  return (x > 0) ? 1 : (x < 0) ? -1 : 0;
+}
+
+/*
+  void drawLineRun(int16_t, int16_t, int16_t, int16_t, bool, uint16_t, uint16_t) draws one straight run of a line
+  between two points on the same row (or column if steep) as a single rectangle. The thickness is applied
+  across the run, centered on the line.
+*/
+void ILI9341::drawLineRun(int16_t xa, int16_t ya, int16_t xb, int16_t yb, bool steep, uint16_t thickness, uint16_t color)
+{
+  int16_t offset = (thickness - 1) / 2;
+
+  if(steep)
+  {
+    int16_t top = (ya < yb) ? ya : yb;
+    fillRectangle(xa - offset, top, thickness, abs(yb - ya) + 1, color);
+  }
+  else
+  {
+    int16_t left = (xa < xb) ? xa : xb;
+    fillRectangle(left, ya - offset, abs(xb - xa) + 1, thickness, color);
+  }
+}
+
+/*
+  void drawLine(int16_t, int16_t, int16_t, int16_t, uint16_t, uint16_t) draws a line on the display using Bresenham algorythm.
+  Consecutive steps on the same row (or column for steep lines) are collected into runs that are sent with
+  one address window each. Lines with a thickness > 1 are widened across their major direction.
+
+  Source: https://de.wikipedia.org/wiki/Bresenham-Algorithmus
+*/
+void ILI9341::drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color, uint16_t thickness)
+{
+  ILI9341_PRIMITIVE(ILI9341_PRIMITIVE_DRAW_LINE);
+
+  if(thickness == 0)
+  {
+    thickness = 1;
+  }
+
+  Rect visible;
+  int32_t offset = (thickness - 1) / 2;
+  if(!clipArea(std::min(x0, x1) - offset, std::min(y0, y1) - offset, abs(x1 - x0) + thickness, abs(y1 - y0) + thickness, visible))
+  {
+    return;
+  }
+
+  int x, y;
+  int dx, dy;     // Distance between points in both dimensions
+  int incx, incy; // Sign of increment 
+  int pdx, pdy;   // Parallelstep in x/y dimension
+  int ddx, ddy;   // Diagonalstep ub x/y dimension
+  int dsd;        // Delta-Slow-Direction
+  int dfd;        // Delta-Fast-Direction
+  int err;        // Error
+
+  dx = x1 - x0;
+  dy = y1 - y0;
+
+  incx = signumFunc(dx);
+  incy = signumFunc(dy);
+
+  if(dx < 0)
+  {
+    dx = -dx;
+  }
+
+  if(dy < 0)
+  {
+    dy = -dy;
+  }
+
+  if(dx > dy)
+  {
+    pdx = incx; pdy = 0;
+    ddx = incx; ddy = incy;
+    dsd = dy;
+    dfd = dx;
+  }
+  else
+  {
+    pdx = 0; pdy = incy;
+    ddx = incx; ddy = incy;
+    dsd = dx;
+    dfd = dy;
+  }
+
+  x = x0;
+  y = y0;
+  err = dfd / 2;
+
+  bool steep = (pdx == 0);
+  int runX = x;    // First point of the current run
+  int runY = y;
+
+  for(int t = 0; t < dfd; ++t)
+  {
+    err -= dsd;
+
+    if(err < 0)
+    {
+      // Diagonal step ends the current run
+      drawLineRun(runX, runY, x, y, steep, thickness, color);
+      err += dfd;
+      x += ddx;
+      y += ddy;
+      runX = x;
+      runY = y;
+    }
+    else
+    {
+      x += pdx;
+      y += pdy;
+    }
+  }
+
+  drawLineRun(runX, runY, x, y, steep, thickness, color);
+}
+
+/*
+  void drawTriangle(int16_t, int16_t, int16_t, int16_t, int16_t, int16_t, uint16_t) draws a triangle on the display.
+*/
+void ILI9341::drawTriangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint16_t color)
+{
+  ILI9341_PRIMITIVE(ILI9341_PRIMITIVE_DRAW_TRIANGLE);
+
+  Rect visible;
+  int16_t left = std::min(x0, std::min(x1, x2));
+  int16_t top = std::min(y0, std::min(y1, y2));
+  if(!clipArea(left, top, std::max(x0, std::max(x1, x2)) - left + 1, std::max(y0, std::max(y1, y2)) - top + 1, visible))
+  {
+    return;
+  }
+
+  drawLine(x0, y0, x1, y1, color);
+  drawLine(x1, y1, x2, y2, color);
+  drawLine(x2, y2, x0, y0, color);
+}
+
+/*
+  void fillTriangle(int16_t, int16_t, int16_t, int16_t, int16_t, int16_t, uint16_t) draws a filled triangle on the display.
+  Only the scanlines inside the clip rectangle are computed.
+*/
+void ILI9341::fillTriangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint16_t color)
+{
+  ILI9341_PRIMITIVE(ILI9341_PRIMITIVE_FILL_TRIANGLE);
+
+  Rect visible;
+  int16_t left = std::min(x0, std::min(x1, x2));
+  int16_t top = std::min(y0, std::min(y1, y2));
+  if(!clipArea(left, top, std::max(x0, std::max(x1, x2)) - left + 1, std::max(y0, std::max(y1, y2)) - top + 1, visible))
+  {
+    return;
+  }
+
+  int32_t a, b, y, last;
 
   // Sort coordinates by Y order (y2 >= y1 >= y0)
   if(y0 > y1)
   {
-    swap(y0, y1);
-    swap(x0, x1);
+    std::swap(y0, y1);
+    std::swap(x0, x1);
   }
 
   if(y1 > y2)
   {
-    swap(y2, y1);
-    swap(x2, x1);
+    std::swap(y2, y1);
+    std::swap(x2, x1);
   }
 
   if(y0 > y1)
   {
-    swap(y0, y1);
-    swap(x0, x1);
+    std::swap(y0, y1);
+    std::swap(x0, x1);
   }
 
   if(y0 == y2)
@@ -613,14 +2285,13 @@ void ILI9341::fillTriangle(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, u
     return;
   }
 
-  int16_t dx01 = x1 - x0;
-  int16_t dy01 = y1 - y0;
-  int16_t dx02 = x2 - x0;
-  int16_t dy02 = y2 - y0;
-  int16_t dx12 = x2 - x1;
-  int16_t dy12 = y2 - y1;
-  int16_t sa   = 0;
-  int16_t sb   = 0;
+  int32_t dx01 = x1 - x0;
+  int32_t dy01 = y1 - y0;
+  int32_t dx02 = x2 - x0;
+  int32_t dy02 = y2 - y0;
+  int32_t dx12 = x2 - x1;
+  int32_t dy12 = y2 - y1;
+  int32_t sa, sb;
 
   // For upper part of triangle, find scanline crossings for segments
   // 0-1 and 0-2.  If y1=y2 (flat-bottomed triangle), the scanline y1
@@ -637,7 +2308,12 @@ void ILI9341::fillTriangle(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, u
     last = y1 - 1; // Skip it
   }
 
-  for(y = y0; y <= last; y++)
+  // Rows above the clip rectangle are skipped by starting the crossings at the first visible row
+  y = std::max<int32_t>(y0, visible.y0);
+  last = std::min<int32_t>(last, visible.y1);
+  sa = dx01 * (y - y0);
+  sb = dx02 * (y - y0);
+  for(; y <= last; y++)
   {
     a = x0 + sa / dy01;
     b = x0 + sb / dy02;
@@ -646,7 +2322,7 @@ void ILI9341::fillTriangle(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, u
 
     if(a > b)
     {
-      swap(a, b);
+      std::swap(a, b);
     }
 
     drawHLine(a, y, b - a + 1, color);
@@ -654,9 +2330,11 @@ void ILI9341::fillTriangle(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, u
 
   // For lower part of triangle, find scanline crossings for segments
   // 0-2 and 1-2.  This loop is skipped if y1=y2.
+  y = std::max<int32_t>(y, visible.y0);
+  last = std::min<int32_t>(y2, visible.y1);
   sa = dx12 * (y - y1);
   sb = dx02 * (y - y0);
-  for(; y <= y2; y++)
+  for(; y <= last; y++)
   {
     a = x1 + sa / dy12;
     b = x0 + sb / dy02;
@@ -665,7 +2343,7 @@ void ILI9341::fillTriangle(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, u
 
     if(a > b)
     {
-      swap(a, b);
+      std::swap(a, b);
     }
 
     drawHLine(a, y, b - a + 1, color);
@@ -673,59 +2351,638 @@ void ILI9341::fillTriangle(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, u
 }
 
 /*
-  void drawChar(uint16_t, uint16_t, uint16_t, unsigned char, uint16_t, uint16_t, uint16_t) draws an ASCII character on the display.
+  void fillPolygon(const ILI9341Point*, uint16_t, uint16_t, ILI9341FillRule) draws a filled polygon with count
+  vertices; the outline is closed from the last vertex back to the first. Vertices are pixel corners and a pixel
+  is filled when its center is inside the outline, so the corners of a rectangle fill the same pixels as
+  fillRectangle and polygons sharing an edge neither overlap nor leave a gap. Concave and self-intersecting
+  outlines are filled according to rule. Nothing is drawn if more than ILI9341_POLYGON_EDGES edges cross the
+  rows of the clip rectangle.
+*/
+void ILI9341::fillPolygon(const ILI9341Point* points, uint16_t count, uint16_t color, ILI9341FillRule rule)
+{
+  ILI9341_PRIMITIVE(ILI9341_PRIMITIVE_FILL_POLYGON);
+
+  EdgeTable table;
+  table.count = 0;
+  table.overflow = false;
+
+  for(uint16_t i = 0; i < count; i++)
+  {
+    const ILI9341Point& a = points[i];
+    const ILI9341Point& b = points[(i + 1) % count];
+
+    addEdge(table, a.x * 16, a.y * 16, b.x * 16, b.y * 16);
+  }
+
+  fillEdges(table, rule == ILI9341_FILL_NONZERO, color);
+}
+
+/*
+  void drawPolyline(const ILI9341Point*, uint16_t, uint16_t, uint16_t) draws count - 1 connected segments that are
+  thickness pixels wide. Vertices are pixel centers as for drawLine, which draws one pixel wide polylines. A
+  wider segment is a rectangle around its center line, lengthened by half the thickness at both ends so
+  consecutive segments overlap at the joint. The rectangles are filled together with the nonzero rule, so the
+  overlaps are sent once; up to ILI9341_POLYGON_EDGES / 4 segments are filled per pass.
+*/
+void ILI9341::drawPolyline(const ILI9341Point* points, uint16_t count, uint16_t color, uint16_t thickness)
+{
+  ILI9341_PRIMITIVE(ILI9341_PRIMITIVE_DRAW_POLYLINE);
+
+  if(count == 0)
+  {
+    return;
+  }
+
+  if(thickness <= 1)
+  {
+    for(uint16_t i = 0; i + 1 < count; i++)
+    {
+      drawLine(points[i].x, points[i].y, points[i + 1].x, points[i + 1].y, color);
+    }
+
+    if(count == 1)
+    {
+      drawPixel(points[0].x, points[0].y, color);
+    }
+    return;
+  }
+
+  EdgeTable table;
+  table.count = 0;
+  table.overflow = false;
+
+  float half = thickness * 8.0f;    // Half the thickness in 1/16 pixel
+  uint16_t segments = (count > 1) ? count - 1 : 1;
+
+  for(uint16_t i = 0; i < segments; i++)
+  {
+    const ILI9341Point& a = points[i];
+    const ILI9341Point& b = points[std::min<uint16_t>(i + 1, count - 1)];
+    float dx = (b.x - a.x) * 16.0f;
+    float dy = (b.y - a.y) * 16.0f;
+    float length = sqrtf(dx * dx + dy * dy);
+    float ex = (length > 0) ? dx * half / length : half;  // Half the thickness along the segment
+    float ey = (length > 0) ? dy * half / length : 0;
+    float nx = -ey;                                       // and across it
+    float ny = ex;
+    float ax = a.x * 16 + 8 - ex;
+    float ay = a.y * 16 + 8 - ey;
+    float bx = b.x * 16 + 8 + ex;
+    float by = b.y * 16 + 8 + ey;
+    float corners[4][2] = {{ax + nx, ay + ny}, {bx + nx, by + ny}, {bx - nx, by - ny}, {ax - nx, ay - ny}};
+
+    if(table.count + 4 > ILI9341_POLYGON_EDGES)
+    {
+      fillEdges(table, true, color);
+    }
+
+    for(uint8_t j = 0; j < 4; j++)
+    {
+      const float* from = corners[j];
+      const float* to = corners[(j + 1) % 4];
+
+      addEdge(table, (int32_t)lroundf(from[0]), (int32_t)lroundf(from[1]), (int32_t)lroundf(to[0]), (int32_t)lroundf(to[1]));
+    }
+  }
+
+  fillEdges(table, true, color);
+}
+
+/*
+  void drawRoundRectangle(int16_t, int16_t, uint16_t, uint16_t, uint16_t, uint16_t) draws the one pixel wide outline
+  of a rectangle with corners rounded to radius r. The outer and inner outlines are filled in one pass with the
+  even-odd rule.
+*/
+void ILI9341::drawRoundRectangle(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t r, uint16_t color)
+{
+  ILI9341_PRIMITIVE(ILI9341_PRIMITIVE_DRAW_ROUND_RECTANGLE);
+
+  if((w <= 2) || (h <= 2))
+  {
+    fillRoundRectangle(x, y, w, h, r, color);
+    return;
+  }
+
+  r = std::min<uint16_t>(r, std::min(w, h) / 2);
+
+  EdgeTable table;
+  uint16_t segments = std::min(1 + r / 6, (ILI9341_POLYGON_EDGES - 8) / 8);
+
+  table.count = 0;
+  table.overflow = false;
+  addRoundOutline(table, x * 16, y * 16, w * 16, h * 16, r * 16, segments);
+  addRoundOutline(table, (x + 1) * 16, (y + 1) * 16, (w - 2) * 16, (h - 2) * 16, std::max(r - 1, 0) * 16, segments);
+  fillEdges(table, false, color);
+}
+
+/*
+  void fillRoundRectangle(int16_t, int16_t, uint16_t, uint16_t, uint16_t, uint16_t) draws a filled rectangle with
+  corners rounded to radius r (at most half the shorter side). Each corner is approximated by up to
+  (ILI9341_POLYGON_EDGES - 4) / 4 edges.
+*/
+void ILI9341::fillRoundRectangle(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t r, uint16_t color)
+{
+  ILI9341_PRIMITIVE(ILI9341_PRIMITIVE_FILL_ROUND_RECTANGLE);
+
+  r = std::min<uint16_t>(r, std::min(w, h) / 2);
+
+  EdgeTable table;
+  uint16_t segments = std::min(1 + r / 6, (ILI9341_POLYGON_EDGES - 4) / 4);
+
+  table.count = 0;
+  table.overflow = false;
+  addRoundOutline(table, x * 16, y * 16, w * 16, h * 16, r * 16, segments);
+  fillEdges(table, false, color);
+}
+
+/*
+  void addEdge(EdgeTable&, int32_t, int32_t, int32_t, int32_t) adds the edge from (x0, y0) to (x1, y1), in 1/16 pixel,
+  to a table. Only the rows inside the clip rectangle whose centers the edge crosses are kept, so horizontal edges
+  and edges above or below the clip rectangle add nothing.
+*/
+void ILI9341::addEdge(EdgeTable& table, int32_t x0, int32_t y0, int32_t x1, int32_t y1)
+{
+  int8_t winding = 1;
+
+  if(y0 > y1)
+  {
+    std::swap(x0, x1);
+    std::swap(y0, y1);
+    winding = -1;
+  }
+
+  // Rows whose center (16 * row + 8) lies in [y0, y1)
+  int32_t first = (y0 + 7) >> 4;
+  int32_t top = std::max<int32_t>(first, clip.y0);
+  int32_t bottom = std::min<int32_t>((y1 + 7) >> 4, clip.y1 + 1);
+
+  if(top >= bottom)
+  {
+    return;
+  }
+
+  if(table.count == ILI9341_POLYGON_EDGES)
+  {
+    table.overflow = true;
+    return;
+  }
+
+  int64_t dx = x1 - x0;
+  int64_t dy = y1 - y0;
+  int64_t offset = (first * 16 + 8 - y0) * dx * 256;
+  int64_t step = dx * 4096;
+  PolygonEdge& edge = table.edges[table.count++];
+
+  // Rounded to the nearest 1/4096 pixel, so the error stays below 1/4096 pixel per row in either direction
+  offset = (offset >= 0) ? (offset + dy / 2) / dy : -((dy / 2 - offset) / dy);
+  step = (step >= 0) ? (step + dy / 2) / dy : -((dy / 2 - step) / dy);
+  // Rows above the clip rectangle are stepped over like drawn ones, so clipping never moves the edge
+  edge.x = (int32_t)((int64_t)x0 * 256 + offset + step * (top - first));
+  edge.step = (int32_t)std::max<int64_t>(INT32_MIN, std::min<int64_t>(INT32_MAX, step));
+  edge.top = top;
+  edge.bottom = bottom;
+  edge.winding = winding;
+}
+
+/*
+  void addRoundOutline(EdgeTable&, int32_t, int32_t, int32_t, int32_t, int32_t, uint16_t) adds the outline of a
+  w * h rectangle at (x, y) with corners rounded to radius r, all in 1/16 pixel. Every corner is approximated by
+  segments edges.
+*/
+void ILI9341::addRoundOutline(EdgeTable& table, int32_t x, int32_t y, int32_t w, int32_t h, int32_t r, uint16_t segments)
+{
+  int32_t firstX = 0, firstY = 0;
+  int32_t lastX = 0, lastY = 0;
+
+  // Corners clockwise from the top right one, each from its start angle to 90 degrees further
+  for(uint8_t corner = 0; corner < 4; corner++)
+  {
+    int32_t cx = (corner < 2) ? x + w - r : x + r;
+    int32_t cy = ((corner == 0) || (corner == 3)) ? y + r : y + h - r;
+
+    for(uint16_t i = 0; i <= segments; i++)
+    {
+      float angle = (corner - 1 + (float)i / segments) * 3.14159265f / 2.0f;
+      int32_t px = cx + (int32_t)lroundf(cosf(angle) * r);
+      int32_t py = cy + (int32_t)lroundf(sinf(angle) * r);
+
+      if((corner == 0) && (i == 0))
+      {
+        firstX = px;
+        firstY = py;
+      }
+      else
+      {
+        addEdge(table, lastX, lastY, px, py);
+      }
+
+      lastX = px;
+      lastY = py;
+    }
+  }
+
+  addEdge(table, lastX, lastY, firstX, firstY);
+}
+
+/*
+  void fillEdges(EdgeTable&, bool, uint16_t) fills the outlines of an edge table by scanline conversion with an
+  active edge table, then empties the table. The edges are sorted by their first row; on every row the edges
+  crossing it are kept sorted by x and the spans between them are found with the nonzero or even-odd rule.
+  Consecutive rows with the same spans form a band that is sent with one address window per span.
 */
-void ILI9341::drawChar(uint16_t x, uint16_t y, unsigned char c, uint16_t size, uint16_t foreColor, uint16_t backColor)
+void ILI9341::fillEdges(EdgeTable& table, bool nonZero, uint16_t color)
 {
-  if((x >= width) ||
-    (y >= height) ||
-    ((x + 6 * size - 1) < 0) ||
-    ((y + 8 * size - 1) < 0))
+  // Pixels x0 to x1 - 1 of a row
+  struct Span
+  {
+    uint16_t x0, x1;
+  };
+
+  PolygonEdge* edges = table.edges;
+  uint16_t count = table.overflow ? 0 : table.count;
+
+  table.count = 0;
+  table.overflow = false;
+
+  if(count == 0)
   {
     return;
   }
 
-  for(int8_t i = 0; i < 5; i++)
+  // Sort by first row (the edges of an outline are mostly in order already)
+  uint16_t bottom = 0;
+
+  for(uint16_t i = 0; i < count; i++)
+  {
+    PolygonEdge edge = edges[i];
+    uint16_t j = i;
+
+    for(; (j > 0) && (edges[j - 1].top > edge.top); j--)
+    {
+      edges[j] = edges[j - 1];
+    }
+    edges[j] = edge;
+    bottom = std::max(bottom, edge.bottom);
+  }
+
+  uint16_t active[ILI9341_POLYGON_EDGES];
+  uint16_t activeCount = 0;
+  uint16_t next = 0;
+  Span spans[2][ILI9341_POLYGON_EDGES / 2];
+  uint16_t spanCount[2] = {0, 0};
+  uint8_t band = 0;                 // Spans of the band; the other array collects the current row
+  uint16_t bandTop = 0;
+  uint16_t bandRows = 0;
+
+  for(uint16_t y = edges[0].top; y <= bottom; y++)
   {
-    uint8_t line = font[c * 5 + i];
+    Span* row = spans[band ^ 1];
+    uint16_t rowCount = 0;
 
-    for(int8_t j = 0; j < 8; j++)
+    if(y < bottom)
     {
-      if(line & 0x01)
+      // Edges starting on this row join, finished ones leave
+      while((next < count) && (edges[next].top == y))
+      {
+        active[activeCount++] = next++;
+      }
+
+      uint16_t kept = 0;
+      for(uint16_t i = 0; i < activeCount; i++)
       {
-        if(size == 1)
+        if(edges[active[i]].bottom > y)
         {
-          drawPixel(x + i, y + j, foreColor);
+          active[kept++] = active[i];
         }
-        else
+      }
+      activeCount = kept;
+
+      // Sort by crossing (the order only changes where edges intersect)
+      for(uint16_t i = 1; i < activeCount; i++)
+      {
+        uint16_t index = active[i];
+        uint16_t j = i;
+
+        for(; (j > 0) && (edges[active[j - 1]].x > edges[index].x); j--)
+        {
+          active[j] = active[j - 1];
+        }
+        active[j] = index;
+      }
+
+      int16_t winding = 0;
+      int32_t start = 0;
+
+      for(uint16_t i = 0; i < activeCount; i++)
+      {
+        PolygonEdge& edge = edges[active[i]];
+        bool wasInside = nonZero ? (winding != 0) : (i & 1);
+
+        winding += edge.winding;
+        bool inside = nonZero ? (winding != 0) : !(i & 1);
+
+        if(!wasInside && inside)
+        {
+          start = edge.x;
+        }
+        else if(wasInside && !inside)
+        {
+          // Pixels whose centers lie in [start, edge.x)
+          int32_t x0 = std::max<int32_t>((start + 2047) >> 12, clip.x0);
+          int32_t x1 = std::min<int32_t>((edge.x + 2047) >> 12, clip.x1 + 1);
+
+          if(x0 < x1)
+          {
+            if((rowCount > 0) && (row[rowCount - 1].x1 >= x0))
+            {
+              row[rowCount - 1].x1 = std::max<int32_t>(row[rowCount - 1].x1, x1);
+            }
+            else
+            {
+              row[rowCount].x0 = x0;
+              row[rowCount].x1 = x1;
+              rowCount++;
+            }
+          }
+        }
+
+        edge.x += edge.step;
+      }
+
+      if((bandRows > 0) && (rowCount == spanCount[band]) && (memcmp(row, spans[band], rowCount * sizeof(Span)) == 0))
+      {
+        bandRows++;
+        continue;
+      }
+    }
+
+    // The band ends: send it and start a new one with this row
+    for(uint16_t i = 0; i < spanCount[band]; i++)
+    {
+      uint16_t w = spans[band][i].x1 - spans[band][i].x0;
+
+      setAddrWindow(spans[band][i].x0, bandTop, w, bandRows);
+      writeColor(color, (size_t)w * bandRows);
+    }
+
+    band ^= 1;
+    spanCount[band] = rowCount;
+    bandTop = y;
+    bandRows = 1;
+  }
+
+  endTransaction();
+}
+
+/*
+  void setGlyphCacheBudget(size_t) sets the memory budget in bytes for pre-rendered glyphs. Opaque glyphs drawn
+  by drawChar are expanded once per (character, size, foreColor, backColor) and sent with a single burst on
+  later draws. The least recently used glyphs are evicted when the budget or ILI9341_GLYPH_CACHE_ENTRIES is
+  exceeded. A budget of 0 disables the cache and frees its memory.
+*/
+void ILI9341::setGlyphCacheBudget(size_t bytes)
+{
+  glyphCacheBudget = bytes;
+
+  // Shrink by evicting least recently used glyphs first
+  while(glyphCacheUsed > glyphCacheBudget)
+  {
+    GlyphCacheEntry* oldest = NULL;
+
+    for(auto i = 0; i < ILI9341_GLYPH_CACHE_ENTRIES; i++)
+    {
+      GlyphCacheEntry* entry = &glyphCache[i];
+
+      if((entry->pixels != NULL) && ((oldest == NULL) || (entry->lastUse < oldest->lastUse)))
+      {
+        oldest = entry;
+      }
+    }
+
+    evictGlyph(oldest);
+  }
+}
+
+/*
+  uint32_t getGlyphCacheHits(void) returns the number of glyphs served from the glyph cache.
+*/
+uint32_t ILI9341::getGlyphCacheHits(void)
+{
+  return glyphCacheHits;
+}
+
+/*
+  uint32_t getGlyphCacheMisses(void) returns the number of glyphs that had to be rendered into the glyph cache.
+*/
+uint32_t ILI9341::getGlyphCacheMisses(void)
+{
+  return glyphCacheMisses;
+}
+
+/*
+  void resetGlyphCacheStats(void) resets the hit and miss counters of the glyph cache.
+*/
+void ILI9341::resetGlyphCacheStats(void)
+{
+  glyphCacheHits = 0;
+  glyphCacheMisses = 0;
+}
+
+/*
+  void evictGlyph(GlyphCacheEntry*) frees a glyph cache entry once no transfer is reading from it.
+*/
+void ILI9341::evictGlyph(GlyphCacheEntry* entry)
+{
+  waitIdle();
+  glyphCacheUsed -= entry->length;
+  delete[] entry->pixels;
+  entry->pixels = NULL;
+}
+
+/*
+  GlyphCacheEntry* cacheGlyph(unsigned char, uint16_t, uint16_t, uint16_t) looks up a glyph in the cache and renders
+  it on a miss, evicting least recently used glyphs as needed. Returns NULL if the glyph does not fit the budget.
+*/
+ILI9341::GlyphCacheEntry* ILI9341::cacheGlyph(unsigned char c, uint16_t size, uint16_t foreColor, uint16_t backColor)
+{
+  GlyphCacheEntry* slot = NULL;
+  size_t length = 5 * 8 * ILI9341Pixel::bytes * (size_t)size * size;
+
+  for(auto i = 0; i < ILI9341_GLYPH_CACHE_ENTRIES; i++)
+  {
+    GlyphCacheEntry* entry = &glyphCache[i];
+
+    if((entry->pixels != NULL) && (entry->c == c) && (entry->size == size) &&
+      (entry->foreColor == foreColor) && (entry->backColor == backColor))
+    {
+      entry->lastUse = ++glyphCacheClock;
+      glyphCacheHits++;
+      return entry;
+    }
+  }
+
+  glyphCacheMisses++;
+
+  if(length > glyphCacheBudget)
+  {
+    return NULL;
+  }
+
+  // Evict least recently used glyphs until the new one fits and a slot is free
+  while(true)
+  {
+    GlyphCacheEntry* oldest = NULL;
+    slot = NULL;
+
+    for(auto i = 0; i < ILI9341_GLYPH_CACHE_ENTRIES; i++)
+    {
+      GlyphCacheEntry* entry = &glyphCache[i];
+
+      if(entry->pixels == NULL)
+      {
+        slot = entry;
+      }
+      else if((oldest == NULL) || (entry->lastUse < oldest->lastUse))
+      {
+        oldest = entry;
+      }
+    }
+
+    if((slot != NULL) && (glyphCacheUsed + length <= glyphCacheBudget))
+    {
+      break;
+    }
+
+    evictGlyph(oldest);
+  }
+
+  slot->pixels = new uint8_t[length];
+  slot->length = length;
+  slot->c = c;
+  slot->size = size;
+  slot->foreColor = foreColor;
+  slot->backColor = backColor;
+  slot->lastUse = ++glyphCacheClock;
+  glyphCacheUsed += length;
+
+  const unsigned char* glyph = &font[c * 5];
+  uint8_t* dst = slot->pixels;
+
+  for(int8_t j = 0; j < 8; j++)
+  {
+    for(uint16_t k = 0; k < size; k++)
+    {
+      for(int8_t i = 0; i < 5; i++)
+      {
+        uint16_t color = (glyph[i] & (1 << j)) ? foreColor : backColor;
+
+        for(uint16_t n = 0; n < size; n++)
         {
-          fillRectangle(x + i * size, y + j * size, size, size, foreColor);
+          ILI9341Pixel::pack(dst, color);
+          dst += ILI9341Pixel::bytes;
         }
       }
-      else if(backColor != foreColor)
+    }
+  }
+
+  return slot;
+}
+
+/*
+  void drawChar(int16_t, int16_t, unsigned char, uint16_t, uint16_t, uint16_t) draws an ASCII character on the display.
+  With a background color the visible part of the glyph cell is sent through one address window, row by row from
+  the line buffers, or in one burst from the glyph cache if it is enabled and the cell is not clipped. If foreColor
+  equals backColor the background is transparent and only the dots of each font column are drawn as vertical runs.
+*/
+void ILI9341::drawChar(int16_t x, int16_t y, unsigned char c, uint16_t size, uint16_t foreColor, uint16_t backColor)
+{
+  ILI9341_PRIMITIVE(ILI9341_PRIMITIVE_DRAW_CHAR);
+
+  Rect visible;
+  if(!clipArea(x, y, 5 * size, 8 * size, visible))
+  {
+    return;
+  }
+
+  const unsigned char* glyph = &font[c * 5];
+
+  if(backColor == foreColor)
+  {
+    for(int8_t i = 0; i < 5; i++)
+    {
+      uint8_t line = glyph[i];
+      int8_t j = 0;
+
+      while(line)
       {
-        if(size == 1)
+        if(line & 0x01)
         {
-          drawPixel(x + i, y + j, backColor);
+          int8_t run = 0;
+          while(line & 0x01)
+          {
+            run++;
+            line >>= 1;
+          }
+
+          fillRectangle(x + i * size, y + j * size, size, run * size, foreColor);
+          j += run;
         }
         else
         {
-          fillRectangle(x + i * size, y + j * size, size, size, backColor);
+          line >>= 1;
+          j++;
         }
       }
+    }
+    return;
+  }
 
-      line >>= 1;
+  uint16_t cw = visible.x1 - visible.x0 + 1;
+  uint16_t ch = visible.y1 - visible.y0 + 1;
+
+  setAddrWindow(visible.x0, visible.y0, cw, ch);
+
+  if((glyphCacheBudget > 0) && !canvasActive() && (cw == 5 * size) && (ch == 8 * size))
+  {
+    GlyphCacheEntry* entry = cacheGlyph(c, size, foreColor, backColor);
+
+    if(entry != NULL)
+    {
+      sendBuffer(entry->pixels, entry->length);
+      endTransaction();
+      return;
+    }
+  }
+
+  for(int32_t py = visible.y0; py <= visible.y1; py++)
+  {
+    uint8_t bit = 1 << ((py - y) / size);
+
+    for(int8_t i = 0; i < 5; i++)
+    {
+      int32_t start = std::max<int32_t>(x + i * size, visible.x0);
+      int32_t end = std::min<int32_t>(x + (i + 1) * size - 1, visible.x1);
+
+      if(start <= end)
+      {
+        queueColor((glyph[i] & bit) ? foreColor : backColor, end - start + 1);
+      }
     }
   }
+
+  flushQueue();
+  endTransaction();
 }
 
 /*
-  void drawString(uint16_t, uint16_t, const char*, uint16_t, uint16_t, uint16_t, uint16_t) draws a string on the display.
+  void drawString(int16_t, int16_t, const char*, uint16_t, uint16_t, uint16_t, uint16_t) draws a string on the display.
 */
-void ILI9341::drawString(uint16_t x, uint16_t y, const char* str, uint16_t strSize, uint16_t charSize, uint16_t foreColor, uint16_t backColor)
+void ILI9341::drawString(int16_t x, int16_t y, const char* str, uint16_t strSize, uint16_t charSize, uint16_t foreColor, uint16_t backColor)
 {
-  uint16_t xi = x;
-  for(auto i = 0; i < strSize; i++)
+  ILI9341_PRIMITIVE(ILI9341_PRIMITIVE_DRAW_STRING);
+
+  int32_t xi = x;
+  for(auto i = 0; (i < strSize) && (xi <= clip.x1); i++)
   {
     drawChar(xi, y, str[i], charSize, foreColor, backColor);
     xi += 5 * charSize + 1; // 5 * charSize is the width of one drawn character + 1 for space between character.
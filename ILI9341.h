@@ -1,4 +1,8 @@
-#include "mbed.h"
+#include "ILI9341Bus.h"
+#if defined(__MBED__)
+#include "ILI9341MbedBus.h"
+#endif
+#include <cstddef>
 #include <cstdint>
 
 // ILI9341 SPI Commands
@@ -28,6 +32,8 @@
 #define ILI9341_PASET       0x2B  // Page Address Set
 #define ILI9341_RAMWR       0x2C  // Memory Write
 #define ILI9341_RAMRD       0x2E  // Memory Read
+#define ILI9341_RAMWRCONT   0x3C  // Memory Write Continue
+#define ILI9341_RAMRDCONT   0x3E  // Memory Read Continue
 
 #define ILI9341_PTLAR       0x30  // Partial Area
 #define ILI9341_VSCRDEF     0x33  // Vertical Scrolling Definition
@@ -89,41 +95,435 @@
 #define ILI9341_TFTWIDTH    240
 #define ILI9341_TFTHEIGHT   320
 
+// Initialization tables: entries of command, argument count and arguments, ended by a 0x00 command. With
+// ILI9341_INIT_DELAY set in the count, a delay in milliseconds (0-255) follows the arguments.
+#define ILI9341_INIT_DELAY          0x80
+
+#ifndef ILI9341_RESET_MS
+#define ILI9341_RESET_MS            5   // Wait after the hardware reset of a sleeping panel; 120 ms are used if this driver woke the panel before
+#endif
+
+#ifndef ILI9341_LINE_BUFFER_PIXELS
+#define ILI9341_LINE_BUFFER_PIXELS  64  // Pixels sent per block transfer by writePixels/writeColor
+#endif
+
+#ifndef ILI9341_GLYPH_CACHE_ENTRIES
+#define ILI9341_GLYPH_CACHE_ENTRIES 32  // Maximum number of pre-rendered glyphs kept by the glyph cache
+#endif
+
+#ifndef ILI9341_DIRTY_RECTS
+#define ILI9341_DIRTY_RECTS         8   // Damaged regions tracked in canvas mode before they are merged
+#endif
+
+#ifndef ILI9341_POLYGON_EDGES
+#define ILI9341_POLYGON_EDGES       64  // Edges of one polygon fill (the edge table is kept on the stack, 16 bytes per edge)
+#endif
+
+#ifndef ILI9341_CLIP_DEPTH
+#define ILI9341_CLIP_DEPTH          8   // Nesting levels of pushClipRect
+#endif
+
+#define ILI9341_RGB565              16  // 2 bytes per pixel on the bus
+#define ILI9341_RGB666              18  // 3 bytes per pixel on the bus, 6 bits of each component left aligned
+
+#ifndef ILI9341_PIXEL_FORMAT
+#define ILI9341_PIXEL_FORMAT        ILI9341_RGB565  // Interface pixel format (COLMOD) the pixel loops are compiled for; set for the whole build
+#endif
+
+#ifndef ILI9341_YIELD_BYTES
+#define ILI9341_YIELD_BYTES         4096  // Bytes sent on a shared bus before it is released for other devices (0 = never)
+#endif
+
+#ifndef ILI9341_STATS
+#define ILI9341_STATS               0   // 1 = count bus traffic per primitive (getStats/resetStats/estimateMicros); set for the whole build
+#endif
+
+// RLE sprite tokens: one word with the kind in the top two bits and the pixel count below, followed by the
+// pixel words of the token (see ILI9341Sprite and tools/rle565.py)
+#define ILI9341_RLE_LITERAL(n)      (uint16_t)(0x0000 | (n))  // n pixel words follow
+#define ILI9341_RLE_REPEAT(n)       (uint16_t)(0x4000 | (n))  // One pixel word follows, drawn n times
+#define ILI9341_RLE_SKIP(n)         (uint16_t)(0x8000 | (n))  // n transparent pixels, no pixel words
+#define ILI9341_RLE_KIND_MASK       0xC000
+#define ILI9341_RLE_COUNT_MASK      0x3FFF
+
+// Cost model used by estimateMicros for work that is not bus clock time
+#ifndef ILI9341_COST_COMMAND_NS
+#define ILI9341_COST_COMMAND_NS     200   // Data/command line switching around a command byte
+#endif
+#ifndef ILI9341_COST_TRANSFER_NS
+#define ILI9341_COST_TRANSFER_NS    1000  // Setting up one block transfer
+#endif
+#ifndef ILI9341_COST_CS_NS
+#define ILI9341_COST_CS_NS          100   // One chip select edge
+#endif
+#ifndef ILI9341_COST_FORMAT_NS
+#define ILI9341_COST_FORMAT_NS      2000  // Reconfiguring the SPI peripheral
+#endif
+
 #ifndef ILI9341_H
 #define ILI9341_H
+/*
+  ILI9341PixelFormat<format> holds the COLMOD value and the packing of an RGB565 color into bus bytes for one
+  interface pixel format. The driver uses the specialization selected by ILI9341_PIXEL_FORMAT, so the pixel loops
+  are compiled for a single format without a per-pixel branch.
+*/
+template<int Format> struct ILI9341PixelFormat;
+
+template<> struct ILI9341PixelFormat<ILI9341_RGB565>
+{
+  static constexpr uint8_t colmod = 0x55;
+  static constexpr uint8_t bytes = 2;
+
+  static inline void pack(uint8_t* dst, uint16_t color)
+  {
+    dst[0] = color >> 8;
+    dst[1] = color & 0xFF;
+  }
+};
+
+template<> struct ILI9341PixelFormat<ILI9341_RGB666>
+{
+  static constexpr uint8_t colmod = 0x66;
+  static constexpr uint8_t bytes = 3;
+
+  // The top bit of the 5-bit red and blue components is repeated as the 6th bit
+  static inline void pack(uint8_t* dst, uint16_t color)
+  {
+    dst[0] = ((color >> 8) & 0xF8) | ((color >> 13) & 0x04);
+    dst[1] = (color >> 3) & 0xFC;
+    dst[2] = ((color << 3) & 0xF8) | ((color >> 2) & 0x04);
+  }
+};
+
+typedef ILI9341PixelFormat<ILI9341_PIXEL_FORMAT> ILI9341Pixel;
+
+// Public operations that bus traffic is attributed to by the statistics
+enum ILI9341Primitive
+{
+  ILI9341_PRIMITIVE_OTHER = 0,
+  ILI9341_PRIMITIVE_INITIALIZE,
+  ILI9341_PRIMITIVE_DRAW_PIXEL,
+  ILI9341_PRIMITIVE_DRAW_VLINE,
+  ILI9341_PRIMITIVE_DRAW_HLINE,
+  ILI9341_PRIMITIVE_DRAW_LINE,
+  ILI9341_PRIMITIVE_DRAW_RECTANGLE,
+  ILI9341_PRIMITIVE_FILL_RECTANGLE,
+  ILI9341_PRIMITIVE_DRAW_CIRCLE,
+  ILI9341_PRIMITIVE_FILL_CIRCLE,
+  ILI9341_PRIMITIVE_DRAW_ELLIPSE,
+  ILI9341_PRIMITIVE_FILL_ELLIPSE,
+  ILI9341_PRIMITIVE_DRAW_ARC,
+  ILI9341_PRIMITIVE_DRAW_TRIANGLE,
+  ILI9341_PRIMITIVE_FILL_TRIANGLE,
+  ILI9341_PRIMITIVE_FILL_POLYGON,
+  ILI9341_PRIMITIVE_DRAW_POLYLINE,
+  ILI9341_PRIMITIVE_DRAW_ROUND_RECTANGLE,
+  ILI9341_PRIMITIVE_FILL_ROUND_RECTANGLE,
+  ILI9341_PRIMITIVE_DRAW_CHAR,
+  ILI9341_PRIMITIVE_DRAW_STRING,
+  ILI9341_PRIMITIVE_FILL_BACKGROUND,
+  ILI9341_PRIMITIVE_SET_ROTATION,
+  ILI9341_PRIMITIVE_PIXEL_STREAM,   // setAddrWindow/writePixels/writeColor
+  ILI9341_PRIMITIVE_FLUSH,
+  ILI9341_PRIMITIVE_SCROLL,         // setScrollArea/setScrollOffset
+  ILI9341_PRIMITIVE_READ_PIXELS,
+  ILI9341_PRIMITIVE_DRAW_BITMAP,
+  ILI9341_PRIMITIVE_DRAW_SPRITE,
+  ILI9341_PRIMITIVE_COUNT
+};
+
+// Bus traffic counters
+struct ILI9341BusStats
+{
+  uint32_t calls;                   // Calls of the primitive (not counted for the total)
+  uint32_t commands;                // Command bytes
+  uint32_t dataBytes;               // Parameter and pixel bytes
+  uint32_t transfers;               // Block transfers started
+  uint32_t csToggles;               // Chip select edges
+  uint32_t formatSwitches;          // SPI reconfigurations
+  uint32_t windowSetups;            // Address windows sent to the controller
+};
+
+// Snapshot of all counters
+struct ILI9341Stats
+{
+  ILI9341BusStats total;
+  ILI9341BusStats primitive[ILI9341_PRIMITIVE_COUNT];
+  ILI9341BusStats longestHold;      // Longest chip select assertion (estimateMicros gives the worst wait of other bus users)
+};
+
+// RLE compressed RGB565 image. Every row is a sequence of tokens covering exactly width pixels; tokens never
+// span rows. The layout is a plain aggregate, so sprites can be constexpr and stay in flash.
+struct ILI9341Sprite
+{
+  uint16_t width;
+  uint16_t height;
+  const uint16_t* data;
+};
+
+// Polygon vertex
+struct ILI9341Point
+{
+  int16_t x;
+  int16_t y;
+};
+
+// Which parts of a self-intersecting polygon (or one with holes) fillPolygon fills
+enum ILI9341FillRule
+{
+  ILI9341_FILL_EVEN_ODD = 0,        // Inside if a ray crosses the outline an odd number of times
+  ILI9341_FILL_NONZERO              // Inside if the outline winds around the point
+};
+
 class ILI9341
 {
   public:
+#if defined(__MBED__)
     ILI9341(PinName mosi, PinName miso, PinName clk, PinName cs, PinName rst, PinName dc);
-    void initialize(void);
-    void drawPixel(uint16_t x, uint16_t y, uint16_t color);
-    void drawVLine(uint16_t x, uint16_t y, uint16_t h, uint16_t color);
-    void drawHLine(uint16_t x, uint16_t	y, uint16_t w, uint16_t color);
-    void drawLine(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, uint16_t color);
-    void drawRectangle(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t color);
-    void fillRectangle(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t color);
-    void drawCircle(uint16_t xc, uint16_t yc, uint16_t r, uint16_t color);
-    void fillCircle(uint16_t xc, uint16_t yc, uint16_t r, uint16_t color);
-    void drawTriangle(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint16_t color);
-    void fillTriangle(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint16_t color);
-    void drawChar(uint16_t x, uint16_t y, unsigned char c, uint16_t size, uint16_t foreColor, uint16_t backColor);
-    void drawString(uint16_t x, uint16_t y, const char* str, uint16_t strSize, uint16_t charSize, uint16_t foreColor, uint16_t backColor);
+#endif
+    ILI9341(ILI9341Bus& bus);
+    ~ILI9341();
+    void initialize(const uint8_t* table = NULL);
+#if defined(__MBED__)
+    void initialize(EventQueue& queue, Callback<void()> ready = nullptr, const uint8_t* table = NULL);
+#endif
+    void beginInitialize(const uint8_t* table = NULL);
+    uint32_t initializeStep(void);
+    bool isInitialized(void);
+    void drawPixel(int16_t x, int16_t y, uint16_t color);
+    void drawVLine(int16_t x, int16_t y, uint16_t h, uint16_t color);
+    void drawHLine(int16_t x, int16_t y, uint16_t w, uint16_t color);
+    void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color, uint16_t thickness = 1);
+    void drawRectangle(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t color);
+    void fillRectangle(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t color);
+    void drawCircle(int16_t xc, int16_t yc, uint16_t r, uint16_t color);
+    void fillCircle(int16_t xc, int16_t yc, uint16_t r, uint16_t color);
+    void drawEllipse(int16_t xc, int16_t yc, uint16_t rx, uint16_t ry, uint16_t color);
+    void fillEllipse(int16_t xc, int16_t yc, uint16_t rx, uint16_t ry, uint16_t color);
+    void drawArc(int16_t xc, int16_t yc, uint16_t r, int16_t startAngle, int16_t endAngle, uint16_t color);
+    void drawTriangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint16_t color);
+    void fillTriangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint16_t color);
+    void fillPolygon(const ILI9341Point* points, uint16_t count, uint16_t color, ILI9341FillRule rule = ILI9341_FILL_EVEN_ODD);
+    void drawPolyline(const ILI9341Point* points, uint16_t count, uint16_t color, uint16_t thickness = 1);
+    void drawRoundRectangle(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t r, uint16_t color);
+    void fillRoundRectangle(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t r, uint16_t color);
+    void drawChar(int16_t x, int16_t y, unsigned char c, uint16_t size, uint16_t foreColor, uint16_t backColor);
+    void drawString(int16_t x, int16_t y, const char* str, uint16_t strSize, uint16_t charSize, uint16_t foreColor, uint16_t backColor);
     void fillBackground(uint16_t color);
+    void drawBitmap(int16_t x, int16_t y, const uint16_t* bitmap, uint16_t w, uint16_t h);
+    void drawBitmap(int16_t x, int16_t y, const uint16_t* bitmap, uint16_t w, uint16_t h, uint16_t transparentColor);
+    void drawBitmap(int16_t x, int16_t y, const uint8_t* bitmap, uint16_t w, uint16_t h, uint16_t foreColor, uint16_t backColor);
+    void drawSprite(int16_t x, int16_t y, const ILI9341Sprite& sprite);
     void setRotation(uint8_t rot);
+    void pushClipRect(int16_t x, int16_t y, uint16_t w, uint16_t h);
+    void popClipRect(void);
+    void getClipRect(int16_t& x, int16_t& y, uint16_t& w, uint16_t& h);
+    void setScrollArea(uint16_t topFixed, uint16_t bottomFixed);
+    void setScrollOffset(uint16_t offset);
+    uint16_t getScrollOffset(void);
+    void setAddrWindow(uint16_t x, uint16_t y, uint16_t w, uint16_t h);
+    void pauseWrite(void);
+    void continueWrite(void);
+    void writePixels(const uint16_t* pixels, size_t count);
+    void writeColor(uint16_t color, size_t count);
+    void startWrite(void);
+    void endWrite(void);
+    void readPixels(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t* out);
+    uint16_t getWidth(void);
+    uint16_t getHeight(void);
+    void setAsync(bool enable);
+    void flush(void);
+    bool isBusy(void);
+    void setCanvas(uint16_t* buffer, uint16_t x, uint16_t y, uint16_t w, uint16_t h);
+    void setGlyphCacheBudget(size_t bytes);
+    uint32_t getGlyphCacheHits(void);
+    uint32_t getGlyphCacheMisses(void);
+    void resetGlyphCacheStats(void);
+    uint32_t getSkippedCommands(void);
+    void setYieldBytes(uint32_t bytes);
+#if ILI9341_STATS
+    void getStats(ILI9341Stats& snapshot);
+    void resetStats(void);
+    uint32_t estimateMicros(const ILI9341BusStats& counters);
+#endif
+
+    // Keeps a startWrite/endWrite batch open for the lifetime of the scope
+    class WriteScope
+    {
+      public:
+        WriteScope(ILI9341& display) : display(display) { display.startWrite(); }
+        ~WriteScope() { display.endWrite(); }
+
+      private:
+        ILI9341& display;
+    };
 
   private:
-    SPI spi;
-    DigitalOut chipSelect;  // Chip Select Pin
-    DigitalOut reset;       // Reset Pin
-    DigitalOut dataCommand; // Data/Command Select Pin
+    ILI9341Bus* bus;
+    ILI9341Bus* ownedBus;           // Bus created by the pin constructor (deleted with the driver)
+#if ILI9341_STATS
+    // Attributes bus traffic to the outermost public primitive while it runs
+    class StatsScope
+    {
+      public:
+        StatsScope(ILI9341& display, ILI9341Primitive primitive);
+        ~StatsScope();
+
+      private:
+        ILI9341& display;
+        bool outermost;
+    };
+
+    ILI9341Stats stats;
+    ILI9341Primitive currentPrimitive;
+#endif
+    enum InitState
+    {
+      INIT_IDLE,                    // initialize() has not been called
+      INIT_RESET,                   // Pull the reset line low
+      INIT_WAKE,                    // Release the reset line
+      INIT_COMMANDS,                // Send the init table
+      INIT_DONE
+    };
+
+    InitState initState;
+    const uint8_t* initTable;       // Init table being sent
+    size_t initIndex;               // Next entry of initTable
+    bool panelAwake;                // This driver took the panel out of sleep (a reset then needs 120 ms)
+#if defined(__MBED__)
+    EventQueue* initQueue;          // Queue running the initialization steps
+    Callback<void()> initReady;     // Called once the initialization has finished
+#endif
     uint8_t orientation;
     uint16_t width;
     uint16_t height;
+    uint16_t scrollTop;             // Rows of the fixed area above the scroll area (panel rows)
+    uint16_t scrollHeight;          // Rows of the scroll area
+    uint16_t scrollOffset;          // Rows the scroll area content is moved up by
+    uint8_t lineBuffer[2][ILI9341_LINE_BUFFER_PIXELS * ILI9341Pixel::bytes]; // Pixel staging buffers in bus format (ping-pong in async mode)
+    uint8_t activeBuffer;           // Line buffer that may be filled next
+    bool asyncMode;
+    bool selected;                  // Chip select is asserted
+    uint8_t batchDepth;             // Nesting level of startWrite/endWrite batches
+    bool windowValid;               // windowX0..windowY1 match the controller's CASET/PASET ranges
+    uint16_t windowX0, windowX1;
+    uint16_t windowY0, windowY1;
+    uint32_t skippedCommands;       // CASET/PASET commands saved by the window cache
+    uint32_t yieldBytes;            // Bytes after which a shared bus is released (0 = never)
+    uint32_t holdBytes;             // Bytes sent since the chip select was asserted
+#if ILI9341_STATS
+    ILI9341BusStats holdStart;      // Total counters when the chip select was asserted
+#endif
+    uint8_t* queueBuffer;           // Line buffer being filled by queueColor (NULL = none)
+    uint16_t queueLength;           // Pixels in queueBuffer
+
+    struct Rect
+    {
+      uint16_t x0, y0, x1, y1;      // Inclusive corners
+    };
+
+    Rect clip;                      // Drawable area (x0 > x1 = nothing is drawn)
+    Rect clipStack[ILI9341_CLIP_DEPTH];
+    uint8_t clipDepth;
 
+    // Quadrant-symmetric shape emitted as pixel runs by circleRuns/ellipseRuns
+    struct ArcShape
+    {
+      int16_t xc, yc;
+      uint8_t corners;              // Quadrants to draw (0x01 top-left, 0x02 top-right, 0x04 bottom-right, 0x08 bottom-left)
+      bool fill;                    // Emit filled rows instead of the outline
+      bool sector;                  // Only draw pixels between the start and end direction
+      bool wide;                    // Sector is wider than 180 degrees
+      int32_t startX, startY;       // Sector start direction (Q14)
+      int32_t endX, endY;           // Sector end direction (Q14)
+      uint16_t color;
+    };
+
+    // Pre-rendered glyph cell (pixels in bus format, ready to send)
+    struct GlyphCacheEntry
+    {
+      uint8_t* pixels;              // NULL = unused entry
+      size_t length;                // Bytes in pixels
+      unsigned char c;
+      uint16_t size;
+      uint16_t foreColor;
+      uint16_t backColor;
+      uint32_t lastUse;             // Value of glyphCacheClock at the last hit (LRU)
+    };
+
+    // Non-horizontal polygon edge, clipped to the rows of the clip rectangle
+    struct PolygonEdge
+    {
+      int32_t x;                    // Crossing with the center of the current row (1/4096 pixel)
+      int32_t step;                 // Change of x per row (1/4096 pixel)
+      uint16_t top;                 // First row whose center the edge crosses
+      uint16_t bottom;              // Row after the last one
+      int8_t winding;               // +1 downwards, -1 upwards
+    };
+
+    // Edges of the outlines filled in one pass (vertices in 1/16 pixel)
+    struct EdgeTable
+    {
+      PolygonEdge edges[ILI9341_POLYGON_EDGES];
+      uint16_t count;
+      bool overflow;                // An edge did not fit; nothing is drawn
+    };
+
+    GlyphCacheEntry glyphCache[ILI9341_GLYPH_CACHE_ENTRIES];
+    size_t glyphCacheBudget;        // Maximum bytes of glyph pixels (0 = cache disabled)
+    size_t glyphCacheUsed;
+    uint32_t glyphCacheClock;
+    uint32_t glyphCacheHits;
+    uint32_t glyphCacheMisses;
+
+    uint16_t* canvas;               // Off-screen RGB565 buffer (NULL = draw straight to the panel)
+    Rect canvasArea;                // Screen area covered by the canvas
+    Rect canvasWindow;              // Address window of the pixel stream in canvas mode
+    uint16_t canvasCursorX;
+    uint16_t canvasCursorY;
+    Rect dirty[ILI9341_DIRTY_RECTS];
+    uint8_t dirtyCount;
+    bool flushingCanvas;
+
+    void init(void);
+#if defined(__MBED__)
+    void initializeEvent(void);
+#endif
     void writeCommand(uint8_t cmd);
-    void setAddrWindow(uint16_t x, uint16_t y, uint16_t w, uint16_t h);
-    void drawCircleHelper(uint16_t xc, uint16_t yc, uint16_t r, uint8_t corners, uint16_t color);
-    void fillCircleHelper(uint16_t xc, uint16_t yc, uint16_t r, uint8_t corners, uint16_t color);
+    void writeData(const uint8_t* data, size_t length);
+    void readData(uint8_t* data, size_t length);
+#if ILI9341_STATS
+    void countStat(uint32_t ILI9341BusStats::* field, uint32_t amount);
+#endif
+    void beginTransaction(void);
+    void endTransaction(void);
+    void selectBus(bool active);
+    bool yieldDue(void);
+    void yieldBus(uint8_t resumeCommand);
+    void invalidateWindow(void);
+    void setWindow(uint16_t x, uint16_t y, uint16_t x2, uint16_t y2);
+    void resetClip(void);
+    bool clipArea(int32_t x, int32_t y, int32_t w, int32_t h, Rect& visible);
+    void waitIdle(void);
+    bool canvasActive(void);
+    void canvasWrite(const uint16_t* pixels, uint16_t color, size_t count);
+    void markDirty(Rect rect);
+    void flushCanvas(void);
+    uint8_t* nextLineBuffer(void);
+    void sendBuffer(const uint8_t* data, size_t length);
+    void queueColor(uint16_t color, size_t count);
+    GlyphCacheEntry* cacheGlyph(unsigned char c, uint16_t size, uint16_t foreColor, uint16_t backColor);
+    void evictGlyph(GlyphCacheEntry* entry);
+    void flushQueue(void);
+    void drawLineRun(int16_t xa, int16_t ya, int16_t xb, int16_t yb, bool steep, uint16_t thickness, uint16_t color);
+    void drawRun(const ArcShape& shape, int16_t x, int16_t y, int16_t w, int16_t h);
+    void emitHRun(const ArcShape& shape, int16_t dy, int16_t dx0, int16_t dx1);
+    void emitVRun(const ArcShape& shape, int16_t dx, int16_t dy0, int16_t dy1);
+    void circleRuns(const ArcShape& shape, uint16_t r);
+    void addEdge(EdgeTable& table, int32_t x0, int32_t y0, int32_t x1, int32_t y1);
+    void addRoundOutline(EdgeTable& table, int32_t x, int32_t y, int32_t w, int32_t h, int32_t r, uint16_t segments);
+    void fillEdges(EdgeTable& table, bool nonZero, uint16_t color);
+    void ellipseRuns(const ArcShape& shape, uint16_t rx, uint16_t ry);
     int8_t signumFunc(int16_t x);
 };
 #endif
\ No newline at end of file
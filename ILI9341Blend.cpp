@@ -0,0 +1,605 @@
+#include "ILI9341Blend.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+// Two RGB565 pixels in a 32-bit word are split into two lanes, each with at least 5 free bits above every
+// component, so all components of a lane can be scaled by an alpha of 0-32 with one multiplication
+#define BLEND_LANE_A                0x07E0F81Fu   // Blue and red of the low pixel, green of the high pixel
+#define BLEND_LANE_B                0xF81F07E0u   // Green of the low pixel, blue and red of the high pixel (used shifted down by 5)
+
+/*
+  uint32_t blendPair(uint32_t, uint32_t, uint32_t) blends two packed RGB565 pixels fg over bg with alpha 0-32.
+*/
+static inline uint32_t blendPair(uint32_t fg, uint32_t bg, uint32_t alpha)
+{
+  uint32_t inverse = 32 - alpha;
+  uint32_t laneA = (((fg & BLEND_LANE_A) * alpha + (bg & BLEND_LANE_A) * inverse) >> 5) & BLEND_LANE_A;
+  uint32_t laneB = (((fg & BLEND_LANE_B) >> 5) * alpha + ((bg & BLEND_LANE_B) >> 5) * inverse) & BLEND_LANE_B;
+
+  return laneA | laneB;
+}
+
+/*
+  uint16_t blendPixel(uint16_t, uint16_t, uint32_t) blends one RGB565 pixel fg over bg with alpha 0-32. The pixel
+  is spread over a 32-bit word (green in the top half); the result equals that of blendPair.
+*/
+static inline uint16_t blendPixel(uint16_t fg, uint16_t bg, uint32_t alpha)
+{
+  uint32_t spreadFg = (fg | ((uint32_t)fg << 16)) & BLEND_LANE_A;
+  uint32_t spreadBg = (bg | ((uint32_t)bg << 16)) & BLEND_LANE_A;
+  uint32_t result = ((spreadFg * alpha + spreadBg * (32 - alpha)) >> 5) & BLEND_LANE_A;
+
+  return result | (result >> 16);
+}
+
+/*
+  void blendColor(uint16_t*, uint16_t, size_t, uint32_t) blends color over count pixels in place, two per word.
+  The color's share of both lanes is the same for every word and is computed once.
+*/
+static void blendColor(uint16_t* pixels, uint16_t color, size_t count, uint32_t alpha)
+{
+  uint32_t pair = color | ((uint32_t)color << 16);
+  uint32_t inverse = 32 - alpha;
+  uint32_t colorA = (pair & BLEND_LANE_A) * alpha;
+  uint32_t colorB = ((pair & BLEND_LANE_B) >> 5) * alpha;
+  size_t i = 0;
+
+  for(; i + 2 <= count; i += 2)
+  {
+    uint32_t bg;
+
+    memcpy(&bg, &pixels[i], 4);
+    bg = (((colorA + (bg & BLEND_LANE_A) * inverse) >> 5) & BLEND_LANE_A) | ((colorB + ((bg & BLEND_LANE_B) >> 5) * inverse) & BLEND_LANE_B);
+    memcpy(&pixels[i], &bg, 4);
+  }
+
+  if(i < count)
+  {
+    pixels[i] = blendPixel(color, pixels[i], alpha);
+  }
+}
+
+/*
+  void blendPixels(uint16_t*, const uint16_t*, size_t, uint32_t) blends count colors over count pixels in place,
+  two per word.
+*/
+static void blendPixels(uint16_t* pixels, const uint16_t* colors, size_t count, uint32_t alpha)
+{
+  size_t i = 0;
+
+  for(; i + 2 <= count; i += 2)
+  {
+    uint32_t fg, bg;
+
+    memcpy(&fg, &colors[i], 4);
+    memcpy(&bg, &pixels[i], 4);
+    bg = blendPair(fg, bg, alpha);
+    memcpy(&pixels[i], &bg, 4);
+  }
+
+  if(i < count)
+  {
+    pixels[i] = blendPixel(colors[i], pixels[i], alpha);
+  }
+}
+
+/*
+  void blendCoverage(uint16_t*, uint16_t, const uint8_t*, size_t) blends color over count pixels in place with
+  a separate alpha (0-32) for every pixel.
+*/
+static void blendCoverage(uint16_t* pixels, uint16_t color, const uint8_t* alphas, size_t count)
+{
+  for(size_t i = 0; i < count; i++)
+  {
+    pixels[i] = blendPixel(color, pixels[i], alphas[i]);
+  }
+}
+
+/*
+  uint32_t squareRoot(uint64_t) returns the integer square root of value (rounded down).
+*/
+static uint32_t squareRoot(uint64_t value)
+{
+  uint64_t result = 0;
+  uint64_t bit = (uint64_t)1 << 62;
+
+  while(bit > value)
+  {
+    bit >>= 2;
+  }
+
+  while(bit != 0)
+  {
+    if(value >= result + bit)
+    {
+      value -= result + bit;
+      result = (result >> 1) + bit;
+    }
+    else
+    {
+      result >>= 1;
+    }
+    bit >>= 2;
+  }
+
+  return result;
+}
+
+/*
+  ILI9341Blender(ILI9341&) creates a blender for display. The backdrop is black until one is set.
+*/
+ILI9341Blender::ILI9341Blender(ILI9341& display) : display(display)
+{
+  setBackdrop(BLACK);
+}
+
+/*
+  void setBackdrop(uint16_t) blends against color, assuming the whole screen shows it.
+*/
+void ILI9341Blender::setBackdrop(uint16_t color)
+{
+  backdrop = ILI9341_BACKDROP_COLOR;
+  backdropColor = color;
+  backdropBuffer = NULL;
+}
+
+/*
+  void setBackdrop(const uint16_t*, int16_t, int16_t, uint16_t, uint16_t) blends against a w * h RGB565 image
+  shown with its top left corner at (x, y). Nothing is drawn outside the image. The buffer is not modified,
+  so it may be the canvas the display draws into.
+*/
+void ILI9341Blender::setBackdrop(const uint16_t* buffer, int16_t x, int16_t y, uint16_t w, uint16_t h)
+{
+  backdrop = ILI9341_BACKDROP_BUFFER;
+  backdropBuffer = buffer;
+  backdropX = x;
+  backdropY = y;
+  backdropW = w;
+  backdropH = h;
+}
+
+/*
+  void setBackdropReadback(void) blends against the current display contents, read with ILI9341::readPixels.
+*/
+void ILI9341Blender::setBackdropReadback(void)
+{
+  backdrop = ILI9341_BACKDROP_READBACK;
+  backdropBuffer = NULL;
+}
+
+/*
+  void fillRectangle(int16_t, int16_t, uint16_t, uint16_t, uint16_t, uint8_t) fills a rectangle with color at
+  the given opacity.
+*/
+void ILI9341Blender::fillRectangle(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t color, uint8_t alpha)
+{
+  blendArea(x, y, w, h, NULL, 0, color, alpha);
+}
+
+/*
+  void drawBitmap(int16_t, int16_t, const uint16_t*, uint16_t, uint16_t, uint8_t) draws a w * h RGB565 bitmap
+  at the given opacity.
+*/
+void ILI9341Blender::drawBitmap(int16_t x, int16_t y, const uint16_t* bitmap, uint16_t w, uint16_t h, uint8_t alpha)
+{
+  blendArea(x, y, w, h, bitmap, w, 0, alpha);
+}
+
+/*
+  void drawSprite(int16_t, int16_t, const ILI9341Sprite&, uint8_t) draws an RLE sprite at the given opacity.
+  Transparent runs are left untouched; every other run is blended as one block.
+*/
+void ILI9341Blender::drawSprite(int16_t x, int16_t y, const ILI9341Sprite& sprite, uint8_t alpha)
+{
+  ILI9341::WriteScope scope(display);
+  const uint16_t* src = sprite.data;
+
+  for(uint16_t row = 0; row < sprite.height; row++)
+  {
+    uint16_t px = 0;
+
+    while(px < sprite.width)
+    {
+      uint16_t token = *src++;
+      uint16_t count = token & ILI9341_RLE_COUNT_MASK;
+      uint16_t kind = token & ILI9341_RLE_KIND_MASK;
+
+      if(kind == ILI9341_RLE_REPEAT(0))
+      {
+        blendArea(x + px, y + row, count, 1, NULL, 0, *src++, alpha);
+      }
+      else if(kind != ILI9341_RLE_SKIP(0))
+      {
+        blendArea(x + px, y + row, count, 1, src, count, 0, alpha);
+        src += count;
+      }
+
+      px += count;
+    }
+  }
+}
+
+/*
+  void drawLine(int16_t, int16_t, int16_t, int16_t, uint16_t, uint8_t) draws an anti-aliased line (Xiaolin Wu).
+  At every step along the major axis the line covers two pixels, whose alphas are shared according to the
+  distance of the line from their centers. A steep line gives one two-pixel span per row; a flat line is
+  collected into one span per row, covering the columns where the line runs just above or just below it.
+*/
+void ILI9341Blender::drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color, uint8_t alpha)
+{
+  uint8_t opacity = (alpha + 4) >> 3;
+
+  if(opacity == 0)
+  {
+    return;
+  }
+
+  ILI9341::WriteScope scope(display);
+  int32_t dx = x1 - x0;
+  int32_t dy = y1 - y0;
+
+  if(abs(dy) > abs(dx))
+  {
+    if(dy < 0)
+    {
+      std::swap(x0, x1);
+      std::swap(y0, y1);
+      dx = -dx;
+      dy = -dy;
+    }
+
+    int32_t gradient = (int32_t)((int64_t)dx * 65536 / dy);
+    int64_t position = (int64_t)x0 * 65536 + (1 << 9);    // Half a coverage step, so exact positions are not rounded down
+
+    for(int32_t y = y0; y <= y1; y++, position += gradient)
+    {
+      uint8_t fraction = (position >> 10) & 63;
+
+      coverage[0][0] = ((64 - fraction) * opacity + 32) >> 6;
+      coverage[0][1] = (fraction * opacity + 32) >> 6;
+      blendSpan(position >> 16, y, 2, color, coverage[0]);
+    }
+    return;
+  }
+
+  if(dx < 0)
+  {
+    std::swap(x0, x1);
+    std::swap(y0, y1);
+    dx = -dx;
+    dy = -dy;
+  }
+
+  if(dx == 0)
+  {
+    coverage[0][0] = opacity;
+    blendSpan(x0, y0, 1, color, coverage[0]);
+    return;
+  }
+
+  int32_t gradient = (int32_t)((int64_t)dy * 65536 / dx);
+  int64_t position = (int64_t)y0 * 65536 + (1 << 9);
+  Span spans[2] = {{0, 0, 0}, {0, 0, 0}};   // Rows y and y + 1, indexed by row parity
+
+  for(int32_t x = x0; x <= x1; x++, position += gradient)
+  {
+    int32_t y = position >> 16;
+    uint8_t fraction = (position >> 10) & 63;
+
+    // The line has moved on from rows other than y and y + 1
+    for(uint8_t i = 0; i < 2; i++)
+    {
+      if((spans[i].length > 0) && (spans[i].y != y) && (spans[i].y != y + 1))
+      {
+        flushSpan(spans[i], coverage[i], color);
+      }
+    }
+
+    addCoverage(spans[y & 1], coverage[y & 1], x, y, ((64 - fraction) * opacity + 32) >> 6, color);
+    addCoverage(spans[(y + 1) & 1], coverage[(y + 1) & 1], x, y + 1, (fraction * opacity + 32) >> 6, color);
+  }
+
+  flushSpan(spans[0], coverage[0], color);
+  flushSpan(spans[1], coverage[1], color);
+}
+
+/*
+  void drawCircle(int16_t, int16_t, uint16_t, uint16_t, uint8_t) draws an anti-aliased circle outline one pixel
+  wide. Each pixel's alpha falls off linearly with the distance of its center from the circle.
+*/
+void ILI9341Blender::drawCircle(int16_t xc, int16_t yc, uint16_t r, uint16_t color, uint8_t alpha)
+{
+  circleEdges(xc, yc, r, color, alpha, false);
+}
+
+/*
+  void fillCircle(int16_t, int16_t, uint16_t, uint16_t, uint8_t) draws a filled circle with anti-aliased edges.
+  The inside of every row is blended as one block, the edge pixels with their coverage.
+*/
+void ILI9341Blender::fillCircle(int16_t xc, int16_t yc, uint16_t r, uint16_t color, uint8_t alpha)
+{
+  circleEdges(xc, yc, r, color, alpha, true);
+}
+
+/*
+  bool visibleArea(int32_t, int32_t, int32_t, int32_t, int32_t&, int32_t&, int32_t&, int32_t&) intersects an area
+  with the clip rectangle and a buffer backdrop. Returns false if nothing is left.
+*/
+bool ILI9341Blender::visibleArea(int32_t x, int32_t y, int32_t w, int32_t h, int32_t& left, int32_t& top, int32_t& right, int32_t& bottom)
+{
+  int16_t clipX, clipY;
+  uint16_t clipW, clipH;
+
+  display.getClipRect(clipX, clipY, clipW, clipH);
+
+  left = std::max<int32_t>(x, clipX);
+  top = std::max<int32_t>(y, clipY);
+  right = std::min<int32_t>(x + w, clipX + clipW);
+  bottom = std::min<int32_t>(y + h, clipY + clipH);
+
+  if(backdrop == ILI9341_BACKDROP_BUFFER)
+  {
+    left = std::max<int32_t>(left, backdropX);
+    top = std::max<int32_t>(top, backdropY);
+    right = std::min<int32_t>(right, backdropX + backdropW);
+    bottom = std::min<int32_t>(bottom, backdropY + backdropH);
+  }
+
+  return (left < right) && (top < bottom);
+}
+
+/*
+  void fetch(int16_t, int16_t, uint16_t, uint16_t) loads the backdrop of a visible w * h block into pixels.
+*/
+void ILI9341Blender::fetch(int16_t x, int16_t y, uint16_t w, uint16_t h)
+{
+  switch(backdrop)
+  {
+    case ILI9341_BACKDROP_COLOR:
+      std::fill(pixels, pixels + (size_t)w * h, backdropColor);
+      break;
+
+    case ILI9341_BACKDROP_BUFFER:
+      for(uint16_t row = 0; row < h; row++)
+      {
+        memcpy(&pixels[row * w], &backdropBuffer[(size_t)(y + row - backdropY) * backdropW + (x - backdropX)], w * sizeof(uint16_t));
+      }
+      break;
+
+    case ILI9341_BACKDROP_READBACK:
+      display.readPixels(x, y, w, h, pixels);
+      break;
+  }
+}
+
+/*
+  void blendArea(int32_t, int32_t, int32_t, int32_t, const uint16_t*, uint16_t, uint16_t, uint8_t) blends a w * h
+  area with one alpha: the pixels of bitmap (stride pixels per row), or color if bitmap is NULL. The visible
+  part is processed in blocks of whole rows where possible. Opaque blocks are written without fetching the
+  backdrop.
+*/
+void ILI9341Blender::blendArea(int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t* bitmap, uint16_t stride, uint16_t color, uint8_t alpha)
+{
+  uint8_t opacity = (alpha + 4) >> 3;
+  int32_t left, top, right, bottom;
+
+  if((opacity == 0) || !visibleArea(x, y, w, h, left, top, right, bottom))
+  {
+    return;
+  }
+
+  if((opacity == 32) && (bitmap == NULL))
+  {
+    display.fillRectangle(left, top, right - left, bottom - top, color);
+    return;
+  }
+
+  ILI9341::WriteScope scope(display);
+  uint16_t blockW = std::min<int32_t>(right - left, ILI9341_BLEND_PIXELS);
+  uint16_t blockRows = ILI9341_BLEND_PIXELS / blockW;
+
+  for(int32_t row = top; row < bottom; row += blockRows)
+  {
+    uint16_t rows = std::min<int32_t>(blockRows, bottom - row);
+
+    for(int32_t column = left; column < right; column += blockW)
+    {
+      uint16_t columns = std::min<int32_t>(blockW, right - column);
+
+      if(opacity < 32)
+      {
+        fetch(column, row, columns, rows);
+      }
+
+      for(uint16_t i = 0; i < rows; i++)
+      {
+        uint16_t* dst = &pixels[i * columns];
+
+        if(bitmap == NULL)
+        {
+          blendColor(dst, color, columns, opacity);
+        }
+        else if(opacity == 32)
+        {
+          memcpy(dst, &bitmap[(size_t)(row + i - y) * stride + (column - x)], columns * sizeof(uint16_t));
+        }
+        else
+        {
+          blendPixels(dst, &bitmap[(size_t)(row + i - y) * stride + (column - x)], columns, opacity);
+        }
+      }
+
+      display.setAddrWindow(column, row, columns, rows);
+      display.writePixels(pixels, (size_t)columns * rows);
+    }
+  }
+}
+
+/*
+  void blendSpan(int32_t, int32_t, uint16_t, uint16_t, const uint8_t*) blends color over a row of length pixels,
+  each with its own alpha (0-32). Pixels with alpha 0 are not written.
+*/
+void ILI9341Blender::blendSpan(int32_t x, int32_t y, uint16_t length, uint16_t color, const uint8_t* alphas)
+{
+  int32_t left, top, right, bottom;
+
+  if(!visibleArea(x, y, length, 1, left, top, right, bottom))
+  {
+    return;
+  }
+
+  // Pixels at either end that stay untouched are not fetched
+  while((left < right) && (alphas[left - x] == 0))
+  {
+    left++;
+  }
+  while((left < right) && (alphas[right - 1 - x] == 0))
+  {
+    right--;
+  }
+  if(left == right)
+  {
+    return;
+  }
+
+  uint16_t count = right - left;
+  const uint8_t* spanAlphas = &alphas[left - x];
+
+  fetch(left, y, count, 1);
+  blendCoverage(pixels, color, spanAlphas, count);
+
+  for(uint16_t i = 0; i < count; )
+  {
+    uint16_t start = i;
+
+    while((i < count) && (spanAlphas[i] != 0))
+    {
+      i++;
+    }
+
+    display.setAddrWindow(left + start, y, i - start, 1);
+    display.writePixels(&pixels[start], i - start);
+
+    while((i < count) && (spanAlphas[i] == 0))
+    {
+      i++;
+    }
+  }
+}
+
+/*
+  void addCoverage(Span&, uint8_t*, int32_t, int32_t, uint8_t, uint16_t) appends pixel (x, y) with alpha (0-32) to
+  a span, which must either be empty or end just left of it on row y. Full spans are drawn.
+*/
+void ILI9341Blender::addCoverage(Span& span, uint8_t* alphas, int32_t x, int32_t y, uint8_t alpha, uint16_t color)
+{
+  if((span.length > 0) && ((span.y != y) || (span.x + span.length != x)))
+  {
+    flushSpan(span, alphas, color);
+  }
+
+  if(span.length == 0)
+  {
+    if(alpha == 0)
+    {
+      return;
+    }
+
+    span.x = x;
+    span.y = y;
+  }
+
+  alphas[span.length++] = alpha;
+
+  if(span.length == ILI9341_BLEND_PIXELS)
+  {
+    flushSpan(span, alphas, color);
+  }
+}
+
+/*
+  void flushSpan(Span&, const uint8_t*, uint16_t) draws the pixels collected in a span and empties it.
+*/
+void ILI9341Blender::flushSpan(Span& span, const uint8_t* alphas, uint16_t color)
+{
+  if(span.length > 0)
+  {
+    blendSpan(span.x, span.y, span.length, color, alphas);
+    span.length = 0;
+  }
+}
+
+/*
+  void circleEdges(int16_t, int16_t, uint16_t, uint16_t, uint8_t, bool) draws an anti-aliased circle row by row.
+  For every row the extent of the fully covered (fill) or uncovered (outline) middle part and the outer extent
+  of the visible pixels are found with integer square roots; the pixels in between get alphas from their
+  distance to the center in 1/64 pixel. A filled circle covers pixels within r + 1/2 of the center, an outline
+  pixels within 1 of the circle.
+*/
+void ILI9341Blender::circleEdges(int16_t xc, int16_t yc, uint16_t r, uint16_t color, uint8_t alpha, bool fill)
+{
+  uint8_t opacity = (alpha + 4) >> 3;
+
+  if(opacity == 0)
+  {
+    return;
+  }
+
+  ILI9341::WriteScope scope(display);
+  int64_t radius = (int64_t)r * 64;
+  int64_t twoR = 2 * (int64_t)r;
+
+  for(int32_t dy = -(int32_t)r; dy <= (int32_t)r; dy++)
+  {
+    int64_t dy2 = (int64_t)dy * dy;
+    int32_t inner;                  // Largest |dx| of the middle part (-1 = none)
+    int32_t outer;                  // Largest |dx| with a non-zero alpha
+
+    if(fill)
+    {
+      int64_t inside = (twoR - 1) * (twoR - 1) - 4 * dy2;   // 4 * dx^2 <= inside: within r - 1/2
+      int64_t covered = (twoR + 1) * (twoR + 1) - 4 * dy2;  // 4 * dx^2 < covered: within r + 1/2
+
+      inner = ((r > 0) && (inside >= 0)) ? (int32_t)squareRoot(inside / 4) : -1;
+      outer = squareRoot((covered + 3) / 4 - 1);
+    }
+    else
+    {
+      int64_t inside = (int64_t)(r - 1) * (r - 1) - dy2;    // dx^2 <= inside: at least 1 inside the circle
+      int64_t covered = (int64_t)(r + 1) * (r + 1) - dy2;   // dx^2 < covered: less than 1 outside
+
+      inner = ((r > 0) && (inside >= 0)) ? (int32_t)squareRoot(inside) : -1;
+      outer = squareRoot(covered - 1);
+    }
+
+    if(fill && (inner >= 0))
+    {
+      blendArea(xc - inner, yc + dy, 2 * inner + 1, 1, NULL, 0, color, alpha);
+    }
+
+    // Left edge (or the whole row if there is no middle part), then the right edge
+    for(uint8_t side = 0; side < 2; side++)
+    {
+      int32_t first = (side == 0) ? -outer : inner + 1;
+      int32_t last = (side == 0) ? ((inner >= 0) ? -inner - 1 : outer) : outer;
+      Span span = {0, 0, 0};
+
+      if((side == 1) && (inner < 0))
+      {
+        break;
+      }
+
+      for(int32_t dx = first; dx <= last; dx++)
+      {
+        int64_t distance = squareRoot(((int64_t)dx * dx + dy2) << 12);
+        int64_t level = fill ? (radius + 32 - distance) : (64 - ((distance > radius) ? distance - radius : radius - distance));
+
+        level = std::max<int64_t>(0, std::min<int64_t>(64, level));
+        addCoverage(span, coverage[0], xc + dx, yc + dy, (level * opacity + 32) >> 6, color);
+      }
+
+      flushSpan(span, coverage[0], color);
+    }
+  }
+}
@@ -0,0 +1,69 @@
+#include "ILI9341.h"
+#include <cstddef>
+#include <cstdint>
+
+#ifndef ILI9341_BLEND_PIXELS
+#define ILI9341_BLEND_PIXELS        256 // Pixels read, blended and written back per block by ILI9341Blender
+#endif
+
+#ifndef ILI9341_BLEND_H
+#define ILI9341_BLEND_H
+// Where a blender takes the pixels underneath a translucent primitive from
+enum ILI9341Backdrop
+{
+  ILI9341_BACKDROP_COLOR = 0,       // One known color; nothing is read
+  ILI9341_BACKDROP_BUFFER,          // A caller's RGB565 image of a screen area, e.g. the canvas buffer
+  ILI9341_BACKDROP_READBACK         // The display contents: the canvas in canvas mode, otherwise read from the panel (RAMRD)
+};
+
+/*
+  ILI9341Blender draws translucent and anti-aliased primitives on a display. Every primitive is split into
+  blocks of at most ILI9341_BLEND_PIXELS pixels; the backdrop of a block is fetched, the primitive is blended
+  into it and the block is written back through one address window.
+
+  Alpha is 0 (invisible) to 255 (opaque) and is applied in 33 steps. Constant alpha blocks are blended two
+  pixels per 32-bit word; anti-aliased edges are blended per pixel with their coverage. Opaque fills, bitmaps
+  and sprites are passed straight to the display.
+
+  Only the part inside the display's clip rectangle is drawn and, with a buffer backdrop, inside the buffer.
+*/
+class ILI9341Blender
+{
+  public:
+    ILI9341Blender(ILI9341& display);
+    void setBackdrop(uint16_t color);
+    void setBackdrop(const uint16_t* buffer, int16_t x, int16_t y, uint16_t w, uint16_t h);
+    void setBackdropReadback(void);
+    void fillRectangle(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t color, uint8_t alpha);
+    void drawBitmap(int16_t x, int16_t y, const uint16_t* bitmap, uint16_t w, uint16_t h, uint8_t alpha);
+    void drawSprite(int16_t x, int16_t y, const ILI9341Sprite& sprite, uint8_t alpha);
+    void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color, uint8_t alpha = 255);
+    void drawCircle(int16_t xc, int16_t yc, uint16_t r, uint16_t color, uint8_t alpha = 255);
+    void fillCircle(int16_t xc, int16_t yc, uint16_t r, uint16_t color, uint8_t alpha = 255);
+
+  private:
+    ILI9341& display;
+    ILI9341Backdrop backdrop;
+    uint16_t backdropColor;
+    const uint16_t* backdropBuffer;
+    int16_t backdropX, backdropY;   // Screen position of backdropBuffer
+    uint16_t backdropW, backdropH;
+    uint16_t pixels[ILI9341_BLEND_PIXELS];      // Block being blended (backdrop, then result)
+    uint8_t coverage[2][ILI9341_BLEND_PIXELS];  // Per-pixel alpha (0-32) of the rows an anti-aliased primitive is building
+
+    // Row of anti-aliased pixels being collected
+    struct Span
+    {
+      int32_t x, y;
+      uint16_t length;
+    };
+
+    bool visibleArea(int32_t x, int32_t y, int32_t w, int32_t h, int32_t& left, int32_t& top, int32_t& right, int32_t& bottom);
+    void fetch(int16_t x, int16_t y, uint16_t w, uint16_t h);
+    void blendArea(int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t* bitmap, uint16_t stride, uint16_t color, uint8_t alpha);
+    void blendSpan(int32_t x, int32_t y, uint16_t length, uint16_t color, const uint8_t* alphas);
+    void addCoverage(Span& span, uint8_t* alphas, int32_t x, int32_t y, uint8_t alpha, uint16_t color);
+    void flushSpan(Span& span, const uint8_t* alphas, uint16_t color);
+    void circleEdges(int16_t xc, int16_t yc, uint16_t r, uint16_t color, uint8_t alpha, bool fill);
+};
+#endif
@@ -0,0 +1,79 @@
+#include <cstddef>
+#include <cstdint>
+
+#ifndef ILI9341_BUS_H
+#define ILI9341_BUS_H
+/*
+  ILI9341Bus is the transport used by the ILI9341 driver: command/data writes, chip select, reset line
+  and delays. ILI9341MbedBus drives a real panel over mbed SPI, ILI9341Emulator decodes the stream into
+  an in-memory panel on a host machine.
+*/
+class ILI9341Bus
+{
+  public:
+    virtual ~ILI9341Bus() {}
+
+    // Configure the bus for the display (word size, mode, clock)
+    virtual void begin(void) = 0;
+
+    // SPI clock in Hz the bus runs the display at (used for cost estimates)
+    virtual uint32_t getFrequency(void) = 0;
+
+    // Drive the reset line of the display
+    virtual void setReset(bool level) = 0;
+
+    // Block for the given number of milliseconds
+    virtual void delay(uint32_t ms) = 0;
+
+    // Assert (true) or release (false) the chip select. A release while an asynchronous transfer is in
+    // flight takes effect when the transfer completes; asserting again before that cancels the release.
+    virtual void select(bool active) = 0;
+
+    // Returns true if other devices use the bus as well. The driver then releases the chip select at least every
+    // ILI9341_YIELD_BYTES, so that a shared bus is not held for the whole of a long fill. Shared buses lock and
+    // reconfigure the bus for the display when the chip select is asserted and unlock it when it is released.
+    virtual bool isShared(void)
+    {
+      return false;
+    }
+
+    // Send one command byte (DC low). Following data bytes are sent with DC high.
+    virtual void writeCommand(uint8_t cmd) = 0;
+
+    // Send data bytes and wait until they are on the wire
+    virtual void writeData(const uint8_t* data, size_t length) = 0;
+
+    // Switch the bus to (true) or back from (false) the slower clock the display supports for reads
+    virtual void setReadMode(bool enable)
+    {
+      (void)enable;
+    }
+
+    // Receive data bytes (command responses, RAMRD pixels). Buses without a read line return zeros.
+    virtual void readData(uint8_t* data, size_t length)
+    {
+      for(size_t i = 0; i < length; i++)
+      {
+        data[i] = 0;
+      }
+    }
+
+    // Start sending data bytes in the background. The buffer must stay untouched until isBusy() returns
+    // false. Buses without asynchronous transfers send the data before returning.
+    virtual void writeDataAsync(const uint8_t* data, size_t length)
+    {
+      writeData(data, length);
+    }
+
+    // Returns true while an asynchronous transfer is in flight
+    virtual bool isBusy(void)
+    {
+      return false;
+    }
+
+    // Wait until no asynchronous transfer is in flight
+    virtual void waitIdle(void)
+    {
+    }
+};
+#endif
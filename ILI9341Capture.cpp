@@ -0,0 +1,155 @@
+#include "ILI9341Capture.h"
+#include "ILI9341Q565.h"
+#include <cstdio>
+#include <cstring>
+
+/*
+  void putLittleEndian(uint8_t*, uint32_t, uint8_t) stores a value of the given byte count little endian.
+*/
+static void putLittleEndian(uint8_t* dst, uint32_t value, uint8_t bytes)
+{
+  for(uint8_t i = 0; i < bytes; i++)
+  {
+    dst[i] = (uint8_t)(value >> (8 * i));
+  }
+}
+
+/*
+  bool ILI9341Capture(ILI9341&, ILI9341CaptureSink&, ILI9341CaptureFormat) reads the screen in the current rotation
+  and writes it to the sink as BMP, PPM or Q565. Returns false if the sink rejected data.
+*/
+bool ILI9341Capture(ILI9341& display, ILI9341CaptureSink& sink, ILI9341CaptureFormat format)
+{
+  uint16_t width = display.getWidth();
+  uint16_t height = display.getHeight();
+  uint16_t pixels[ILI9341_TFTHEIGHT];
+  uint8_t row[ILI9341_TFTHEIGHT * 3];
+  bool bmp = (format == ILI9341_CAPTURE_BMP);
+
+  if(format == ILI9341_CAPTURE_Q565)
+  {
+    ILI9341Q565Encoder encoder(sink);
+
+    if(!encoder.begin(width, height))
+    {
+      return false;
+    }
+
+    for(uint16_t y = 0; y < height; y++)
+    {
+      display.readPixels(0, y, width, 1, pixels);
+      if(!encoder.write(pixels, width))
+      {
+        return false;
+      }
+    }
+    return encoder.end();
+  }
+
+  if(bmp)
+  {
+    uint32_t rowBytes = (width * 3 + 3) & ~3u;
+    uint32_t imageBytes = rowBytes * height;
+    uint8_t header[54];
+
+    memset(header, 0, sizeof(header));
+    header[0] = 'B';
+    header[1] = 'M';
+    putLittleEndian(&header[2], sizeof(header) + imageBytes, 4);  // File size
+    putLittleEndian(&header[10], sizeof(header), 4);              // Pixel data offset
+    putLittleEndian(&header[14], 40, 4);                          // BITMAPINFOHEADER size
+    putLittleEndian(&header[18], width, 4);
+    putLittleEndian(&header[22], height, 4);                      // Positive height = bottom-up rows
+    putLittleEndian(&header[26], 1, 2);                           // Planes
+    putLittleEndian(&header[28], 24, 2);                          // Bits per pixel
+    putLittleEndian(&header[34], imageBytes, 4);
+
+    if(!sink.write(header, sizeof(header)))
+    {
+      return false;
+    }
+  }
+  else
+  {
+    char header[20];
+    int length = snprintf(header, sizeof(header), "P6\n%u %u\n255\n", width, height);
+
+    if(!sink.write((const uint8_t*)header, length))
+    {
+      return false;
+    }
+  }
+
+  for(uint16_t i = 0; i < height; i++)
+  {
+    uint16_t y = bmp ? (height - 1 - i) : i;
+    uint8_t* dst = row;
+
+    display.readPixels(0, y, width, 1, pixels);
+
+    for(uint16_t x = 0; x < width; x++)
+    {
+      uint16_t color = pixels[x];
+      uint8_t r = ((color >> 8) & 0xF8) | (color >> 13);
+      uint8_t g = ((color >> 3) & 0xFC) | ((color >> 9) & 0x03);
+      uint8_t b = ((color << 3) & 0xF8) | ((color >> 2) & 0x07);
+
+      if(bmp)
+      {
+        *dst++ = b;
+        *dst++ = g;
+        *dst++ = r;
+      }
+      else
+      {
+        *dst++ = r;
+        *dst++ = g;
+        *dst++ = b;
+      }
+    }
+
+    // 240 and 320 pixel rows of 3 bytes are already multiples of 4, so BMP rows need no padding
+    if(!sink.write(row, width * 3))
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+#if defined(__MBED__)
+// Sink writing to an mbed FileHandle (file system file, serial port, ...)
+class ILI9341FileSink : public ILI9341CaptureSink
+{
+  public:
+    ILI9341FileSink(FileHandle* file) : file(file) {}
+
+    bool write(const uint8_t* data, size_t length)
+    {
+      while(length > 0)
+      {
+        ssize_t written = file->write(data, length);
+        if(written <= 0)
+        {
+          return false;
+        }
+        data += written;
+        length -= written;
+      }
+      return true;
+    }
+
+  private:
+    FileHandle* file;
+};
+
+/*
+  bool ILI9341Capture(ILI9341&, FileHandle*, ILI9341CaptureFormat) writes the screen to a file handle.
+*/
+bool ILI9341Capture(ILI9341& display, FileHandle* file, ILI9341CaptureFormat format)
+{
+  ILI9341FileSink sink(file);
+  return ILI9341Capture(display, sink, format);
+}
+#endif
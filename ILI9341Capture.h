@@ -0,0 +1,32 @@
+#include "ILI9341.h"
+#include <cstddef>
+#include <cstdint>
+
+#ifndef ILI9341_CAPTURE_H
+#define ILI9341_CAPTURE_H
+/*
+  Screen capture that streams the display contents into an image file. The frame is read back with
+  ILI9341::readPixels one row at a time, so only a row of pixels is buffered no matter how large the
+  screen is. BMP files are written as 24-bit bottom-up bitmaps, PPM files as binary P6 and Q565 files
+  losslessly compressed (see ILI9341Q565.h), which keeps screenshots of field units small.
+*/
+enum ILI9341CaptureFormat
+{
+  ILI9341_CAPTURE_BMP,
+  ILI9341_CAPTURE_PPM,
+  ILI9341_CAPTURE_Q565
+};
+
+// Receives the encoded image in chunks; returning false aborts the capture
+class ILI9341CaptureSink
+{
+  public:
+    virtual ~ILI9341CaptureSink() {}
+    virtual bool write(const uint8_t* data, size_t length) = 0;
+};
+
+bool ILI9341Capture(ILI9341& display, ILI9341CaptureSink& sink, ILI9341CaptureFormat format);
+#if defined(__MBED__)
+bool ILI9341Capture(ILI9341& display, FileHandle* file, ILI9341CaptureFormat format);
+#endif
+#endif
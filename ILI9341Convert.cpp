@@ -0,0 +1,511 @@
+#include "ILI9341Convert.h"
+#include <algorithm>
+#include <cstring>
+
+#if ILI9341_CONVERT_SIMD && defined(__SSE2__)
+#include <emmintrin.h>
+#define CONVERT_SSE2
+#elif ILI9341_CONVERT_SIMD && defined(__ARM_NEON) && !defined(__ARM_BIG_ENDIAN)
+#include <arm_neon.h>
+#define CONVERT_NEON
+#elif ILI9341_CONVERT_SIMD && defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1) && !defined(__ARM_BIG_ENDIAN) && defined(__MBED__)
+#define CONVERT_DSP                 // __UQADD8 comes with the CMSIS headers included by mbed.h
+#endif
+
+// Bytes per pixel of each ILI9341SourceFormat
+static const uint8_t sourceBytes[] = {3, 4, 1};
+
+// 4x4 Bayer matrix (thresholds 0-15)
+static const uint8_t bayer[4][4] =
+{
+  {0, 8, 2, 10},
+  {12, 4, 14, 6},
+  {3, 11, 1, 9},
+  {15, 7, 13, 5}
+};
+
+/*
+  uint16_t pack565(uint8_t, uint8_t, uint8_t) truncates 8-bit components to an RGB565 color.
+*/
+static inline uint16_t pack565(uint8_t r, uint8_t g, uint8_t b)
+{
+  return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
+}
+
+/*
+  uint8_t addSaturated(uint8_t, uint8_t) adds a dither offset to a component, clamping at 255.
+*/
+static inline uint8_t addSaturated(uint8_t value, uint8_t offset)
+{
+  return (value + offset > 255) ? 255 : value + offset;
+}
+
+/*
+  void convertScalar(ILI9341SourceFormat, const uint8_t*, uint16_t*, size_t, size_t, const uint8_t*, const uint8_t*)
+  converts pixels first to count - 1 of src. rbOffsets[i & 15] and gOffsets[i & 15] are the ordered dither offsets of
+  pixel i for red/blue and green.
+*/
+static void convertScalar(ILI9341SourceFormat format, const uint8_t* src, uint16_t* dst, size_t first, size_t count, const uint8_t* rbOffsets, const uint8_t* gOffsets)
+{
+  switch(format)
+  {
+    case ILI9341_SOURCE_RGB888:
+      for(size_t i = first; i < count; i++)
+      {
+        const uint8_t* p = &src[3 * i];
+        dst[i] = pack565(addSaturated(p[0], rbOffsets[i & 15]), addSaturated(p[1], gOffsets[i & 15]), addSaturated(p[2], rbOffsets[i & 15]));
+      }
+      break;
+
+    case ILI9341_SOURCE_ARGB8888:
+      for(size_t i = first; i < count; i++)
+      {
+        uint32_t word;
+
+        memcpy(&word, &src[4 * i], 4);
+        dst[i] = pack565(addSaturated(word >> 16, rbOffsets[i & 15]), addSaturated(word >> 8, gOffsets[i & 15]), addSaturated(word, rbOffsets[i & 15]));
+      }
+      break;
+
+    case ILI9341_SOURCE_GRAY8:
+      for(size_t i = first; i < count; i++)
+      {
+        dst[i] = pack565(addSaturated(src[i], rbOffsets[i & 15]), addSaturated(src[i], gOffsets[i & 15]), addSaturated(src[i], rbOffsets[i & 15]));
+      }
+      break;
+  }
+}
+
+#if defined(CONVERT_SSE2)
+/*
+  __m128i packLanes(__m128i, __m128i) narrows two vectors of four 32-bit RGB565 values to eight 16-bit values.
+  SSE2 only has a signed 32 to 16 bit pack, so the values are moved into the signed range and back.
+*/
+static inline __m128i packLanes(__m128i low, __m128i high)
+{
+  const __m128i bias32 = _mm_set1_epi32(0x8000);
+  const __m128i bias16 = _mm_set1_epi16((short)0x8000);
+
+  return _mm_add_epi16(_mm_packs_epi32(_mm_sub_epi32(low, bias32), _mm_sub_epi32(high, bias32)), bias16);
+}
+
+/*
+  __m128i loadRGB888(const uint8_t*) loads four 3-byte pixels into 32-bit lanes 0x..BBGGRR. Reads one byte
+  beyond the fourth pixel.
+*/
+static inline __m128i loadRGB888(const uint8_t* src)
+{
+  uint32_t words[4];
+
+  memcpy(&words[0], src, 4);
+  memcpy(&words[1], src + 3, 4);
+  memcpy(&words[2], src + 6, 4);
+  memcpy(&words[3], src + 9, 4);
+  return _mm_loadu_si128((const __m128i*)words);
+}
+
+/*
+  __m128i lanesRGB888(__m128i) packs 32-bit lanes 0x..BBGGRR into RGB565 values.
+*/
+static inline __m128i lanesRGB888(__m128i v)
+{
+  return _mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_slli_epi32(v, 8), _mm_set1_epi32(0xF800)),
+    _mm_and_si128(_mm_srli_epi32(v, 5), _mm_set1_epi32(0x07E0))), _mm_and_si128(_mm_srli_epi32(v, 19), _mm_set1_epi32(0x001F)));
+}
+
+/*
+  __m128i lanesARGB8888(__m128i) packs 32-bit lanes 0xAARRGGBB into RGB565 values.
+*/
+static inline __m128i lanesARGB8888(__m128i v)
+{
+  return _mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_srli_epi32(v, 8), _mm_set1_epi32(0xF800)),
+    _mm_and_si128(_mm_srli_epi32(v, 5), _mm_set1_epi32(0x07E0))), _mm_and_si128(_mm_srli_epi32(v, 3), _mm_set1_epi32(0x001F)));
+}
+
+/*
+  size_t convertBlocks(ILI9341SourceFormat, const uint8_t*, uint16_t*, size_t, const uint8_t*, const uint8_t*) converts
+  whole blocks of 8 (RGB888, ARGB8888) or 16 (gray) pixels with SSE2 and returns the number of pixels done.
+*/
+static size_t convertBlocks(ILI9341SourceFormat format, const uint8_t* src, uint16_t* dst, size_t count, const uint8_t* rbOffsets, const uint8_t* gOffsets)
+{
+  uint8_t pattern[16];              // Offsets of four pixels in 32-bit lane order (red/blue, green, red/blue, none)
+  size_t i = 0;
+
+  for(uint8_t j = 0; j < 4; j++)
+  {
+    pattern[4 * j] = rbOffsets[j];
+    pattern[4 * j + 1] = gOffsets[j];
+    pattern[4 * j + 2] = rbOffsets[j];
+    pattern[4 * j + 3] = 0;
+  }
+
+  const __m128i offsets = _mm_loadu_si128((const __m128i*)pattern);
+
+  switch(format)
+  {
+    case ILI9341_SOURCE_RGB888:
+      for(; i + 8 < count; i += 8)  // The last load reads one byte of the next pixel
+      {
+        __m128i low = lanesRGB888(_mm_adds_epu8(loadRGB888(&src[3 * i]), offsets));
+        __m128i high = lanesRGB888(_mm_adds_epu8(loadRGB888(&src[3 * i + 12]), offsets));
+        _mm_storeu_si128((__m128i*)&dst[i], packLanes(low, high));
+      }
+      break;
+
+    case ILI9341_SOURCE_ARGB8888:
+      for(; i + 8 <= count; i += 8)
+      {
+        __m128i low = lanesARGB8888(_mm_adds_epu8(_mm_loadu_si128((const __m128i*)&src[4 * i]), offsets));
+        __m128i high = lanesARGB8888(_mm_adds_epu8(_mm_loadu_si128((const __m128i*)&src[4 * i + 16]), offsets));
+        _mm_storeu_si128((__m128i*)&dst[i], packLanes(low, high));
+      }
+      break;
+
+    case ILI9341_SOURCE_GRAY8:
+    {
+      const __m128i rb = _mm_loadu_si128((const __m128i*)rbOffsets);
+      const __m128i g = _mm_loadu_si128((const __m128i*)gOffsets);
+      const __m128i zero = _mm_setzero_si128();
+
+      for(; i + 16 <= count; i += 16)
+      {
+        __m128i v = _mm_loadu_si128((const __m128i*)&src[i]);
+        __m128i vrb = _mm_adds_epu8(v, rb);
+        __m128i vg = _mm_adds_epu8(v, g);
+
+        // Red in the high byte, green shifted into bits 5-10, blue in bits 0-4
+        __m128i low = _mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_unpacklo_epi8(zero, vrb), _mm_set1_epi16((short)0xF800)),
+          _mm_and_si128(_mm_slli_epi16(_mm_unpacklo_epi8(vg, zero), 3), _mm_set1_epi16(0x07E0))), _mm_srli_epi16(_mm_unpacklo_epi8(vrb, zero), 3));
+        __m128i high = _mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_unpackhi_epi8(zero, vrb), _mm_set1_epi16((short)0xF800)),
+          _mm_and_si128(_mm_slli_epi16(_mm_unpackhi_epi8(vg, zero), 3), _mm_set1_epi16(0x07E0))), _mm_srli_epi16(_mm_unpackhi_epi8(vrb, zero), 3));
+
+        _mm_storeu_si128((__m128i*)&dst[i], low);
+        _mm_storeu_si128((__m128i*)&dst[i + 8], high);
+      }
+      break;
+    }
+  }
+  return i;
+}
+#elif defined(CONVERT_NEON)
+/*
+  void storeRGB565(uint16_t*, uint8x16_t, uint8x16_t, uint8x16_t) packs 16 pixels of 8-bit components into RGB565.
+  Each component is widened into the top byte and shifted into place with shift-right-and-insert.
+*/
+static inline void storeRGB565(uint16_t* dst, uint8x16_t r, uint8x16_t g, uint8x16_t b)
+{
+  uint16x8_t low = vshll_n_u8(vget_low_u8(r), 8);
+  uint16x8_t high = vshll_n_u8(vget_high_u8(r), 8);
+
+  low = vsriq_n_u16(low, vshll_n_u8(vget_low_u8(g), 8), 5);
+  high = vsriq_n_u16(high, vshll_n_u8(vget_high_u8(g), 8), 5);
+  low = vsriq_n_u16(low, vshll_n_u8(vget_low_u8(b), 8), 11);
+  high = vsriq_n_u16(high, vshll_n_u8(vget_high_u8(b), 8), 11);
+  vst1q_u16(dst, low);
+  vst1q_u16(dst + 8, high);
+}
+
+/*
+  size_t convertBlocks(ILI9341SourceFormat, const uint8_t*, uint16_t*, size_t, const uint8_t*, const uint8_t*) converts
+  whole blocks of 16 pixels with NEON and returns the number of pixels done.
+*/
+static size_t convertBlocks(ILI9341SourceFormat format, const uint8_t* src, uint16_t* dst, size_t count, const uint8_t* rbOffsets, const uint8_t* gOffsets)
+{
+  const uint8x16_t rb = vld1q_u8(rbOffsets);
+  const uint8x16_t g = vld1q_u8(gOffsets);
+  size_t i = 0;
+
+  switch(format)
+  {
+    case ILI9341_SOURCE_RGB888:
+      for(; i + 16 <= count; i += 16)
+      {
+        uint8x16x3_t v = vld3q_u8(&src[3 * i]);
+        storeRGB565(&dst[i], vqaddq_u8(v.val[0], rb), vqaddq_u8(v.val[1], g), vqaddq_u8(v.val[2], rb));
+      }
+      break;
+
+    case ILI9341_SOURCE_ARGB8888:
+      for(; i + 16 <= count; i += 16)
+      {
+        uint8x16x4_t v = vld4q_u8(&src[4 * i]);    // Bytes of a little endian 0xAARRGGBB word: blue, green, red, alpha
+        storeRGB565(&dst[i], vqaddq_u8(v.val[2], rb), vqaddq_u8(v.val[1], g), vqaddq_u8(v.val[0], rb));
+      }
+      break;
+
+    case ILI9341_SOURCE_GRAY8:
+      for(; i + 16 <= count; i += 16)
+      {
+        uint8x16_t v = vld1q_u8(&src[i]);
+        uint8x16_t vrb = vqaddq_u8(v, rb);
+        storeRGB565(&dst[i], vrb, vqaddq_u8(v, g), vrb);
+      }
+      break;
+  }
+  return i;
+}
+#elif defined(CONVERT_DSP)
+/*
+  size_t convertBlocks(ILI9341SourceFormat, const uint8_t*, uint16_t*, size_t, const uint8_t*, const uint8_t*) converts
+  ARGB8888 pixels, adding the dither offsets of all components with one saturating byte add (UQADD8). Returns the
+  number of pixels done; other formats are left to the scalar code.
+*/
+static size_t convertBlocks(ILI9341SourceFormat format, const uint8_t* src, uint16_t* dst, size_t count, const uint8_t* rbOffsets, const uint8_t* gOffsets)
+{
+  if(format != ILI9341_SOURCE_ARGB8888)
+  {
+    return 0;
+  }
+
+  uint32_t pattern[4];
+
+  for(uint8_t j = 0; j < 4; j++)
+  {
+    pattern[j] = (rbOffsets[j] << 16) | (gOffsets[j] << 8) | rbOffsets[j];
+  }
+
+  for(size_t i = 0; i < count; i++)
+  {
+    uint32_t word;
+
+    memcpy(&word, &src[4 * i], 4);
+    word = __UQADD8(word, pattern[i & 3]);
+    dst[i] = ((word >> 8) & 0xF800) | ((word >> 5) & 0x07E0) | ((word >> 3) & 0x001F);
+  }
+  return count;
+}
+#else
+/*
+  size_t convertBlocks(ILI9341SourceFormat, const uint8_t*, uint16_t*, size_t, const uint8_t*, const uint8_t*) has no
+  vector kernel on this target; everything is converted by the scalar code.
+*/
+static size_t convertBlocks(ILI9341SourceFormat format, const uint8_t* src, uint16_t* dst, size_t count, const uint8_t* rbOffsets, const uint8_t* gOffsets)
+{
+  (void)format;
+  (void)src;
+  (void)dst;
+  (void)count;
+  (void)rbOffsets;
+  (void)gOffsets;
+  return 0;
+}
+#endif
+
+/*
+  ILI9341Converter(ILI9341SourceFormat, ILI9341Dither, uint16_t) creates a converter for images width pixels wide.
+*/
+ILI9341Converter::ILI9341Converter(ILI9341SourceFormat format, ILI9341Dither dither, uint16_t width)
+{
+  this->format = format;
+  this->dither = dither;
+  this->width = std::max<uint16_t>(width, 1);
+  errors = (dither == ILI9341_DITHER_DIFFUSION) ? new int16_t[2 * (this->width + 2) * 3] : NULL;
+  restart(0, 0);
+}
+
+/*
+  ~ILI9341Converter() releases the error buffer.
+*/
+ILI9341Converter::~ILI9341Converter()
+{
+  delete[] errors;
+}
+
+/*
+  void restart(uint16_t, uint16_t) starts a new image whose first pixel is shown at screen position (x, y).
+*/
+void ILI9341Converter::restart(uint16_t x, uint16_t y)
+{
+  originX = x;
+  originY = y;
+  column = 0;
+  row = 0;
+
+  if(errors != NULL)
+  {
+    memset(errors, 0, 2 * (width + 2) * 3 * sizeof(int16_t));
+  }
+}
+
+/*
+  void convert(const void*, uint16_t*, size_t) converts the next count pixels of the image into dst.
+*/
+void ILI9341Converter::convert(const void* src, uint16_t* dst, size_t count)
+{
+  const uint8_t* bytes = (const uint8_t*)src;
+
+  while(count > 0)
+  {
+    uint16_t n = std::min<size_t>(count, width - column);
+
+    if(dither == ILI9341_DITHER_DIFFUSION)
+    {
+      diffuseRow(bytes, dst, n);
+    }
+    else
+    {
+      convertRow(bytes, dst, n);
+    }
+
+    bytes += (size_t)n * sourceBytes[format];
+    dst += n;
+    count -= n;
+    column += n;
+
+    if(column == width)
+    {
+      column = 0;
+      row++;
+    }
+  }
+}
+
+/*
+  void convertRow(const uint8_t*, uint16_t*, uint16_t) converts pixels of the current row without error diffusion.
+*/
+void ILI9341Converter::convertRow(const uint8_t* src, uint16_t* dst, uint16_t count)
+{
+  uint8_t rbOffsets[16];
+  uint8_t gOffsets[16];
+
+  if(dither == ILI9341_DITHER_ORDERED)
+  {
+    const uint8_t* thresholds = bayer[(originY + row) & 3];
+
+    for(uint8_t i = 0; i < 16; i++)
+    {
+      uint8_t threshold = thresholds[(originX + column + i) & 3];
+      rbOffsets[i] = threshold >> 1;    // Below one step of a 5-bit component
+      gOffsets[i] = threshold >> 2;     // Below one step of a 6-bit component
+    }
+  }
+  else
+  {
+    memset(rbOffsets, 0, sizeof(rbOffsets));
+    memset(gOffsets, 0, sizeof(gOffsets));
+  }
+
+  size_t done = convertBlocks(format, src, dst, count, rbOffsets, gOffsets);
+  convertScalar(format, src, dst, done, count, rbOffsets, gOffsets);
+}
+
+/*
+  void diffuseRow(const uint8_t*, uint16_t*, uint16_t) converts pixels of the current row with Floyd-Steinberg error
+  diffusion. The truncation error of each component is passed on in 1/16 units: 7 to the right, 3, 5 and 1 to the
+  row below.
+*/
+void ILI9341Converter::diffuseRow(const uint8_t* src, uint16_t* dst, uint16_t count)
+{
+  size_t rowLength = (size_t)(width + 2) * 3;
+  int16_t* current = &errors[(row & 1) * rowLength];
+  int16_t* next = &errors[((row + 1) & 1) * rowLength];
+  static const uint8_t masks[3] = {0xF8, 0xFC, 0xF8};
+
+  if(column == 0)
+  {
+    memset(next, 0, rowLength * sizeof(int16_t));
+  }
+
+  for(uint16_t i = 0; i < count; i++)
+  {
+    uint16_t c = column + i;
+    uint8_t rgb[3];
+
+    switch(format)
+    {
+      case ILI9341_SOURCE_RGB888:
+        memcpy(rgb, &src[3 * i], 3);
+        break;
+      case ILI9341_SOURCE_ARGB8888:
+      {
+        uint32_t word;
+
+        memcpy(&word, &src[4 * i], 4);
+        rgb[0] = word >> 16;
+        rgb[1] = word >> 8;
+        rgb[2] = word;
+        break;
+      }
+      case ILI9341_SOURCE_GRAY8:
+        rgb[0] = rgb[1] = rgb[2] = src[i];
+        break;
+    }
+
+    for(uint8_t ch = 0; ch < 3; ch++)
+    {
+      int16_t value = std::min<int16_t>(rgb[ch] + (current[(c + 1) * 3 + ch] >> 4), 255);
+      int16_t error = value - (value & masks[ch]);
+
+      rgb[ch] = value & masks[ch];
+      current[(c + 2) * 3 + ch] += 7 * error;
+      next[c * 3 + ch] += 3 * error;
+      next[(c + 1) * 3 + ch] += 5 * error;
+      next[(c + 2) * 3 + ch] += error;
+    }
+
+    dst[i] = pack565(rgb[0], rgb[1], rgb[2]);
+  }
+}
+
+/*
+  const char* getKernelName(void) returns the name of the vector kernels compiled in ("sse2", "neon", "dsp" or "scalar").
+*/
+const char* ILI9341Converter::getKernelName(void)
+{
+#if defined(CONVERT_SSE2)
+  return "sse2";
+#elif defined(CONVERT_NEON)
+  return "neon";
+#elif defined(CONVERT_DSP)
+  return "dsp";
+#else
+  return "scalar";
+#endif
+}
+
+/*
+  void ILI9341DrawImage(ILI9341&, int16_t, int16_t, uint16_t, uint16_t, const void*, ILI9341SourceFormat, ILI9341Dither)
+  converts a w * h image in row order and draws it with its top left corner at (x, y). Only the part inside the clip
+  rectangle is converted; it is streamed through one address window in line buffer sized blocks.
+*/
+void ILI9341DrawImage(ILI9341& display, int16_t x, int16_t y, uint16_t w, uint16_t h, const void* pixels, ILI9341SourceFormat format, ILI9341Dither dither)
+{
+  int16_t clipX, clipY;
+  uint16_t clipW, clipH;
+
+  display.getClipRect(clipX, clipY, clipW, clipH);
+
+  int32_t left = std::max<int32_t>(x, clipX);
+  int32_t top = std::max<int32_t>(y, clipY);
+  int32_t right = std::min<int32_t>(x + w, clipX + clipW);
+  int32_t bottom = std::min<int32_t>(y + h, clipY + clipH);
+
+  if((left >= right) || (top >= bottom))
+  {
+    return;
+  }
+
+  ILI9341Converter converter(format, dither, right - left);
+  uint16_t buffer[ILI9341_LINE_BUFFER_PIXELS];
+  uint8_t bytes = sourceBytes[format];
+
+  converter.restart(left, top);
+  display.setAddrWindow(left, top, right - left, bottom - top);
+
+  for(int32_t row = top; row < bottom; row++)
+  {
+    const uint8_t* src = (const uint8_t*)pixels + ((size_t)(row - y) * w + (left - x)) * bytes;
+
+    for(int32_t column = left; column < right; )
+    {
+      uint16_t count = std::min<int32_t>(right - column, ILI9341_LINE_BUFFER_PIXELS);
+
+      converter.convert(src, buffer, count);
+      display.writePixels(buffer, count);
+      src += (size_t)count * bytes;
+      column += count;
+    }
+  }
+
+  display.endWrite();
+}
@@ -0,0 +1,58 @@
+#include "ILI9341.h"
+#include <cstddef>
+#include <cstdint>
+
+#ifndef ILI9341_CONVERT_SIMD
+#define ILI9341_CONVERT_SIMD        1   // 0 = always use the scalar conversion kernels (e.g. to compare them)
+#endif
+
+#ifndef ILI9341_CONVERT_H
+#define ILI9341_CONVERT_H
+// Layout of the source pixels of a conversion
+enum ILI9341SourceFormat
+{
+  ILI9341_SOURCE_RGB888 = 0,        // 3 bytes per pixel: red, green, blue
+  ILI9341_SOURCE_ARGB8888,          // 32-bit words 0xAARRGGBB in native byte order; alpha is ignored
+  ILI9341_SOURCE_GRAY8              // 1 byte per pixel
+};
+
+// Dithering applied when components are reduced to 5/6 bits
+enum ILI9341Dither
+{
+  ILI9341_DITHER_NONE = 0,          // Truncate
+  ILI9341_DITHER_ORDERED,           // 4x4 Bayer pattern anchored to the pixel position
+  ILI9341_DITHER_DIFFUSION          // Floyd-Steinberg error diffusion (scalar only)
+};
+
+/*
+  ILI9341Converter turns a stream of 24-bit, 32-bit or grayscale pixels into the RGB565 colors the driver takes.
+  The stream is consumed row by row for an image of the given width, so dithering knows where each pixel is;
+  convert() can be called with any number of pixels and continues where the last call stopped.
+
+  Without dithering and with ordered dithering, blocks of pixels are converted with SSE2 on x86 hosts, NEON on
+  ARMv7-A/ARMv8 and the DSP extension (saturating byte adds) on Cortex-M4/M7; other targets use the scalar code.
+*/
+class ILI9341Converter
+{
+  public:
+    ILI9341Converter(ILI9341SourceFormat format, ILI9341Dither dither, uint16_t width);
+    ~ILI9341Converter();
+    void restart(uint16_t x, uint16_t y);
+    void convert(const void* src, uint16_t* dst, size_t count);
+    static const char* getKernelName(void);
+
+  private:
+    ILI9341SourceFormat format;
+    ILI9341Dither dither;
+    uint16_t width;
+    uint16_t originX, originY;      // Screen position of the first pixel (anchors the ordered dither pattern)
+    uint16_t column;                // Column of the next pixel within the row
+    uint16_t row;                   // Rows completed since restart()
+    int16_t* errors;                // Diffusion errors of the current and the next row, 3 per pixel with a margin column each side
+
+    void convertRow(const uint8_t* src, uint16_t* dst, uint16_t count);
+    void diffuseRow(const uint8_t* src, uint16_t* dst, uint16_t count);
+};
+
+void ILI9341DrawImage(ILI9341& display, int16_t x, int16_t y, uint16_t w, uint16_t h, const void* pixels, ILI9341SourceFormat format, ILI9341Dither dither = ILI9341_DITHER_NONE);
+#endif
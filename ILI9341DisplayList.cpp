@@ -0,0 +1,386 @@
+#include "ILI9341DisplayList.h"
+#include <algorithm>
+#include <cstring>
+
+/*
+  ILI9341DisplayList(void) creates an empty display list with a black background.
+*/
+ILI9341DisplayList::ILI9341DisplayList(void)
+{
+  used = 0;
+  overflowed = false;
+  background = BLACK;
+}
+
+/*
+  void clear(void) removes all commands, so the next scene can be recorded.
+*/
+void ILI9341DisplayList::clear(void)
+{
+  used = 0;
+  overflowed = false;
+}
+
+/*
+  void setBackground(uint16_t) sets the color every band is cleared to before the commands are replayed.
+*/
+void ILI9341DisplayList::setBackground(uint16_t color)
+{
+  background = color;
+}
+
+/*
+  void record(uint8_t, int32_t, int32_t, const int16_t*, uint8_t, const void*, const char*, uint16_t) appends a
+  command drawing on rows top to bottom. Commands that can not draw anything are left out; commands that do not
+  fit set the overflow flag.
+*/
+void ILI9341DisplayList::record(uint8_t op, int32_t top, int32_t bottom, const int16_t* args, uint8_t count, const void* data, const char* text, uint16_t length)
+{
+  top = std::max<int32_t>(top, INT16_MIN);
+  bottom = std::min<int32_t>(bottom, INT16_MAX);
+  if(top > bottom)
+  {
+    return;
+  }
+
+  size_t size = sizeof(Header) + count * sizeof(int16_t) + (data ? sizeof(data) : 0) + length;
+  if(size > ILI9341_DISPLAY_LIST_BYTES - used)
+  {
+    overflowed = true;
+    return;
+  }
+
+  Header header = {(uint16_t)size, op, count, (int16_t)top, (int16_t)bottom};
+  uint8_t* p = &commands[used];
+
+  memcpy(p, &header, sizeof(header));
+  p += sizeof(header);
+  memcpy(p, args, count * sizeof(int16_t));
+  p += count * sizeof(int16_t);
+  if(data)
+  {
+    memcpy(p, &data, sizeof(data));
+  }
+  else if(length > 0)
+  {
+    memcpy(p, text, length);
+  }
+  used += size;
+}
+
+/*
+  void recordPoints(uint8_t, const ILI9341Point*, uint16_t, int32_t, int16_t, int16_t) appends a command drawing
+  a list of points, reaching margin rows above and below them.
+*/
+void ILI9341DisplayList::recordPoints(uint8_t op, const ILI9341Point* points, uint16_t count, int32_t margin, int16_t arg0, int16_t arg1)
+{
+  if(count == 0)
+  {
+    return;
+  }
+
+  int32_t top = points[0].y;
+  int32_t bottom = points[0].y;
+  for(uint16_t i = 1; i < count; i++)
+  {
+    top = std::min<int32_t>(top, points[i].y);
+    bottom = std::max<int32_t>(bottom, points[i].y);
+  }
+
+  int16_t args[] = {arg0, arg1, (int16_t)count};
+  record(op, top - margin, bottom + margin, args, 3, points, NULL, 0);
+}
+
+/*
+  void drawPixel(int16_t, int16_t, uint16_t) records ILI9341::drawPixel.
+*/
+void ILI9341DisplayList::drawPixel(int16_t x, int16_t y, uint16_t color)
+{
+  int16_t args[] = {x, y, (int16_t)color};
+  record(OP_DRAW_PIXEL, y, y, args, 3, NULL, NULL, 0);
+}
+
+/*
+  void drawVLine(int16_t, int16_t, uint16_t, uint16_t) records ILI9341::drawVLine.
+*/
+void ILI9341DisplayList::drawVLine(int16_t x, int16_t y, uint16_t h, uint16_t color)
+{
+  int16_t args[] = {x, y, (int16_t)h, (int16_t)color};
+  record(OP_DRAW_VLINE, y, (int32_t)y + h - 1, args, 4, NULL, NULL, 0);
+}
+
+/*
+  void drawHLine(int16_t, int16_t, uint16_t, uint16_t) records ILI9341::drawHLine.
+*/
+void ILI9341DisplayList::drawHLine(int16_t x, int16_t y, uint16_t w, uint16_t color)
+{
+  int16_t args[] = {x, y, (int16_t)w, (int16_t)color};
+  record(OP_DRAW_HLINE, y, (w > 0) ? y : y - 1, args, 4, NULL, NULL, 0);
+}
+
+/*
+  void drawLine(int16_t, int16_t, int16_t, int16_t, uint16_t, uint16_t) records ILI9341::drawLine.
+*/
+void ILI9341DisplayList::drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color, uint16_t thickness)
+{
+  int16_t args[] = {x0, y0, x1, y1, (int16_t)color, (int16_t)thickness};
+  int32_t margin = std::max<uint16_t>(thickness, 1);
+  record(OP_DRAW_LINE, std::min(y0, y1) - margin, std::max(y0, y1) + margin, args, 6, NULL, NULL, 0);
+}
+
+/*
+  void drawRectangle(int16_t, int16_t, uint16_t, uint16_t, uint16_t) records ILI9341::drawRectangle.
+*/
+void ILI9341DisplayList::drawRectangle(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t color)
+{
+  int16_t args[] = {x, y, (int16_t)w, (int16_t)h, (int16_t)color};
+  record(OP_DRAW_RECTANGLE, y, (int32_t)y + h - 1, args, 5, NULL, NULL, 0);
+}
+
+/*
+  void fillRectangle(int16_t, int16_t, uint16_t, uint16_t, uint16_t) records ILI9341::fillRectangle.
+*/
+void ILI9341DisplayList::fillRectangle(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t color)
+{
+  int16_t args[] = {x, y, (int16_t)w, (int16_t)h, (int16_t)color};
+  record(OP_FILL_RECTANGLE, y, (int32_t)y + h - 1, args, 5, NULL, NULL, 0);
+}
+
+/*
+  void drawRoundRectangle(int16_t, int16_t, uint16_t, uint16_t, uint16_t, uint16_t) records
+  ILI9341::drawRoundRectangle.
+*/
+void ILI9341DisplayList::drawRoundRectangle(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t r, uint16_t color)
+{
+  int16_t args[] = {x, y, (int16_t)w, (int16_t)h, (int16_t)r, (int16_t)color};
+  record(OP_DRAW_ROUND_RECTANGLE, y, (int32_t)y + h - 1, args, 6, NULL, NULL, 0);
+}
+
+/*
+  void fillRoundRectangle(int16_t, int16_t, uint16_t, uint16_t, uint16_t, uint16_t) records
+  ILI9341::fillRoundRectangle.
+*/
+void ILI9341DisplayList::fillRoundRectangle(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t r, uint16_t color)
+{
+  int16_t args[] = {x, y, (int16_t)w, (int16_t)h, (int16_t)r, (int16_t)color};
+  record(OP_FILL_ROUND_RECTANGLE, y, (int32_t)y + h - 1, args, 6, NULL, NULL, 0);
+}
+
+/*
+  void drawCircle(int16_t, int16_t, uint16_t, uint16_t) records ILI9341::drawCircle.
+*/
+void ILI9341DisplayList::drawCircle(int16_t xc, int16_t yc, uint16_t r, uint16_t color)
+{
+  int16_t args[] = {xc, yc, (int16_t)r, (int16_t)color};
+  record(OP_DRAW_CIRCLE, (int32_t)yc - r, (int32_t)yc + r, args, 4, NULL, NULL, 0);
+}
+
+/*
+  void fillCircle(int16_t, int16_t, uint16_t, uint16_t) records ILI9341::fillCircle.
+*/
+void ILI9341DisplayList::fillCircle(int16_t xc, int16_t yc, uint16_t r, uint16_t color)
+{
+  int16_t args[] = {xc, yc, (int16_t)r, (int16_t)color};
+  record(OP_FILL_CIRCLE, (int32_t)yc - r, (int32_t)yc + r, args, 4, NULL, NULL, 0);
+}
+
+/*
+  void drawArc(int16_t, int16_t, uint16_t, int16_t, int16_t, uint16_t) records ILI9341::drawArc. The arc is culled
+  as if it were the whole circle.
+*/
+void ILI9341DisplayList::drawArc(int16_t xc, int16_t yc, uint16_t r, int16_t startAngle, int16_t endAngle, uint16_t color)
+{
+  int16_t args[] = {xc, yc, (int16_t)r, startAngle, endAngle, (int16_t)color};
+  record(OP_DRAW_ARC, (int32_t)yc - r - 1, (int32_t)yc + r + 1, args, 6, NULL, NULL, 0);
+}
+
+/*
+  void drawTriangle(int16_t, int16_t, int16_t, int16_t, int16_t, int16_t, uint16_t) records ILI9341::drawTriangle.
+*/
+void ILI9341DisplayList::drawTriangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint16_t color)
+{
+  int16_t args[] = {x0, y0, x1, y1, x2, y2, (int16_t)color};
+  record(OP_DRAW_TRIANGLE, std::min({y0, y1, y2}), std::max({y0, y1, y2}), args, 7, NULL, NULL, 0);
+}
+
+/*
+  void fillTriangle(int16_t, int16_t, int16_t, int16_t, int16_t, int16_t, uint16_t) records ILI9341::fillTriangle.
+*/
+void ILI9341DisplayList::fillTriangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint16_t color)
+{
+  int16_t args[] = {x0, y0, x1, y1, x2, y2, (int16_t)color};
+  record(OP_FILL_TRIANGLE, std::min({y0, y1, y2}), std::max({y0, y1, y2}), args, 7, NULL, NULL, 0);
+}
+
+/*
+  void fillPolygon(const ILI9341Point*, uint16_t, uint16_t, ILI9341FillRule) records ILI9341::fillPolygon. The
+  points are not copied.
+*/
+void ILI9341DisplayList::fillPolygon(const ILI9341Point* points, uint16_t count, uint16_t color, ILI9341FillRule rule)
+{
+  recordPoints(OP_FILL_POLYGON, points, count, 0, (int16_t)color, (int16_t)rule);
+}
+
+/*
+  void drawPolyline(const ILI9341Point*, uint16_t, uint16_t, uint16_t) records ILI9341::drawPolyline. The points
+  are not copied.
+*/
+void ILI9341DisplayList::drawPolyline(const ILI9341Point* points, uint16_t count, uint16_t color, uint16_t thickness)
+{
+  recordPoints(OP_DRAW_POLYLINE, points, count, thickness / 2 + 1, (int16_t)color, (int16_t)thickness);
+}
+
+/*
+  void drawString(int16_t, int16_t, const char*, uint16_t, uint16_t, uint16_t, uint16_t) records
+  ILI9341::drawString. The characters are copied.
+*/
+void ILI9341DisplayList::drawString(int16_t x, int16_t y, const char* str, uint16_t strSize, uint16_t charSize, uint16_t foreColor, uint16_t backColor)
+{
+  int16_t args[] = {x, y, (int16_t)charSize, (int16_t)foreColor, (int16_t)backColor};
+  record(OP_DRAW_STRING, y, (int32_t)y + 8 * charSize - 1, args, 5, NULL, str, strSize);
+}
+
+/*
+  void drawBitmap(int16_t, int16_t, const uint16_t*, uint16_t, uint16_t) records ILI9341::drawBitmap. The bitmap is
+  not copied.
+*/
+void ILI9341DisplayList::drawBitmap(int16_t x, int16_t y, const uint16_t* bitmap, uint16_t w, uint16_t h)
+{
+  int16_t args[] = {x, y, (int16_t)w, (int16_t)h};
+  record(OP_DRAW_BITMAP, y, (int32_t)y + h - 1, args, 4, bitmap, NULL, 0);
+}
+
+/*
+  uint32_t render(ILI9341&) draws the recorded scene band by band inside the clip rectangle of display and
+  returns how many commands were replayed over all bands. The list is kept, so it can be rendered again.
+*/
+uint32_t ILI9341DisplayList::render(ILI9341& display)
+{
+  uint16_t width = display.getWidth();
+  uint16_t rows = ILI9341_DISPLAY_LIST_STRIP / width;
+  uint32_t replayed = 0;
+  int16_t clipX, clipY;
+  uint16_t clipW, clipH;
+
+  display.getClipRect(clipX, clipY, clipW, clipH);
+  if((rows == 0) || (clipH == 0))
+  {
+    return 0;
+  }
+
+  for(int32_t y = clipY; y < clipY + clipH; y += rows)
+  {
+    uint16_t bandRows = std::min<int32_t>(rows, clipY + clipH - y);
+
+    // Switching the canvas sends the band before; the background fill marks the whole band dirty
+    display.setCanvas(strip, 0, y, width, bandRows);
+    display.pushClipRect(0, y, width, bandRows);
+    display.fillRectangle(0, y, width, bandRows, background);
+
+    for(size_t offset = 0; offset < used; )
+    {
+      Header header;
+
+      memcpy(&header, &commands[offset], sizeof(header));
+      if((header.bottom >= y) && (header.top < y + bandRows))
+      {
+        execute(display, header, &commands[offset + sizeof(header)]);
+        replayed++;
+      }
+      offset += header.size;
+    }
+
+    display.popClipRect();
+  }
+
+  display.setCanvas(NULL, 0, 0, 0, 0);
+  return replayed;
+}
+
+/*
+  void execute(ILI9341&, const Header&, const uint8_t*) replays one command on display.
+*/
+void ILI9341DisplayList::execute(ILI9341& display, const Header& header, const uint8_t* payload)
+{
+  int16_t a[8];
+  const void* data = NULL;
+  size_t argBytes = header.count * sizeof(int16_t);
+
+  memcpy(a, payload, argBytes);
+  if((header.op == OP_FILL_POLYGON) || (header.op == OP_DRAW_POLYLINE) || (header.op == OP_DRAW_BITMAP))
+  {
+    memcpy(&data, payload + argBytes, sizeof(data));
+  }
+
+  switch(header.op)
+  {
+    case OP_DRAW_PIXEL:
+      display.drawPixel(a[0], a[1], a[2]);
+      break;
+    case OP_DRAW_VLINE:
+      display.drawVLine(a[0], a[1], a[2], a[3]);
+      break;
+    case OP_DRAW_HLINE:
+      display.drawHLine(a[0], a[1], a[2], a[3]);
+      break;
+    case OP_DRAW_LINE:
+      display.drawLine(a[0], a[1], a[2], a[3], a[4], a[5]);
+      break;
+    case OP_DRAW_RECTANGLE:
+      display.drawRectangle(a[0], a[1], a[2], a[3], a[4]);
+      break;
+    case OP_FILL_RECTANGLE:
+      display.fillRectangle(a[0], a[1], a[2], a[3], a[4]);
+      break;
+    case OP_DRAW_ROUND_RECTANGLE:
+      display.drawRoundRectangle(a[0], a[1], a[2], a[3], a[4], a[5]);
+      break;
+    case OP_FILL_ROUND_RECTANGLE:
+      display.fillRoundRectangle(a[0], a[1], a[2], a[3], a[4], a[5]);
+      break;
+    case OP_DRAW_CIRCLE:
+      display.drawCircle(a[0], a[1], a[2], a[3]);
+      break;
+    case OP_FILL_CIRCLE:
+      display.fillCircle(a[0], a[1], a[2], a[3]);
+      break;
+    case OP_DRAW_ARC:
+      display.drawArc(a[0], a[1], a[2], a[3], a[4], a[5]);
+      break;
+    case OP_DRAW_TRIANGLE:
+      display.drawTriangle(a[0], a[1], a[2], a[3], a[4], a[5], a[6]);
+      break;
+    case OP_FILL_TRIANGLE:
+      display.fillTriangle(a[0], a[1], a[2], a[3], a[4], a[5], a[6]);
+      break;
+    case OP_FILL_POLYGON:
+      display.fillPolygon((const ILI9341Point*)data, a[2], a[0], (ILI9341FillRule)a[1]);
+      break;
+    case OP_DRAW_POLYLINE:
+      display.drawPolyline((const ILI9341Point*)data, a[2], a[0], a[1]);
+      break;
+    case OP_DRAW_STRING:
+      display.drawString(a[0], a[1], (const char*)payload + argBytes, header.size - sizeof(header) - argBytes, a[2], a[3], a[4]);
+      break;
+    case OP_DRAW_BITMAP:
+      display.drawBitmap(a[0], a[1], (const uint16_t*)data, a[2], a[3]);
+      break;
+  }
+}
+
+/*
+  size_t getUsed(void) returns the bytes of the command buffer taken by the recorded commands.
+*/
+size_t ILI9341DisplayList::getUsed(void)
+{
+  return used;
+}
+
+/*
+  bool hasOverflowed(void) returns true when a command was dropped because the command buffer was full since the
+  last clear().
+*/
+bool ILI9341DisplayList::hasOverflowed(void)
+{
+  return overflowed;
+}
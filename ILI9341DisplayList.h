@@ -0,0 +1,98 @@
+#include "ILI9341.h"
+#include <cstddef>
+#include <cstdint>
+
+#ifndef ILI9341_DISPLAY_LIST_BYTES
+#define ILI9341_DISPLAY_LIST_BYTES  2048  // Command buffer of a display list
+#endif
+
+#ifndef ILI9341_DISPLAY_LIST_STRIP
+#define ILI9341_DISPLAY_LIST_STRIP  (ILI9341_TFTWIDTH * 16) // Pixels of the band buffer (16 rows portrait, 12 landscape)
+#endif
+
+#ifndef ILI9341_DISPLAY_LIST_H
+#define ILI9341_DISPLAY_LIST_H
+/*
+  ILI9341DisplayList records a scene as a list of drawing commands and renders it without a frame buffer.
+  The screen is cut into full width bands as high as the strip buffer allows. For every band the strip is
+  cleared to the background color, the commands whose rows reach into the band are replayed into it in canvas
+  mode and the band is sent through one address window. Each pixel goes over the bus once per render(), and
+  nothing drawn later in the list flickers over what was drawn before.
+
+  Commands are packed into ILI9341_DISPLAY_LIST_BYTES; a command that does not fit is dropped and sets
+  hasOverflowed(). Strings are copied. Bitmaps and polygon points are referenced and must stay valid until
+  the list is cleared.
+
+  render() uses the canvas of the display, so a canvas set before is flushed and removed. Only the part inside
+  the display's clip rectangle is drawn.
+*/
+class ILI9341DisplayList
+{
+  public:
+    ILI9341DisplayList(void);
+    void clear(void);
+    void setBackground(uint16_t color);
+    void drawPixel(int16_t x, int16_t y, uint16_t color);
+    void drawVLine(int16_t x, int16_t y, uint16_t h, uint16_t color);
+    void drawHLine(int16_t x, int16_t y, uint16_t w, uint16_t color);
+    void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color, uint16_t thickness = 1);
+    void drawRectangle(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t color);
+    void fillRectangle(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t color);
+    void drawRoundRectangle(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t r, uint16_t color);
+    void fillRoundRectangle(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t r, uint16_t color);
+    void drawCircle(int16_t xc, int16_t yc, uint16_t r, uint16_t color);
+    void fillCircle(int16_t xc, int16_t yc, uint16_t r, uint16_t color);
+    void drawArc(int16_t xc, int16_t yc, uint16_t r, int16_t startAngle, int16_t endAngle, uint16_t color);
+    void drawTriangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint16_t color);
+    void fillTriangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint16_t color);
+    void fillPolygon(const ILI9341Point* points, uint16_t count, uint16_t color, ILI9341FillRule rule = ILI9341_FILL_EVEN_ODD);
+    void drawPolyline(const ILI9341Point* points, uint16_t count, uint16_t color, uint16_t thickness = 1);
+    void drawString(int16_t x, int16_t y, const char* str, uint16_t strSize, uint16_t charSize, uint16_t foreColor, uint16_t backColor);
+    void drawBitmap(int16_t x, int16_t y, const uint16_t* bitmap, uint16_t w, uint16_t h);
+
+    uint32_t render(ILI9341& display);
+    size_t getUsed(void);
+    bool hasOverflowed(void);
+
+  private:
+    enum Operation
+    {
+      OP_DRAW_PIXEL,
+      OP_DRAW_VLINE,
+      OP_DRAW_HLINE,
+      OP_DRAW_LINE,
+      OP_DRAW_RECTANGLE,
+      OP_FILL_RECTANGLE,
+      OP_DRAW_ROUND_RECTANGLE,
+      OP_FILL_ROUND_RECTANGLE,
+      OP_DRAW_CIRCLE,
+      OP_FILL_CIRCLE,
+      OP_DRAW_ARC,
+      OP_DRAW_TRIANGLE,
+      OP_FILL_TRIANGLE,
+      OP_FILL_POLYGON,
+      OP_DRAW_POLYLINE,
+      OP_DRAW_STRING,
+      OP_DRAW_BITMAP
+    };
+
+    // Start of every command; followed by count 16-bit arguments, then the referenced data or the text
+    struct Header
+    {
+      uint16_t size;                  // Bytes of the whole command
+      uint8_t op;
+      uint8_t count;                  // Arguments
+      int16_t top, bottom;            // Rows the command can draw on (culling)
+    };
+
+    uint8_t commands[ILI9341_DISPLAY_LIST_BYTES];
+    size_t used;                      // Bytes of commands
+    bool overflowed;
+    uint16_t background;
+    uint16_t strip[ILI9341_DISPLAY_LIST_STRIP];   // Band being rendered
+
+    void record(uint8_t op, int32_t top, int32_t bottom, const int16_t* args, uint8_t count, const void* data, const char* text, uint16_t length);
+    void recordPoints(uint8_t op, const ILI9341Point* points, uint16_t count, int32_t margin, int16_t arg0, int16_t arg1);
+    void execute(ILI9341& display, const Header& header, const uint8_t* payload);
+};
+#endif
@@ -0,0 +1,425 @@
+#if !defined(__MBED__)
+#include "ILI9341Emulator.h"
+#include <cstdio>
+#include <cstring>
+
+/*
+  ILI9341Emulator() creates an emulated panel in its power-on state with cleared frame memory.
+*/
+ILI9341Emulator::ILI9341Emulator()
+{
+  memset(memory, 0, sizeof(memory));
+  selected = false;
+  resetLevel = true;
+  elapsedMs = 0;
+  frequency = 40000000;
+  shared = false;
+  resetController();
+}
+
+/*
+  void resetController(void) restores the register defaults of a hardware or software reset.
+*/
+void ILI9341Emulator::resetController(void)
+{
+  command = ILI9341_NOP;
+  argIndex = 0;
+  columnStart = 0;
+  columnEnd = ILI9341_TFTWIDTH - 1;
+  pageStart = 0;
+  pageEnd = ILI9341_TFTHEIGHT - 1;
+  column = 0;
+  page = 0;
+  pixelBytes[0] = 0;
+  pixelBytes[1] = 0;
+  pixelSize = 3;
+  readPixel = 0;
+  madctl = 0;
+  displayOn = false;
+  topFixed = 0;
+  scrollArea = ILI9341_TFTHEIGHT;
+  bottomFixed = 0;
+  scrollStart = 0;
+}
+
+/*
+  void begin(void) has nothing to configure on the host.
+*/
+void ILI9341Emulator::begin(void)
+{
+}
+
+/*
+  uint32_t getFrequency(void) returns the SPI clock the emulated bus reports.
+*/
+uint32_t ILI9341Emulator::getFrequency(void)
+{
+  return frequency;
+}
+
+/*
+  void setFrequency(uint32_t) sets the SPI clock the emulated bus reports.
+*/
+void ILI9341Emulator::setFrequency(uint32_t hz)
+{
+  frequency = hz;
+}
+
+/*
+  bool isShared(void) returns the sharing state set with setShared.
+*/
+bool ILI9341Emulator::isShared(void)
+{
+  return shared;
+}
+
+/*
+  void setShared(bool) makes the emulated bus report that it is shared, so the driver yields it during long transfers.
+*/
+void ILI9341Emulator::setShared(bool enable)
+{
+  shared = enable;
+}
+
+/*
+  void setReset(bool) resets the controller on the rising edge of the reset line.
+*/
+void ILI9341Emulator::setReset(bool level)
+{
+  if(level && !resetLevel)
+  {
+    resetController();
+  }
+  resetLevel = level;
+}
+
+/*
+  void delay(uint32_t) only accounts the time; the emulator never sleeps.
+*/
+void ILI9341Emulator::delay(uint32_t ms)
+{
+  elapsedMs += ms;
+}
+
+/*
+  void select(bool) tracks the chip select. Releasing it ends the current command, so data sent after the chip
+  select is asserted again is ignored until the next command (e.g. RAMWRCONT to continue a memory write).
+*/
+void ILI9341Emulator::select(bool active)
+{
+  if(!active)
+  {
+    command = ILI9341_NOP;
+  }
+  selected = active;
+}
+
+/*
+  bool isSelected(void) returns true while the chip select is asserted.
+*/
+bool ILI9341Emulator::isSelected(void)
+{
+  return selected;
+}
+
+/*
+  void writeCommand(uint8_t) starts a new command. RAMWR and RAMRD reset the memory pointer to the window origin,
+  RAMWRCONT and RAMRDCONT continue at the pixel after the last one written or read.
+*/
+void ILI9341Emulator::writeCommand(uint8_t cmd)
+{
+  if(!selected)
+  {
+    return;
+  }
+
+  command = cmd;
+  argIndex = 0;
+
+  switch(cmd)
+  {
+    case ILI9341_SWRESET:
+      resetController();
+      break;
+    case ILI9341_DISPOFF:
+      displayOn = false;
+      break;
+    case ILI9341_DISPON:
+      displayOn = true;
+      break;
+    case ILI9341_RAMWR:
+    case ILI9341_RAMRD:
+      column = columnStart;
+      page = pageStart;
+      break;
+  }
+}
+
+/*
+  uint16_t* pointerCell(void) returns the frame memory cell the memory pointer addresses through MADCTL
+  (NULL outside the frame memory).
+*/
+uint16_t* ILI9341Emulator::pointerCell(void)
+{
+  uint16_t x = (madctl & ILI9341_MADCTL_MV) ? page : column;
+  uint16_t y = (madctl & ILI9341_MADCTL_MV) ? column : page;
+
+  if(madctl & ILI9341_MADCTL_MX)
+  {
+    x = ILI9341_TFTWIDTH - 1 - x;
+  }
+  if(madctl & ILI9341_MADCTL_MY)
+  {
+    y = ILI9341_TFTHEIGHT - 1 - y;
+  }
+
+  if((x < ILI9341_TFTWIDTH) && (y < ILI9341_TFTHEIGHT))
+  {
+    return &memory[y][x];
+  }
+  return NULL;
+}
+
+/*
+  void advancePointer(void) moves the memory pointer to the next pixel of the address window.
+*/
+void ILI9341Emulator::advancePointer(void)
+{
+  if(column < columnEnd)
+  {
+    column++;
+  }
+  else
+  {
+    column = columnStart;
+    page = (page < pageEnd) ? page + 1 : pageStart;
+  }
+}
+
+/*
+  void storePixel(uint16_t) writes one pixel at the memory pointer and advances it inside the address window.
+*/
+void ILI9341Emulator::storePixel(uint16_t color)
+{
+  uint16_t* cell = pointerCell();
+
+  if(cell != NULL)
+  {
+    *cell = color;
+  }
+  advancePointer();
+}
+
+/*
+  void readData(uint8_t*, size_t) clocks out the response to the current command. RAMRD returns a dummy byte
+  followed by one byte per color component, the 5/6 bits of each component left aligned like the 18-bit
+  readback of the controller.
+*/
+void ILI9341Emulator::readData(uint8_t* data, size_t length)
+{
+  for(size_t i = 0; i < length; i++)
+  {
+    uint32_t index = argIndex++;
+
+    data[i] = 0;
+    if(!selected || ((command != ILI9341_RAMRD) && (command != ILI9341_RAMRDCONT)) || (index == 0))
+    {
+      continue;
+    }
+
+    switch((index - 1) % 3)
+    {
+      case 0:
+      {
+        uint16_t* cell = pointerCell();
+        readPixel = (cell != NULL) ? *cell : 0;
+        data[i] = (readPixel >> 8) & 0xF8;
+        break;
+      }
+      case 1:
+        data[i] = (readPixel >> 3) & 0xFC;
+        break;
+      case 2:
+        data[i] = (readPixel << 3) & 0xF8;
+        advancePointer();
+        break;
+    }
+  }
+}
+
+/*
+  void writeData(const uint8_t*, size_t) feeds parameter or pixel bytes to the current command.
+*/
+void ILI9341Emulator::writeData(const uint8_t* data, size_t length)
+{
+  if(!selected)
+  {
+    return;
+  }
+
+  for(size_t i = 0; i < length; i++)
+  {
+    uint8_t value = data[i];
+    uint32_t index = argIndex++;
+
+    switch(command)
+    {
+      case ILI9341_CASET:
+      case ILI9341_PASET:
+        if(index < 4)
+        {
+          args[index] = value;
+        }
+        if(index == 3)
+        {
+          uint16_t start = (args[0] << 8) | args[1];
+          uint16_t end = (args[2] << 8) | args[3];
+
+          if(command == ILI9341_CASET)
+          {
+            columnStart = start;
+            columnEnd = end;
+          }
+          else
+          {
+            pageStart = start;
+            pageEnd = end;
+          }
+        }
+        break;
+
+      case ILI9341_RAMWR:
+      case ILI9341_RAMWRCONT:
+        if(index % pixelSize < pixelSize - 1u)
+        {
+          pixelBytes[index % pixelSize] = value;
+        }
+        else if(pixelSize == 2)
+        {
+          storePixel((pixelBytes[0] << 8) | value);
+        }
+        else
+        {
+          storePixel(((pixelBytes[0] & 0xF8) << 8) | ((pixelBytes[1] & 0xFC) << 3) | (value >> 3));
+        }
+        break;
+
+      case ILI9341_PIXFMT:
+        if(index == 0)
+        {
+          pixelSize = ((value & 0x07) == 0x05) ? 2 : 3;
+        }
+        break;
+
+      case ILI9341_MADCTL:
+        if(index == 0)
+        {
+          madctl = value;
+        }
+        break;
+
+      case ILI9341_VSCRDEF:
+        if(index < 6)
+        {
+          args[index] = value;
+        }
+        if(index == 5)
+        {
+          topFixed = (args[0] << 8) | args[1];
+          scrollArea = (args[2] << 8) | args[3];
+          bottomFixed = (args[4] << 8) | args[5];
+        }
+        break;
+
+      case ILI9341_VSCRSADD:
+        if(index == 0)
+        {
+          args[0] = value;
+        }
+        else if(index == 1)
+        {
+          scrollStart = (args[0] << 8) | value;
+        }
+        break;
+    }
+  }
+}
+
+/*
+  uint16_t getPixel(uint16_t, uint16_t) returns the color shown at a position of the glass in portrait
+  orientation, after the vertical scroll mapping and the BGR panel order are applied.
+*/
+uint16_t ILI9341Emulator::getPixel(uint16_t x, uint16_t y)
+{
+  if(!displayOn)
+  {
+    return 0x0000;
+  }
+
+  uint16_t row = y;
+  if((scrollArea > 0) && (y >= topFixed) && (y < topFixed + scrollArea))
+  {
+    row = topFixed + ((scrollStart - topFixed) + (y - topFixed)) % scrollArea;
+  }
+
+  uint16_t color = memory[row][ILI9341_TFTWIDTH - 1 - x];
+
+  if(!(madctl & ILI9341_MADCTL_BGR))
+  {
+    color = (color & 0x07E0) | (color >> 11) | ((color & 0x1F) << 11);
+  }
+
+  return color;
+}
+
+/*
+  uint16_t getMemory(uint16_t, uint16_t) returns a raw cell of the frame memory.
+*/
+uint16_t ILI9341Emulator::getMemory(uint16_t x, uint16_t y)
+{
+  return memory[y][x];
+}
+
+/*
+  bool isDisplayOn(void) returns true after DISPON.
+*/
+bool ILI9341Emulator::isDisplayOn(void)
+{
+  return displayOn;
+}
+
+/*
+  uint32_t getElapsedMs(void) returns the total time requested through delay().
+*/
+uint32_t ILI9341Emulator::getElapsedMs(void)
+{
+  return elapsedMs;
+}
+
+/*
+  bool writePPM(const char*) dumps the visible image as a binary PPM file.
+*/
+bool ILI9341Emulator::writePPM(const char* path)
+{
+  FILE* file = fopen(path, "wb");
+
+  if(file == NULL)
+  {
+    return false;
+  }
+
+  fprintf(file, "P6\n%d %d\n255\n", ILI9341_TFTWIDTH, ILI9341_TFTHEIGHT);
+
+  for(uint16_t y = 0; y < ILI9341_TFTHEIGHT; y++)
+  {
+    for(uint16_t x = 0; x < ILI9341_TFTWIDTH; x++)
+    {
+      uint16_t color = getPixel(x, y);
+      uint8_t rgb[3] = {(uint8_t)((color >> 8) & 0xF8), (uint8_t)((color >> 3) & 0xFC), (uint8_t)((color << 3) & 0xF8)};
+      fwrite(rgb, 1, 3, file);
+    }
+  }
+
+  return fclose(file) == 0;
+}
+#endif
@@ -0,0 +1,65 @@
+#if !defined(__MBED__)
+#include "ILI9341.h"
+#include "ILI9341Bus.h"
+
+#ifndef ILI9341_EMULATOR_H
+#define ILI9341_EMULATOR_H
+/*
+  ILI9341Emulator is a host-side bus that decodes the command stream like the ILI9341 controller does
+  (CASET/PASET/RAMWR/RAMRD/MADCTL/COLMOD/VSCRDEF/VSCRSADD and the RAMWRCONT/RAMRDCONT continuations) into a 240x320 RGB565 frame memory. It lets the driver
+  render on a normal build machine so primitives can be checked pixel by pixel and dumped to PPM. Pixels
+  written in the 18-bit interface format are stored truncated to RGB565.
+
+  The emulated module mounts the glass mirrored in X, like the common ILI9341 breakout boards, so the
+  driver's rotation 0 (MADCTL_MX) shows up unmirrored.
+*/
+class ILI9341Emulator : public ILI9341Bus
+{
+  public:
+    ILI9341Emulator();
+    void begin(void);
+    uint32_t getFrequency(void);
+    void setFrequency(uint32_t hz);               // Clock the emulated bus reports (default 40 MHz)
+    void setReset(bool level);
+    void delay(uint32_t ms);
+    void select(bool active);
+    bool isSelected(void);
+    void writeCommand(uint8_t cmd);
+    void writeData(const uint8_t* data, size_t length);
+    void readData(uint8_t* data, size_t length);
+    bool isShared(void);
+    void setShared(bool enable);                  // Report a bus shared with other devices (default false)
+
+    uint16_t getPixel(uint16_t x, uint16_t y);    // Pixel as shown on the glass (portrait, after scrolling)
+    uint16_t getMemory(uint16_t x, uint16_t y);   // Raw frame memory cell
+    bool isDisplayOn(void);
+    uint32_t getElapsedMs(void);                  // Time spent in delay()
+    bool writePPM(const char* path);
+
+  private:
+    uint16_t memory[ILI9341_TFTHEIGHT][ILI9341_TFTWIDTH];
+    uint8_t command;                // Command the following data bytes belong to
+    uint32_t argIndex;              // Index of the next data byte of the command
+    uint8_t args[6];
+    uint16_t columnStart, columnEnd;
+    uint16_t pageStart, pageEnd;
+    uint16_t column, page;          // Memory write/read pointer
+    uint8_t pixelBytes[2];          // Leading bytes of a pixel being written
+    uint8_t pixelSize;              // Bytes per written pixel: 2 (COLMOD 16-bit) or 3 (18-bit)
+    uint16_t readPixel;             // Pixel being read by RAMRD
+    uint8_t madctl;
+    bool displayOn;
+    uint16_t topFixed, scrollArea, bottomFixed, scrollStart;
+    bool selected;
+    bool resetLevel;
+    uint32_t elapsedMs;
+    uint32_t frequency;
+    bool shared;
+
+    void resetController(void);
+    uint16_t* pointerCell(void);
+    void advancePointer(void);
+    void storePixel(uint16_t color);
+};
+#endif
+#endif
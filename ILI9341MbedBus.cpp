@@ -0,0 +1,218 @@
+#if defined(__MBED__)
+#include "ILI9341MbedBus.h"
+#include <algorithm>
+
+/*
+  ILI9341MbedBus(PinName, PinName, PinName, PinName, PinName, PinName) initializes the SPI peripheral and control pins.
+*/
+ILI9341MbedBus::ILI9341MbedBus(PinName mosi, PinName miso, PinName clk, PinName cs, PinName rst, PinName dc) : spi(mosi, miso, clk), chipSelect(cs), reset(rst), dataCommand(dc)
+{
+  busy = false;
+  releasePending = false;
+  shared = false;
+  readMode = false;
+  longestHold = 0;
+}
+
+/*
+  void begin(void) configures SPI mode 3 with 8-bit words at 40 MHz and releases chip select.
+*/
+void ILI9341MbedBus::begin(void)
+{
+  spi.format(8, 3);
+  spi.frequency(frequency);
+  chipSelect = 1;
+  dataCommand = 1;
+}
+
+/*
+  uint32_t getFrequency(void) returns the SPI clock configured by begin().
+*/
+uint32_t ILI9341MbedBus::getFrequency(void)
+{
+  return frequency;
+}
+
+/*
+  void setReset(bool) drives the reset pin.
+*/
+void ILI9341MbedBus::setReset(bool level)
+{
+  reset = level;
+}
+
+/*
+  void delay(uint32_t) sleeps the calling thread.
+*/
+void ILI9341MbedBus::delay(uint32_t ms)
+{
+  ThisThread::sleep_for(chrono::milliseconds(ms));
+}
+
+/*
+  void select(bool) asserts or releases chip select. A release is deferred to the completion callback
+  while an asynchronous transfer is in flight. On a shared bus the SPI peripheral is locked and configured
+  for the display before the chip select is asserted; the release waits for the transfer in flight and unlocks it.
+*/
+void ILI9341MbedBus::select(bool active)
+{
+  if(shared)
+  {
+    if(active)
+    {
+      spi.lock();
+      spi.format(8, 3);
+      spi.frequency(readMode ? readFrequency : frequency);
+      holdTimer.reset();
+      holdTimer.start();
+      chipSelect = 0;
+    }
+    else
+    {
+      waitIdle();
+      chipSelect = 1;
+      holdTimer.stop();
+      longestHold = std::max<uint32_t>(longestHold, chrono::duration_cast<chrono::microseconds>(holdTimer.elapsed_time()).count());
+      spi.unlock();
+    }
+    return;
+  }
+
+  core_util_critical_section_enter();
+  if(active)
+  {
+    releasePending = false;
+    chipSelect = 0;
+  }
+  else if(busy)
+  {
+    releasePending = true;
+  }
+  else
+  {
+    chipSelect = 1;
+  }
+  core_util_critical_section_exit();
+}
+
+/*
+  void writeCommand(uint8_t) writes a ILI9341 command via SPI.
+*/
+void ILI9341MbedBus::writeCommand(uint8_t cmd)
+{
+  waitIdle();
+  dataCommand = 0;
+  spi.write(cmd);
+  dataCommand = 1;
+}
+
+/*
+  void writeData(const uint8_t*, size_t) writes data bytes with a block transfer.
+*/
+void ILI9341MbedBus::writeData(const uint8_t* data, size_t length)
+{
+  waitIdle();
+  spi.write((const char*)data, length, NULL, 0);
+}
+
+/*
+  void writeDataAsync(const uint8_t*, size_t) starts a background transfer after the previous one has completed.
+*/
+void ILI9341MbedBus::writeDataAsync(const uint8_t* data, size_t length)
+{
+#if DEVICE_SPI_ASYNCH
+  waitIdle();
+  busy = true;
+  spi.transfer(data, length, (uint8_t*)NULL, 0, callback(this, &ILI9341MbedBus::transferComplete), SPI_EVENT_COMPLETE);
+#else
+  writeData(data, length);
+#endif
+}
+
+/*
+  void setReadMode(bool) lowers the SPI clock for reads or restores the write clock.
+*/
+void ILI9341MbedBus::setReadMode(bool enable)
+{
+  waitIdle();
+  readMode = enable;
+  spi.frequency(enable ? readFrequency : frequency);
+}
+
+/*
+  void readData(uint8_t*, size_t) reads data bytes with a block transfer.
+*/
+void ILI9341MbedBus::readData(uint8_t* data, size_t length)
+{
+  waitIdle();
+  spi.write(NULL, 0, (char*)data, length);
+}
+
+/*
+  void setShared(bool) tells the bus whether other devices use the SPI peripheral. Change it only while the
+  display does not hold the chip select.
+*/
+void ILI9341MbedBus::setShared(bool enable)
+{
+  waitIdle();
+  shared = enable;
+}
+
+/*
+  bool isShared(void) returns true if other devices use the SPI peripheral.
+*/
+bool ILI9341MbedBus::isShared(void)
+{
+  return shared;
+}
+
+/*
+  uint32_t getLongestHoldMicros(void) returns the longest time the shared bus was locked by the display since the
+  last resetLongestHold().
+*/
+uint32_t ILI9341MbedBus::getLongestHoldMicros(void)
+{
+  return longestHold;
+}
+
+/*
+  void resetLongestHold(void) restarts the measurement of getLongestHoldMicros().
+*/
+void ILI9341MbedBus::resetLongestHold(void)
+{
+  longestHold = 0;
+}
+
+/*
+  bool isBusy(void) returns true while an asynchronous transfer is still in flight.
+*/
+bool ILI9341MbedBus::isBusy(void)
+{
+  return busy;
+}
+
+/*
+  void waitIdle(void) waits until the asynchronous transfer in flight (if any) has completed.
+*/
+void ILI9341MbedBus::waitIdle(void)
+{
+  while(busy)
+  {
+  }
+}
+
+/*
+  void transferComplete(int) is called from interrupt context when an asynchronous transfer has finished.
+*/
+void ILI9341MbedBus::transferComplete(int event)
+{
+  (void)event;
+  busy = false;
+
+  if(releasePending)
+  {
+    releasePending = false;
+    chipSelect = 1;
+  }
+}
+#endif
@@ -0,0 +1,55 @@
+#if defined(__MBED__)
+#include "mbed.h"
+#include "ILI9341Bus.h"
+
+#ifndef ILI9341_MBED_BUS_H
+#define ILI9341_MBED_BUS_H
+/*
+  ILI9341MbedBus drives the display over an mbed SPI peripheral and three GPIO pins. On targets with
+  DEVICE_SPI_ASYNCH, writeDataAsync uses SPI::transfer so the CPU can continue while data is sent.
+
+  On a bus shared with other devices (setShared), the SPI peripheral is locked and set to the display's format
+  and clock whenever the chip select is asserted, and unlocked when it is released. Other devices should use
+  their own SPI object on the same pins, which mbed reconfigures for them when they take over the peripheral.
+  The time the lock is held is measured, the longest hold is the worst latency the display adds for them.
+*/
+class ILI9341MbedBus : public ILI9341Bus
+{
+  public:
+    ILI9341MbedBus(PinName mosi, PinName miso, PinName clk, PinName cs, PinName rst, PinName dc);
+    void begin(void);
+    uint32_t getFrequency(void);
+    void setReset(bool level);
+    void delay(uint32_t ms);
+    void select(bool active);
+    void writeCommand(uint8_t cmd);
+    void writeData(const uint8_t* data, size_t length);
+    void writeDataAsync(const uint8_t* data, size_t length);
+    void setReadMode(bool enable);
+    void readData(uint8_t* data, size_t length);
+    void setShared(bool enable);
+    bool isShared(void);
+    uint32_t getLongestHoldMicros(void);
+    void resetLongestHold(void);
+    bool isBusy(void);
+    void waitIdle(void);
+
+  private:
+    static const uint32_t frequency = 40000000;
+    static const uint32_t readFrequency = 6000000;  // Read cycle of the controller is at least 150 ns
+
+    SPI spi;
+    DigitalOut chipSelect;          // Chip Select Pin
+    DigitalOut reset;               // Reset Pin
+    DigitalOut dataCommand;         // Data/Command Select Pin
+    volatile bool busy;             // Asynchronous transfer in flight
+    volatile bool releasePending;   // Release chip select when the transfer in flight completes
+    bool shared;                    // Other devices use the bus (lock and reconfigure per selection)
+    bool readMode;                  // Running at the read clock
+    Timer holdTimer;                // Time since the shared bus was locked
+    uint32_t longestHold;           // Longest lock of the shared bus in microseconds
+
+    void transferComplete(int event);
+};
+#endif
+#endif
@@ -0,0 +1,433 @@
+#include "ILI9341Q565.h"
+#include <algorithm>
+#include <cstring>
+
+#define Q565_OP_INDEX   0x00
+#define Q565_OP_DIFF    0x40
+#define Q565_OP_LUMA    0x80
+#define Q565_OP_RUN     0xC0
+#define Q565_OP_RGB     0xFE
+#define Q565_OP_MASK    0xC0
+#define Q565_RUN_MAX    62
+
+/*
+  uint8_t q565Hash(uint16_t) returns the table slot of a color.
+*/
+static inline uint8_t q565Hash(uint16_t color)
+{
+  return ((color >> 11) * 3 + ((color >> 5) & 0x3F) * 5 + (color & 0x1F) * 7) & 0x3F;
+}
+
+/*
+  ILI9341MemorySource(const uint8_t*, size_t) reads length bytes starting at data.
+*/
+ILI9341MemorySource::ILI9341MemorySource(const uint8_t* data, size_t length)
+{
+  this->data = data;
+  remaining = length;
+}
+
+/*
+  size_t read(uint8_t*, size_t) copies the next bytes of the image.
+*/
+size_t ILI9341MemorySource::read(uint8_t* dst, size_t length)
+{
+  length = std::min(length, remaining);
+  memcpy(dst, data, length);
+  data += length;
+  remaining -= length;
+  return length;
+}
+
+#if defined(__MBED__)
+/*
+  ILI9341FileSource(FileHandle*) reads the image from the current position of file.
+*/
+ILI9341FileSource::ILI9341FileSource(FileHandle* file)
+{
+  this->file = file;
+}
+
+/*
+  size_t read(uint8_t*, size_t) reads the next bytes of the file.
+*/
+size_t ILI9341FileSource::read(uint8_t* dst, size_t length)
+{
+  ssize_t count = file->read(dst, length);
+  return (count > 0) ? count : 0;
+}
+#endif
+
+/*
+  ILI9341Q565Encoder(ILI9341CaptureSink&) creates an encoder writing to sink.
+*/
+ILI9341Q565Encoder::ILI9341Q565Encoder(ILI9341CaptureSink& sink) : sink(sink)
+{
+  previous = 0;
+  run = 0;
+  outputLength = 0;
+  memset(table, 0, sizeof(table));
+}
+
+/*
+  bool put(uint8_t) appends a byte to the output buffer and hands full buffers to the sink.
+*/
+bool ILI9341Q565Encoder::put(uint8_t value)
+{
+  output[outputLength++] = value;
+  return (outputLength < sizeof(output)) || flushOutput();
+}
+
+/*
+  bool flushOutput(void) hands the buffered bytes to the sink.
+*/
+bool ILI9341Q565Encoder::flushOutput(void)
+{
+  bool ok = (outputLength == 0) || sink.write(output, outputLength);
+  outputLength = 0;
+  return ok;
+}
+
+/*
+  bool begin(uint16_t, uint16_t) writes the header of a width * height image and resets the coder state.
+*/
+bool ILI9341Q565Encoder::begin(uint16_t width, uint16_t height)
+{
+  previous = 0;
+  run = 0;
+  outputLength = 0;
+  memset(table, 0, sizeof(table));
+
+  const uint8_t header[8] = {'q', '5', '6', '5', (uint8_t)(width >> 8), (uint8_t)width, (uint8_t)(height >> 8), (uint8_t)height};
+
+  for(uint8_t i = 0; i < sizeof(header); i++)
+  {
+    if(!put(header[i]))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+  bool write(const uint16_t*, size_t) encodes the next pixels in row order. Returns false if the sink failed.
+*/
+bool ILI9341Q565Encoder::write(const uint16_t* pixels, size_t count)
+{
+  for(size_t i = 0; i < count; i++)
+  {
+    uint16_t color = pixels[i];
+
+    if(color == previous)
+    {
+      if((++run == Q565_RUN_MAX) && !put(Q565_OP_RUN | (run - 1)))
+      {
+        return false;
+      }
+      run = (run == Q565_RUN_MAX) ? 0 : run;
+      continue;
+    }
+
+    if(run > 0)
+    {
+      if(!put(Q565_OP_RUN | (run - 1)))
+      {
+        return false;
+      }
+      run = 0;
+    }
+
+    uint8_t slot = q565Hash(color);
+    bool ok;
+
+    if(table[slot] == color)
+    {
+      ok = put(Q565_OP_INDEX | slot);
+    }
+    else
+    {
+      int8_t dr = (int8_t)((((color >> 11) - (previous >> 11)) + 16) & 0x1F) - 16;
+      int8_t dg = (int8_t)(((((color >> 5) & 0x3F) - ((previous >> 5) & 0x3F)) + 32) & 0x3F) - 32;
+      int8_t db = (int8_t)((((color & 0x1F) - (previous & 0x1F)) + 16) & 0x1F) - 16;
+      int8_t drg = dr - dg;
+      int8_t dbg = db - dg;
+
+      table[slot] = color;
+
+      if((dr >= -2) && (dr <= 1) && (dg >= -2) && (dg <= 1) && (db >= -2) && (db <= 1))
+      {
+        ok = put(Q565_OP_DIFF | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2));
+      }
+      else if((drg >= -8) && (drg <= 7) && (dbg >= -8) && (dbg <= 7))
+      {
+        ok = put(Q565_OP_LUMA | (dg + 32)) && put(((drg + 8) << 4) | (dbg + 8));
+      }
+      else
+      {
+        ok = put(Q565_OP_RGB) && put(color >> 8) && put(color & 0xFF);
+      }
+    }
+
+    if(!ok)
+    {
+      return false;
+    }
+    previous = color;
+  }
+  return true;
+}
+
+/*
+  bool end(void) writes a pending run and the buffered bytes to the sink.
+*/
+bool ILI9341Q565Encoder::end(void)
+{
+  if((run > 0) && !put(Q565_OP_RUN | (run - 1)))
+  {
+    return false;
+  }
+  run = 0;
+  return flushOutput();
+}
+
+// Pixels of a Q565 image sent through one address window. The window is opened with the first block and can be
+// paused (chip select released) while the source is read; the next block then continues it with RAMWRCONT.
+class Q565Writer
+{
+  public:
+    Q565Writer(ILI9341& display, uint16_t x, uint16_t y, uint16_t w, uint16_t h) :
+      display(display), x(x), y(y), w(w), h(h), count(0), started(false), open(false) {}
+
+    void put(uint16_t color)
+    {
+      pixels[count++] = color;
+      if(count == ILI9341_LINE_BUFFER_PIXELS)
+      {
+        flush();
+      }
+    }
+
+    // Sends the buffered pixels
+    void flush(void)
+    {
+      if(count == 0)
+      {
+        return;
+      }
+
+      if(!started)
+      {
+        display.setAddrWindow(x, y, w, h);
+        started = true;
+      }
+      else if(!open)
+      {
+        display.continueWrite();
+      }
+      open = true;
+
+      display.writePixels(pixels, count);
+      count = 0;
+    }
+
+    // Releases the chip select, so the bus is free for the source
+    void pause(void)
+    {
+      if(open)
+      {
+        display.pauseWrite();
+        open = false;
+      }
+    }
+
+  private:
+    ILI9341& display;
+    uint16_t x, y, w, h;
+    uint16_t pixels[ILI9341_LINE_BUFFER_PIXELS];
+    uint16_t count;
+    bool started;                   // The address window has been set
+    bool open;                      // The chip select is held for the window
+};
+
+// Buffered byte reader over an image source
+class Q565Reader
+{
+  public:
+    Q565Reader(ILI9341ImageSource& source) : source(source), writer(NULL), position(0), length(0) {}
+
+    // Pauses writer whenever the source has to be read (the source may be a device on the same bus)
+    void setWriter(Q565Writer* writer)
+    {
+      this->writer = writer;
+    }
+
+    // Returns false once the source is exhausted
+    bool next(uint8_t& value)
+    {
+      if(position == length)
+      {
+        if(writer != NULL)
+        {
+          writer->pause();
+        }
+
+        length = source.read(buffer, sizeof(buffer));
+        position = 0;
+        if(length == 0)
+        {
+          return false;
+        }
+      }
+      value = buffer[position++];
+      return true;
+    }
+
+  private:
+    ILI9341ImageSource& source;
+    Q565Writer* writer;
+    uint8_t buffer[ILI9341_Q565_INPUT_BYTES];
+    size_t position;
+    size_t length;
+};
+
+/*
+  bool ILI9341DrawQ565(ILI9341&, uint16_t, uint16_t, ILI9341ImageSource&) decodes a Q565 image from source and draws it
+  with its top left corner at (x, y). The compressed data is read in ILI9341_Q565_INPUT_BYTES chunks and the pixels
+  are streamed through one address window in line buffer sized blocks, so RAM use does not depend on the image size.
+  The chip select is released before every read from source and the window is continued afterwards, also inside a
+  startWrite batch, so the source can be a device on the same bus (e.g. a file on an SD card). Only the part inside
+  the clip rectangle is sent; decoding stops after the last visible row. Returns false if the header is invalid or
+  the data ends early.
+*/
+bool ILI9341DrawQ565(ILI9341& display, int16_t x, int16_t y, ILI9341ImageSource& source)
+{
+  Q565Reader reader(source);
+  uint8_t header[8];
+
+  // A batch of the caller may hold the chip select already
+  display.pauseWrite();
+  for(uint8_t i = 0; i < sizeof(header); i++)
+  {
+    if(!reader.next(header[i]))
+    {
+      return false;
+    }
+  }
+
+  if(memcmp(header, "q565", 4) != 0)
+  {
+    return false;
+  }
+
+  uint16_t w = (header[4] << 8) | header[5];
+  uint16_t h = (header[6] << 8) | header[7];
+
+  int16_t clipX, clipY;
+  uint16_t clipW, clipH;
+
+  display.getClipRect(clipX, clipY, clipW, clipH);
+
+  int32_t left = std::max<int32_t>(x, clipX);
+  int32_t top = std::max<int32_t>(y, clipY);
+  int32_t right = std::min<int32_t>(x + w, clipX + clipW);
+  int32_t bottom = std::min<int32_t>(y + h, clipY + clipH);
+
+  if((left >= right) || (top >= bottom))
+  {
+    return true;
+  }
+
+  size_t hidden = (size_t)w * (top - y);      // Pixels of the rows above the clip rectangle
+  size_t remaining = (size_t)w * (bottom - y);
+  uint16_t firstColumn = left - x;
+  uint16_t lastColumn = right - x;
+  uint16_t column = 0;
+  uint16_t table[64];
+  uint16_t color = 0;
+  uint8_t run = 0;
+  Q565Writer writer(display, left, top, right - left, bottom - top);
+  bool ok = true;
+
+  memset(table, 0, sizeof(table));
+  reader.setWriter(&writer);
+
+  while(remaining > 0)
+  {
+    if(run > 0)
+    {
+      run--;
+    }
+    else
+    {
+      uint8_t op;
+
+      if(!reader.next(op))
+      {
+        ok = false;
+        break;
+      }
+
+      if(op == Q565_OP_RGB)
+      {
+        uint8_t hi, lo;
+
+        if(!reader.next(hi) || !reader.next(lo))
+        {
+          ok = false;
+          break;
+        }
+        color = (hi << 8) | lo;
+      }
+      else if((op & Q565_OP_MASK) == Q565_OP_INDEX)
+      {
+        color = table[op];
+      }
+      else if((op & Q565_OP_MASK) == Q565_OP_DIFF)
+      {
+        uint8_t r = ((color >> 11) + ((op >> 4) & 0x03) - 2) & 0x1F;
+        uint8_t g = (((color >> 5) & 0x3F) + ((op >> 2) & 0x03) - 2) & 0x3F;
+        uint8_t b = ((color & 0x1F) + (op & 0x03) - 2) & 0x1F;
+        color = (r << 11) | (g << 5) | b;
+      }
+      else if((op & Q565_OP_MASK) == Q565_OP_LUMA)
+      {
+        uint8_t next;
+
+        if(!reader.next(next))
+        {
+          ok = false;
+          break;
+        }
+
+        int8_t dg = (op & 0x3F) - 32;
+        uint8_t r = ((color >> 11) + dg + (next >> 4) - 8) & 0x1F;
+        uint8_t g = (((color >> 5) & 0x3F) + dg) & 0x3F;
+        uint8_t b = ((color & 0x1F) + dg + (next & 0x0F) - 8) & 0x1F;
+        color = (r << 11) | (g << 5) | b;
+      }
+      else
+      {
+        run = op & 0x3F;         // This pixel plus run more
+      }
+
+      if(((op & Q565_OP_MASK) != Q565_OP_RUN) || (op == Q565_OP_RGB))
+      {
+        table[q565Hash(color)] = color;
+      }
+    }
+
+    if((hidden == 0) && (column >= firstColumn) && (column < lastColumn))
+    {
+      writer.put(color);
+    }
+
+    column = (column + 1 == w) ? 0 : column + 1;
+    hidden = (hidden > 0) ? hidden - 1 : 0;
+    remaining--;
+  }
+
+  writer.flush();
+  writer.pause();
+  return ok;
+}
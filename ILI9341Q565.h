@@ -0,0 +1,81 @@
+#include "ILI9341.h"
+#include "ILI9341Capture.h"
+#include <cstddef>
+#include <cstdint>
+
+#ifndef ILI9341_Q565_INPUT_BYTES
+#define ILI9341_Q565_INPUT_BYTES    64  // Compressed bytes fetched from the source per read
+#endif
+
+#ifndef ILI9341_Q565_H
+#define ILI9341_Q565_H
+/*
+  Q565 is a lossless QOI-style image format over RGB565. After an 8 byte header ("q565", width and height as
+  big-endian 16-bit values) every pixel is coded relative to the previous one (initially black):
+
+    00iiiiii            Color from the 64 entry table of recent colors, indexed by (3r + 5g + 7b) % 64
+    01rrggbb            Component differences of -2..1
+    10gggggg rrrrbbbb   Green difference of -32..31, red and blue differences of -8..7 relative to it
+    11nnnnnn            The previous color repeated 1..62 times (n < 62)
+    11111110 hi lo      RGB565 literal
+
+  Differences wrap around the 5/6/5 bit component ranges. Every pixel that is not part of a run is stored in
+  the table. tools/q565.py encodes images, ILI9341Q565Encoder encodes pixel streams on the target.
+*/
+
+// Supplies compressed bytes; returns the number of bytes read (0 at the end of the data)
+class ILI9341ImageSource
+{
+  public:
+    virtual ~ILI9341ImageSource() {}
+    virtual size_t read(uint8_t* data, size_t length) = 0;
+};
+
+// Reads an image from memory (flash or RAM)
+class ILI9341MemorySource : public ILI9341ImageSource
+{
+  public:
+    ILI9341MemorySource(const uint8_t* data, size_t length);
+    size_t read(uint8_t* data, size_t length);
+
+  private:
+    const uint8_t* data;
+    size_t remaining;
+};
+
+#if defined(__MBED__)
+// Reads an image from an mbed FileHandle (file system file, serial port, ...)
+class ILI9341FileSource : public ILI9341ImageSource
+{
+  public:
+    ILI9341FileSource(FileHandle* file);
+    size_t read(uint8_t* data, size_t length);
+
+  private:
+    FileHandle* file;
+};
+#endif
+
+// Encodes a stream of RGB565 pixels into a sink
+class ILI9341Q565Encoder
+{
+  public:
+    ILI9341Q565Encoder(ILI9341CaptureSink& sink);
+    bool begin(uint16_t width, uint16_t height);
+    bool write(const uint16_t* pixels, size_t count);
+    bool end(void);
+
+  private:
+    ILI9341CaptureSink& sink;
+    uint16_t previous;
+    uint16_t table[64];
+    uint8_t run;
+    uint8_t output[ILI9341_Q565_INPUT_BYTES];
+    size_t outputLength;
+
+    bool put(uint8_t value);
+    bool flushOutput(void);
+};
+
+bool ILI9341DrawQ565(ILI9341& display, int16_t x, int16_t y, ILI9341ImageSource& source);
+#endif
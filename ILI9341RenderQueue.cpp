@@ -0,0 +1,448 @@
+#include "ILI9341RenderQueue.h"
+#include <algorithm>
+#include <cstring>
+
+/*
+  ILI9341RenderQueue(ILI9341&) creates an empty queue executing its commands on display.
+*/
+#if defined(__MBED__)
+ILI9341RenderQueue::ILI9341RenderQueue(ILI9341& display) : display(display), changed(mutex)
+#else
+ILI9341RenderQueue::ILI9341RenderQueue(ILI9341& display) : display(display)
+#endif
+{
+  memset(rings, 0, sizeof(rings));
+  fencesIssued = 0;
+  fencesDone = 0;
+  stalls = 0;
+  closed = false;
+}
+
+/*
+  Command makeCommand(uint8_t, int16_t, int16_t, int16_t, int16_t, int16_t, int16_t, uint16_t) fills the fields
+  shared by most operations.
+*/
+ILI9341RenderQueue::Command ILI9341RenderQueue::makeCommand(uint8_t op, int16_t x0, int16_t y0, int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint16_t color)
+{
+  Command command;
+
+  memset(&command, 0, sizeof(command));
+  command.op = op;
+  command.x0 = x0;
+  command.y0 = y0;
+  command.x1 = x1;
+  command.y1 = y1;
+  command.x2 = x2;
+  command.y2 = y2;
+  command.color = color;
+  return command;
+}
+
+/*
+  void drawPixel(int16_t, int16_t, uint16_t, ILI9341Priority) queues ILI9341::drawPixel.
+*/
+void ILI9341RenderQueue::drawPixel(int16_t x, int16_t y, uint16_t color, ILI9341Priority priority)
+{
+  submit(makeCommand(OP_DRAW_PIXEL, x, y, 0, 0, 0, 0, color), priority);
+}
+
+/*
+  void drawVLine(int16_t, int16_t, uint16_t, uint16_t, ILI9341Priority) queues ILI9341::drawVLine.
+*/
+void ILI9341RenderQueue::drawVLine(int16_t x, int16_t y, uint16_t h, uint16_t color, ILI9341Priority priority)
+{
+  submit(makeCommand(OP_DRAW_VLINE, x, y, 0, h, 0, 0, color), priority);
+}
+
+/*
+  void drawHLine(int16_t, int16_t, uint16_t, uint16_t, ILI9341Priority) queues ILI9341::drawHLine.
+*/
+void ILI9341RenderQueue::drawHLine(int16_t x, int16_t y, uint16_t w, uint16_t color, ILI9341Priority priority)
+{
+  submit(makeCommand(OP_DRAW_HLINE, x, y, w, 0, 0, 0, color), priority);
+}
+
+/*
+  void drawLine(int16_t, int16_t, int16_t, int16_t, uint16_t, uint16_t, ILI9341Priority) queues ILI9341::drawLine.
+*/
+void ILI9341RenderQueue::drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color, uint16_t thickness, ILI9341Priority priority)
+{
+  submit(makeCommand(OP_DRAW_LINE, x0, y0, x1, y1, thickness, 0, color), priority);
+}
+
+/*
+  void drawRectangle(int16_t, int16_t, uint16_t, uint16_t, uint16_t, ILI9341Priority) queues ILI9341::drawRectangle.
+*/
+void ILI9341RenderQueue::drawRectangle(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t color, ILI9341Priority priority)
+{
+  submit(makeCommand(OP_DRAW_RECTANGLE, x, y, w, h, 0, 0, color), priority);
+}
+
+/*
+  void fillRectangle(int16_t, int16_t, uint16_t, uint16_t, uint16_t, ILI9341Priority) queues ILI9341::fillRectangle.
+*/
+void ILI9341RenderQueue::fillRectangle(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t color, ILI9341Priority priority)
+{
+  submit(makeCommand(OP_FILL_RECTANGLE, x, y, w, h, 0, 0, color), priority);
+}
+
+/*
+  void drawCircle(int16_t, int16_t, uint16_t, uint16_t, ILI9341Priority) queues ILI9341::drawCircle.
+*/
+void ILI9341RenderQueue::drawCircle(int16_t xc, int16_t yc, uint16_t r, uint16_t color, ILI9341Priority priority)
+{
+  submit(makeCommand(OP_DRAW_CIRCLE, xc, yc, r, 0, 0, 0, color), priority);
+}
+
+/*
+  void fillCircle(int16_t, int16_t, uint16_t, uint16_t, ILI9341Priority) queues ILI9341::fillCircle.
+*/
+void ILI9341RenderQueue::fillCircle(int16_t xc, int16_t yc, uint16_t r, uint16_t color, ILI9341Priority priority)
+{
+  submit(makeCommand(OP_FILL_CIRCLE, xc, yc, r, 0, 0, 0, color), priority);
+}
+
+/*
+  void drawTriangle(int16_t, int16_t, int16_t, int16_t, int16_t, int16_t, uint16_t, ILI9341Priority) queues
+  ILI9341::drawTriangle.
+*/
+void ILI9341RenderQueue::drawTriangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint16_t color, ILI9341Priority priority)
+{
+  submit(makeCommand(OP_DRAW_TRIANGLE, x0, y0, x1, y1, x2, y2, color), priority);
+}
+
+/*
+  void fillTriangle(int16_t, int16_t, int16_t, int16_t, int16_t, int16_t, uint16_t, ILI9341Priority) queues
+  ILI9341::fillTriangle.
+*/
+void ILI9341RenderQueue::fillTriangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint16_t color, ILI9341Priority priority)
+{
+  submit(makeCommand(OP_FILL_TRIANGLE, x0, y0, x1, y1, x2, y2, color), priority);
+}
+
+/*
+  void drawString(int16_t, int16_t, const char*, uint16_t, uint16_t, uint16_t, uint16_t, ILI9341Priority) queues
+  ILI9341::drawString. The characters are copied, ILI9341_QUEUE_TEXT per command; the pieces of a longer string
+  are placed where drawString would have drawn them.
+*/
+void ILI9341RenderQueue::drawString(int16_t x, int16_t y, const char* str, uint16_t strSize, uint16_t charSize, uint16_t foreColor, uint16_t backColor, ILI9341Priority priority)
+{
+  int32_t xi = x;
+
+  for(uint16_t i = 0; (i < strSize) && (xi <= INT16_MAX); i += ILI9341_QUEUE_TEXT)
+  {
+    Command command = makeCommand(OP_DRAW_STRING, xi, y, charSize, 0, 0, 0, foreColor);
+
+    command.backColor = backColor;
+    command.length = std::min<uint16_t>(strSize - i, ILI9341_QUEUE_TEXT);
+    memcpy(command.text, &str[i], command.length);
+    submit(command, priority);
+
+    xi += ILI9341_QUEUE_TEXT * (5 * charSize + 1);
+  }
+}
+
+/*
+  void fillBackground(uint16_t, ILI9341Priority) queues ILI9341::fillBackground.
+*/
+void ILI9341RenderQueue::fillBackground(uint16_t color, ILI9341Priority priority)
+{
+  submit(makeCommand(OP_FILL_BACKGROUND, 0, 0, 0, 0, 0, 0, color), priority);
+}
+
+/*
+  void drawBitmap(int16_t, int16_t, const uint16_t*, uint16_t, uint16_t, ILI9341Priority) queues ILI9341::drawBitmap.
+  The bitmap is not copied.
+*/
+void ILI9341RenderQueue::drawBitmap(int16_t x, int16_t y, const uint16_t* bitmap, uint16_t w, uint16_t h, ILI9341Priority priority)
+{
+  Command command = makeCommand(OP_DRAW_BITMAP, x, y, w, h, 0, 0, 0);
+
+  command.data = bitmap;
+  submit(command, priority);
+}
+
+/*
+  void drawSprite(int16_t, int16_t, const ILI9341Sprite&, ILI9341Priority) queues ILI9341::drawSprite. The sprite
+  is not copied.
+*/
+void ILI9341RenderQueue::drawSprite(int16_t x, int16_t y, const ILI9341Sprite& sprite, ILI9341Priority priority)
+{
+  Command command = makeCommand(OP_DRAW_SPRITE, x, y, 0, 0, 0, 0, 0);
+
+  command.data = &sprite;
+  submit(command, priority);
+}
+
+/*
+  void setScrollOffset(uint16_t, ILI9341Priority) queues ILI9341::setScrollOffset.
+*/
+void ILI9341RenderQueue::setScrollOffset(uint16_t offset, ILI9341Priority priority)
+{
+  submit(makeCommand(OP_SET_SCROLL_OFFSET, offset, 0, 0, 0, 0, 0, 0), priority);
+}
+
+/*
+  void call(void (*)(ILI9341&, void*), void*, ILI9341Priority) queues a function that is called with the display
+  on the display thread, for any operation that has no command of its own.
+*/
+void ILI9341RenderQueue::call(void (*function)(ILI9341& display, void* arg), void* arg, ILI9341Priority priority)
+{
+  Command command = makeCommand(OP_CALL, 0, 0, 0, 0, 0, 0, 0);
+
+  command.function = function;
+  command.data = arg;
+  submit(command, priority);
+}
+
+/*
+  uint32_t fence(void) queues a fence behind all commands queued so far and returns its number for wait().
+*/
+uint32_t ILI9341RenderQueue::fence(void)
+{
+  return submit(makeCommand(OP_FENCE, 0, 0, 0, 0, 0, 0, 0), ILI9341_PRIORITY_NORMAL);
+}
+
+/*
+  void wait(uint32_t) blocks until the fence has been reached by the display thread.
+*/
+void ILI9341RenderQueue::wait(uint32_t fence)
+{
+  mutex.lock();
+  while((int32_t)(fencesDone - fence) < 0)
+  {
+    waitChange();
+  }
+  mutex.unlock();
+}
+
+/*
+  void finish(void) blocks until all commands queued so far are on the display.
+*/
+void ILI9341RenderQueue::finish(void)
+{
+  wait(fence());
+}
+
+/*
+  uint32_t getStalls(void) returns how often a producer had to wait for a free slot.
+*/
+uint32_t ILI9341RenderQueue::getStalls(void)
+{
+  mutex.lock();
+  uint32_t count = stalls;
+  mutex.unlock();
+  return count;
+}
+
+/*
+  uint32_t submit(const Command&, ILI9341Priority) appends a command to the ring of its priority, waiting while
+  the ring is full. Returns the number of the last fence queued.
+*/
+uint32_t ILI9341RenderQueue::submit(const Command& command, ILI9341Priority priority)
+{
+  Ring& ring = rings[priority];
+
+  mutex.lock();
+
+  if(ring.count == ILI9341_QUEUE_DEPTH)
+  {
+    stalls++;
+  }
+  while(ring.count == ILI9341_QUEUE_DEPTH)
+  {
+    waitChange();
+  }
+
+  ring.commands[(ring.head + ring.count) % ILI9341_QUEUE_DEPTH] = command;
+  ring.count++;
+
+  if(command.op == OP_FENCE)
+  {
+    fencesIssued++;
+  }
+
+  uint32_t number = fencesIssued;
+
+  changed.notify_all();
+  mutex.unlock();
+  return number;
+}
+
+/*
+  void waitChange(void) releases the mutex until another thread changed the queue state. Must be called with
+  the mutex held.
+*/
+void ILI9341RenderQueue::waitChange(void)
+{
+#if defined(__MBED__)
+  changed.wait();
+#else
+  changed.wait(mutex);
+#endif
+}
+
+/*
+  bool pop(Command&) takes the next command, urgent ones first. Must be called with the mutex held.
+*/
+bool ILI9341RenderQueue::pop(Command& command)
+{
+  for(int8_t priority = ILI9341_PRIORITY_URGENT; priority >= ILI9341_PRIORITY_NORMAL; priority--)
+  {
+    Ring& ring = rings[priority];
+
+    if(ring.count > 0)
+    {
+      command = ring.commands[ring.head];
+      ring.head = (ring.head + 1) % ILI9341_QUEUE_DEPTH;
+      ring.count--;
+      changed.notify_all();
+      return true;
+    }
+  }
+  return false;
+}
+
+/*
+  void execute(const Command&) runs a drawing command on the display.
+*/
+void ILI9341RenderQueue::execute(const Command& command)
+{
+  switch(command.op)
+  {
+    case OP_DRAW_PIXEL:
+      display.drawPixel(command.x0, command.y0, command.color);
+      break;
+    case OP_DRAW_VLINE:
+      display.drawVLine(command.x0, command.y0, command.y1, command.color);
+      break;
+    case OP_DRAW_HLINE:
+      display.drawHLine(command.x0, command.y0, command.x1, command.color);
+      break;
+    case OP_DRAW_LINE:
+      display.drawLine(command.x0, command.y0, command.x1, command.y1, command.color, command.x2);
+      break;
+    case OP_DRAW_RECTANGLE:
+      display.drawRectangle(command.x0, command.y0, command.x1, command.y1, command.color);
+      break;
+    case OP_FILL_RECTANGLE:
+      display.fillRectangle(command.x0, command.y0, command.x1, command.y1, command.color);
+      break;
+    case OP_DRAW_CIRCLE:
+      display.drawCircle(command.x0, command.y0, command.x1, command.color);
+      break;
+    case OP_FILL_CIRCLE:
+      display.fillCircle(command.x0, command.y0, command.x1, command.color);
+      break;
+    case OP_DRAW_TRIANGLE:
+      display.drawTriangle(command.x0, command.y0, command.x1, command.y1, command.x2, command.y2, command.color);
+      break;
+    case OP_FILL_TRIANGLE:
+      display.fillTriangle(command.x0, command.y0, command.x1, command.y1, command.x2, command.y2, command.color);
+      break;
+    case OP_DRAW_STRING:
+      display.drawString(command.x0, command.y0, command.text, command.length, command.x1, command.color, command.backColor);
+      break;
+    case OP_FILL_BACKGROUND:
+      display.fillBackground(command.color);
+      break;
+    case OP_DRAW_BITMAP:
+      display.drawBitmap(command.x0, command.y0, (const uint16_t*)command.data, command.x1, command.y1);
+      break;
+    case OP_DRAW_SPRITE:
+      display.drawSprite(command.x0, command.y0, *(const ILI9341Sprite*)command.data);
+      break;
+    case OP_SET_SCROLL_OFFSET:
+      display.setScrollOffset(command.x0);
+      break;
+    case OP_CALL:
+      command.function(display, (void*)command.data);
+      break;
+  }
+}
+
+/*
+  bool process(void) executes all queued commands without waiting for new ones and returns true if there were any.
+  Runs of commands share one batch; at a fence the batch is closed and the display flushed before the fence is
+  marked as reached.
+*/
+bool ILI9341RenderQueue::process(void)
+{
+  Command command;
+  bool executed = false;
+  bool batch = false;
+
+  mutex.lock();
+  while(pop(command))
+  {
+    mutex.unlock();
+    executed = true;
+
+    if(command.op == OP_FENCE)
+    {
+      if(batch)
+      {
+        display.endWrite();
+        batch = false;
+      }
+      display.flush();
+
+      mutex.lock();
+      fencesDone++;
+      changed.notify_all();
+      continue;
+    }
+
+    if(!batch)
+    {
+      display.startWrite();
+      batch = true;
+    }
+    execute(command);
+    mutex.lock();
+  }
+  mutex.unlock();
+
+  if(batch)
+  {
+    display.endWrite();
+  }
+  return executed;
+}
+
+/*
+  void run(void) is the body of the display thread: it executes commands as they arrive and returns after close()
+  once the queue is empty.
+*/
+void ILI9341RenderQueue::run(void)
+{
+  while(true)
+  {
+    process();
+
+    mutex.lock();
+    while(!closed && (rings[ILI9341_PRIORITY_NORMAL].count == 0) && (rings[ILI9341_PRIORITY_URGENT].count == 0))
+    {
+      waitChange();
+    }
+
+    bool done = closed && (rings[ILI9341_PRIORITY_NORMAL].count == 0) && (rings[ILI9341_PRIORITY_URGENT].count == 0);
+    mutex.unlock();
+
+    if(done)
+    {
+      return;
+    }
+  }
+}
+
+/*
+  void close(void) lets run() return once the commands queued so far have been executed.
+*/
+void ILI9341RenderQueue::close(void)
+{
+  mutex.lock();
+  closed = true;
+  changed.notify_all();
+  mutex.unlock();
+}
@@ -0,0 +1,132 @@
+#include "ILI9341.h"
+#include <cstdint>
+#if defined(__MBED__)
+#include "mbed.h"
+#else
+#include <condition_variable>
+#include <mutex>
+#endif
+
+#ifndef ILI9341_QUEUE_DEPTH
+#define ILI9341_QUEUE_DEPTH         32  // Commands each priority ring of a render queue holds
+#endif
+
+#ifndef ILI9341_QUEUE_TEXT
+#define ILI9341_QUEUE_TEXT          12  // Characters carried by one string command; longer strings are split
+#endif
+
+#ifndef ILI9341_RENDER_QUEUE_H
+#define ILI9341_RENDER_QUEUE_H
+// Order in which queued commands are executed
+enum ILI9341Priority
+{
+  ILI9341_PRIORITY_NORMAL = 0,
+  ILI9341_PRIORITY_URGENT           // Runs before all pending normal commands
+};
+
+/*
+  ILI9341RenderQueue lets several threads draw on one display. Producers call the drawing methods from any
+  thread; each call is stored as a compact command in a bounded ring and blocks while that ring is full.
+  A single display thread executes the commands with run() (or process() when polling), so the bus traffic
+  of different producers never interleaves. Consecutive commands are sent in one startWrite/endWrite batch.
+
+  Urgent commands go to their own ring, which is drained first. Commands of the same priority run in the
+  order they were queued. fence() marks a point in the normal ring; wait() returns once everything queued
+  before the fence, urgent commands included, has been sent and flushed to the display.
+
+  Strings are copied into the commands. Bitmaps, sprites and call() arguments are referenced and must stay
+  valid until the command has run. While a queue is in use, the display must only be accessed by the display
+  thread, e.g. through call().
+*/
+class ILI9341RenderQueue
+{
+  public:
+    ILI9341RenderQueue(ILI9341& display);
+    void drawPixel(int16_t x, int16_t y, uint16_t color, ILI9341Priority priority = ILI9341_PRIORITY_NORMAL);
+    void drawVLine(int16_t x, int16_t y, uint16_t h, uint16_t color, ILI9341Priority priority = ILI9341_PRIORITY_NORMAL);
+    void drawHLine(int16_t x, int16_t y, uint16_t w, uint16_t color, ILI9341Priority priority = ILI9341_PRIORITY_NORMAL);
+    void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color, uint16_t thickness = 1, ILI9341Priority priority = ILI9341_PRIORITY_NORMAL);
+    void drawRectangle(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t color, ILI9341Priority priority = ILI9341_PRIORITY_NORMAL);
+    void fillRectangle(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t color, ILI9341Priority priority = ILI9341_PRIORITY_NORMAL);
+    void drawCircle(int16_t xc, int16_t yc, uint16_t r, uint16_t color, ILI9341Priority priority = ILI9341_PRIORITY_NORMAL);
+    void fillCircle(int16_t xc, int16_t yc, uint16_t r, uint16_t color, ILI9341Priority priority = ILI9341_PRIORITY_NORMAL);
+    void drawTriangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint16_t color, ILI9341Priority priority = ILI9341_PRIORITY_NORMAL);
+    void fillTriangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint16_t color, ILI9341Priority priority = ILI9341_PRIORITY_NORMAL);
+    void drawString(int16_t x, int16_t y, const char* str, uint16_t strSize, uint16_t charSize, uint16_t foreColor, uint16_t backColor, ILI9341Priority priority = ILI9341_PRIORITY_NORMAL);
+    void fillBackground(uint16_t color, ILI9341Priority priority = ILI9341_PRIORITY_NORMAL);
+    void drawBitmap(int16_t x, int16_t y, const uint16_t* bitmap, uint16_t w, uint16_t h, ILI9341Priority priority = ILI9341_PRIORITY_NORMAL);
+    void drawSprite(int16_t x, int16_t y, const ILI9341Sprite& sprite, ILI9341Priority priority = ILI9341_PRIORITY_NORMAL);
+    void setScrollOffset(uint16_t offset, ILI9341Priority priority = ILI9341_PRIORITY_NORMAL);
+    void call(void (*function)(ILI9341& display, void* arg), void* arg, ILI9341Priority priority = ILI9341_PRIORITY_NORMAL);
+
+    uint32_t fence(void);
+    void wait(uint32_t fence);
+    void finish(void);
+    uint32_t getStalls(void);
+
+    bool process(void);
+    void run(void);
+    void close(void);
+
+  private:
+    enum Operation
+    {
+      OP_DRAW_PIXEL,
+      OP_DRAW_VLINE,
+      OP_DRAW_HLINE,
+      OP_DRAW_LINE,
+      OP_DRAW_RECTANGLE,
+      OP_FILL_RECTANGLE,
+      OP_DRAW_CIRCLE,
+      OP_FILL_CIRCLE,
+      OP_DRAW_TRIANGLE,
+      OP_FILL_TRIANGLE,
+      OP_DRAW_STRING,
+      OP_FILL_BACKGROUND,
+      OP_DRAW_BITMAP,
+      OP_DRAW_SPRITE,
+      OP_SET_SCROLL_OFFSET,
+      OP_CALL,
+      OP_FENCE
+    };
+
+    struct Command
+    {
+      uint8_t op;
+      uint8_t length;                 // Characters in text
+      int16_t x0, y0, x1, y1, x2, y2; // Coordinates, or the sizes of the operation
+      uint16_t color;
+      uint16_t backColor;
+      const void* data;               // Bitmap, sprite or call() argument
+      void (*function)(ILI9341& display, void* arg);
+      char text[ILI9341_QUEUE_TEXT];
+    };
+
+    struct Ring
+    {
+      Command commands[ILI9341_QUEUE_DEPTH];
+      uint16_t head;                  // Next command to execute
+      uint16_t count;                 // Queued commands
+    };
+
+    ILI9341& display;
+    Ring rings[2];                    // Indexed by ILI9341Priority
+    uint32_t fencesIssued;
+    uint32_t fencesDone;
+    uint32_t stalls;                  // Submissions that waited for a free slot
+    bool closed;
+#if defined(__MBED__)
+    rtos::Mutex mutex;
+    rtos::ConditionVariable changed;
+#else
+    std::mutex mutex;
+    std::condition_variable_any changed;
+#endif
+
+    static Command makeCommand(uint8_t op, int16_t x0, int16_t y0, int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint16_t color);
+    uint32_t submit(const Command& command, ILI9341Priority priority);
+    void waitChange(void);
+    bool pop(Command& command);
+    void execute(const Command& command);
+};
+#endif
@@ -0,0 +1,144 @@
+#include "ILI9341Terminal.h"
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+
+/*
+  ILI9341Terminal(ILI9341&, uint16_t, uint16_t, uint16_t, uint16_t, uint16_t) creates a terminal of rows text
+  rows starting at panel row top. The display is not touched until clear() is called.
+*/
+ILI9341Terminal::ILI9341Terminal(ILI9341& display, uint16_t top, uint16_t rows, uint16_t charSize, uint16_t foreColor, uint16_t backColor)
+  : display(display)
+{
+  this->charSize = (charSize > 0) ? charSize : 1;
+  this->top = std::min<uint16_t>(top, ILI9341_TFTHEIGHT - 8 * this->charSize);
+  this->rows = std::min<uint16_t>(rows, (ILI9341_TFTHEIGHT - this->top) / (8 * this->charSize));
+  this->rows = std::max<uint16_t>(std::min<uint16_t>(this->rows, ILI9341_TERMINAL_ROWS), 1);
+  this->foreColor = foreColor;
+  this->backColor = backColor;
+  columns = (ILI9341_TFTWIDTH + 1) / (5 * this->charSize + 1);
+  firstRow = 0;
+  usedRows = 1;
+  cursorRow = 0;
+  cursorColumn = 0;
+
+  for(uint16_t i = 0; i < ILI9341_TERMINAL_ROWS; i++)
+  {
+    rowWidth[i] = 0;
+  }
+}
+
+/*
+  void clear(void) programs the scroll area, clears the text area and puts the cursor into the top left corner.
+*/
+void ILI9341Terminal::clear(void)
+{
+  uint16_t lineHeight = 8 * charSize;
+
+  display.setScrollArea(top, ILI9341_TFTHEIGHT - top - rows * lineHeight);
+  display.fillRectangle(0, top, ILI9341_TFTWIDTH, rows * lineHeight, backColor);
+
+  firstRow = 0;
+  usedRows = 1;
+  cursorRow = 0;
+  cursorColumn = 0;
+
+  for(uint16_t i = 0; i < rows; i++)
+  {
+    rowWidth[i] = 0;
+  }
+}
+
+/*
+  void newLine(void) moves the cursor to the start of the next text row. Once all rows are used, the slot of
+  the oldest row is cleared and the scroll area is advanced by one text row so the slot shows up at the bottom.
+*/
+void ILI9341Terminal::newLine(void)
+{
+  uint16_t lineHeight = 8 * charSize;
+
+  cursorColumn = 0;
+
+  if(usedRows < rows)
+  {
+    cursorRow = usedRows++;
+    return;
+  }
+
+  cursorRow = firstRow;
+  firstRow = (firstRow + 1) % rows;
+
+  if(rowWidth[cursorRow] > 0)
+  {
+    display.fillRectangle(0, top + cursorRow * lineHeight, rowWidth[cursorRow], lineHeight, backColor);
+    rowWidth[cursorRow] = 0;
+  }
+
+  display.setScrollOffset(firstRow * lineHeight);
+}
+
+/*
+  void drawGlyph(char) draws a character at the cursor and advances it.
+*/
+void ILI9341Terminal::drawGlyph(char c)
+{
+  uint16_t pitch = 5 * charSize + 1;
+
+  display.drawChar(cursorColumn * pitch, top + cursorRow * 8 * charSize, (unsigned char)c, charSize, foreColor, backColor);
+  cursorColumn++;
+  rowWidth[cursorRow] = std::max<uint16_t>(rowWidth[cursorRow], std::min<uint16_t>(cursorColumn * pitch, ILI9341_TFTWIDTH));
+}
+
+/*
+  void putChar(char) writes a character. '\n' starts a new line, '\r' returns to the start of the line and
+  text that reaches the right edge wraps.
+*/
+void ILI9341Terminal::putChar(char c)
+{
+  if(c == '\n')
+  {
+    newLine();
+    return;
+  }
+
+  if(c == '\r')
+  {
+    cursorColumn = 0;
+    return;
+  }
+
+  if(cursorColumn >= columns)
+  {
+    newLine();
+  }
+
+  drawGlyph(c);
+}
+
+/*
+  void print(const char*) writes a string in a single write batch.
+*/
+void ILI9341Terminal::print(const char* str)
+{
+  ILI9341::WriteScope scope(display);
+
+  while(*str != '\0')
+  {
+    putChar(*str++);
+  }
+}
+
+/*
+  void printf(const char*, ...) writes formatted text (up to 127 characters per call).
+*/
+void ILI9341Terminal::printf(const char* format, ...)
+{
+  char buffer[128];
+  va_list args;
+
+  va_start(args, format);
+  vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+
+  print(buffer);
+}
@@ -0,0 +1,44 @@
+#include "ILI9341.h"
+#include <cstdint>
+
+#ifndef ILI9341_TERMINAL_ROWS
+#define ILI9341_TERMINAL_ROWS       40  // Maximum text rows of a terminal (320 / 8 at character size 1)
+#endif
+
+#ifndef ILI9341_TERMINAL_H
+#define ILI9341_TERMINAL_H
+/*
+  ILI9341Terminal is a text console on top of the hardware vertical scroll area. New lines are written into
+  the frame memory rows of the oldest line and the scroll offset is moved, so a scroll costs one VSCRSADD and
+  the new line instead of a redraw of the whole text area.
+
+  The terminal occupies full width rows of the panel in rotation 0. Call clear() once the display has been
+  initialized, and again after anything else changed the scroll area.
+*/
+class ILI9341Terminal
+{
+  public:
+    ILI9341Terminal(ILI9341& display, uint16_t top, uint16_t rows, uint16_t charSize, uint16_t foreColor, uint16_t backColor);
+    void clear(void);
+    void putChar(char c);
+    void print(const char* str);
+    void printf(const char* format, ...);
+
+  private:
+    ILI9341& display;
+    uint16_t top;                   // First panel row of the terminal
+    uint16_t rows;                  // Text rows
+    uint16_t columns;               // Characters per text row
+    uint16_t charSize;
+    uint16_t foreColor;
+    uint16_t backColor;
+    uint16_t firstRow;              // Frame memory slot shown as the top text row
+    uint16_t usedRows;              // Slots that have been written since clear()
+    uint16_t cursorRow;             // Slot receiving characters
+    uint16_t cursorColumn;
+    uint16_t rowWidth[ILI9341_TERMINAL_ROWS]; // Pixels of text left in each slot
+
+    void newLine(void);
+    void drawGlyph(char c);
+};
+#endif
@@ -0,0 +1,124 @@
+/*
+  Host benchmark of the RGB565 conversion kernels. A full screen test image is converted from each source format
+  with each dither mode; the table shows the throughput and a checksum of the converted frame. The frame drawn
+  with ILI9341DrawImage on the ILI9341Emulator must match the converted frame.
+
+  Build and run from the repository root, once with the vector kernels and once without. The checksums of
+  the two builds must be identical:
+
+    g++ -std=c++11 -O2 -I. benchmark/convertbench.cpp ILI9341.cpp ILI9341Emulator.cpp ILI9341Convert.cpp -o convertbench
+    g++ -std=c++11 -O2 -I. -DILI9341_CONVERT_SIMD=0 benchmark/convertbench.cpp ILI9341.cpp ILI9341Emulator.cpp ILI9341Convert.cpp -o convertbench_scalar
+    ./convertbench [iterations]
+*/
+#include "ILI9341.h"
+#include "ILI9341Convert.h"
+#include "ILI9341Emulator.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#define PIXELS (ILI9341_TFTWIDTH * ILI9341_TFTHEIGHT)
+
+static uint8_t rgb888[PIXELS * 3];
+static uint32_t argb8888[PIXELS];
+static uint8_t gray8[PIXELS];
+static uint16_t frame[PIXELS];
+static uint16_t check[PIXELS];
+
+/*
+  void makeImage(void) fills the source images with gradients and some noise, including saturated components.
+*/
+static void makeImage(void)
+{
+  uint32_t seed = 12345;
+
+  for(uint16_t y = 0; y < ILI9341_TFTHEIGHT; y++)
+  {
+    for(uint16_t x = 0; x < ILI9341_TFTWIDTH; x++)
+    {
+      size_t i = (size_t)y * ILI9341_TFTWIDTH + x;
+
+      seed = seed * 1103515245 + 12345;
+      uint8_t noise = (seed >> 16) & 0x0F;
+      uint8_t r = (x * 255 / (ILI9341_TFTWIDTH - 1)) | ((y & 32) ? 0 : noise);
+      uint8_t g = (y * 255 / (ILI9341_TFTHEIGHT - 1)) ^ noise;
+      uint8_t b = ((x + y) & 0xFF) | ((y > 300) ? 0xF8 : 0);
+
+      rgb888[3 * i] = r;
+      rgb888[3 * i + 1] = g;
+      rgb888[3 * i + 2] = b;
+      argb8888[i] = 0xFF000000 | (r << 16) | (g << 8) | b;
+      gray8[i] = (r * 77 + g * 150 + b * 29) >> 8;
+    }
+  }
+}
+
+/*
+  uint32_t checksum(const uint16_t*, size_t) returns the FNV-1a hash of count colors.
+*/
+static uint32_t checksum(const uint16_t* colors, size_t count)
+{
+  uint32_t hash = 2166136261u;
+
+  for(size_t i = 0; i < count; i++)
+  {
+    hash = (hash ^ (colors[i] & 0xFF)) * 16777619u;
+    hash = (hash ^ (colors[i] >> 8)) * 16777619u;
+  }
+  return hash;
+}
+
+int main(int argc, char** argv)
+{
+  int iterations = (argc > 1) ? atoi(argv[1]) : 50;
+  static const char* formatNames[] = {"rgb888", "argb8888", "gray8"};
+  static const char* ditherNames[] = {"none", "ordered", "diffusion"};
+  const void* sources[] = {rgb888, argb8888, gray8};
+  bool ok = true;
+
+  makeImage();
+
+  ILI9341Emulator emulator;
+  ILI9341 panel(emulator);
+
+  panel.initialize();
+
+  printf("kernel,format,dither,ms_per_frame,mpixels_per_s,checksum\n");
+  for(uint8_t f = 0; f < 3; f++)
+  {
+    for(uint8_t d = 0; d < 3; d++)
+    {
+      ILI9341SourceFormat format = (ILI9341SourceFormat)f;
+      ILI9341Dither dither = (ILI9341Dither)d;
+      ILI9341Converter converter(format, dither, ILI9341_TFTWIDTH);
+
+      auto start = std::chrono::steady_clock::now();
+      for(int i = 0; i < iterations; i++)
+      {
+        converter.restart(0, 0);
+        converter.convert(sources[f], frame, PIXELS);
+      }
+      std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+      double ms = elapsed.count() / iterations;
+
+      printf("%s,%s,%s,%.3f,%.1f,%08x\n", ILI9341Converter::getKernelName(), formatNames[f], ditherNames[d], ms,
+        PIXELS / ms / 1000.0, (unsigned)checksum(frame, PIXELS));
+
+      // Drawing through the driver converts in line buffer blocks and must give the same frame
+      ILI9341DrawImage(panel, 0, 0, ILI9341_TFTWIDTH, ILI9341_TFTHEIGHT, sources[f], format, dither);
+      panel.readPixels(0, 0, ILI9341_TFTWIDTH, ILI9341_TFTHEIGHT, check);
+      for(size_t i = 0; i < PIXELS; i++)
+      {
+        if(check[i] != frame[i])
+        {
+          fprintf(stderr, "convertbench: %s/%s frame drawn with ILI9341DrawImage differs at pixel %u\n", formatNames[f],
+            ditherNames[d], (unsigned)i);
+          ok = false;
+          break;
+        }
+      }
+    }
+  }
+  return ok ? 0 : 1;
+}
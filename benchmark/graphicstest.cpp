@@ -0,0 +1,862 @@
+/*
+  Host benchmark modeled on the classic graphicstest scenes. Every scene is rendered on the ILI9341Emulator
+  and the bus traffic counted by the driver statistics is reported per scene, together with the frame time
+  estimated for the emulated bus clock plus the delays the driver waited for, and the longest chip select hold, i.e. the worst case time another
+  device on the same SPI bus waits for the display.
+
+  Build and run from the repository root:
+
+    g++ -std=c++11 -O2 -DILI9341_STATS=1 -I. benchmark/graphicstest.cpp ILI9341.cpp ILI9341Emulator.cpp ILI9341DisplayList.cpp ILI9341Q565.cpp -o graphicstest
+    ./graphicstest --baseline benchmark/baseline.csv
+
+  Options:
+    --csv | --json          Output format (default csv)
+    --baseline <file>       Compare against a baseline; exit code 1 if a scene regresses, is missing or is new
+    --tolerance <percent>   Allowed slowdown before a scene counts as regressed (default 2); bus counters must not grow
+*/
+#include "ILI9341.h"
+#include "ILI9341DisplayList.h"
+#include "ILI9341Emulator.h"
+#include "ILI9341Q565.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if !ILI9341_STATS
+#error "graphicstest needs the driver statistics, build with -DILI9341_STATS=1"
+#endif
+
+#define MAX_SCENES 64
+
+struct SceneResult
+{
+  char name[32];
+  ILI9341BusStats stats;
+  uint32_t micros;
+  uint32_t holdMicros;              // Longest chip select hold
+};
+
+static ILI9341Emulator emulator;
+static SceneResult results[MAX_SCENES];
+static int resultCount = 0;
+static int sceneErrors = 0;          // Failed expect() checks
+static uint32_t randomState = 1;
+
+/*
+  uint16_t nextRandom(uint16_t) returns a reproducible pseudo random number below limit.
+*/
+static uint16_t nextRandom(uint16_t limit)
+{
+  randomState = randomState * 1103515245 + 12345;
+  return (uint16_t)((randomState >> 16) % limit);
+}
+
+/*
+  void expect(bool, const char*) reports a scene whose driver queries returned something unexpected; the run then
+  fails like a regression.
+*/
+static void expect(bool condition, const char* what)
+{
+  if(!condition)
+  {
+    fprintf(stderr, "graphicstest: unexpected result: %s\n", what);
+    sceneErrors++;
+  }
+}
+
+static void sceneSteppedInitialize(ILI9341& tft)
+{
+  uint16_t steps = 0;
+
+  tft.beginInitialize();
+  expect(!tft.isInitialized(), "initialized before the first step");
+  while(!tft.isInitialized())
+  {
+    emulator.delay(tft.initializeStep());
+    steps++;
+  }
+  expect((steps > 2) && emulator.isDisplayOn(), "stepped initialization");
+  tft.drawPixel(0, 0, WHITE);
+  expect(emulator.getPixel(0, 0) == WHITE, "pixel drawn after stepped initialization");
+}
+
+static void sceneFillScreen(ILI9341& tft)
+{
+  tft.fillBackground(BLACK);
+  tft.fillBackground(RED);
+  tft.fillBackground(GREEN);
+  tft.fillBackground(BLUE);
+  tft.fillBackground(BLACK);
+}
+
+static void sceneText(ILI9341& tft)
+{
+  const char* line = "Hello World!";
+
+  for(uint16_t size = 1; size <= 4; size++)
+  {
+    tft.drawString(0, (size - 1) * 40, line, strlen(line), size, YELLOW, BLACK);
+  }
+  tft.drawString(0, 200, "1234.56789", 10, 2, RED, RED);
+  tft.drawChar(0, 260, 'A', 3, GREEN, BLACK);
+}
+
+static void sceneTextCached(ILI9341& tft)
+{
+  tft.setGlyphCacheBudget(4096);
+  for(uint16_t i = 0; i < 20; i++)
+  {
+    tft.drawString(0, (i % 20) * 16, "0123456789", 10, 2, WHITE, BLACK);
+  }
+  tft.setGlyphCacheBudget(0);
+}
+
+static void sceneGlyphCacheStats(ILI9341& tft)
+{
+  tft.setGlyphCacheBudget(4096);
+  tft.resetGlyphCacheStats();
+  tft.drawString(0, 0, "0123456789", 10, 2, WHITE, BLACK);
+  expect((tft.getGlyphCacheMisses() == 10) && (tft.getGlyphCacheHits() == 0), "glyph cache counts of the first string");
+  tft.drawString(0, 16, "9876543210", 10, 2, WHITE, BLACK);
+  expect((tft.getGlyphCacheMisses() == 10) && (tft.getGlyphCacheHits() == 10), "glyph cache counts of the repeated glyphs");
+  tft.drawString(0, 32, "0123456789", 10, 2, YELLOW, BLACK);
+  expect(tft.getGlyphCacheMisses() == 20, "glyph cache misses of a new color");
+
+  // A budget of one glyph keeps evicting
+  tft.resetGlyphCacheStats();
+  tft.setGlyphCacheBudget(5 * 2 * 8 * 2 * ILI9341Pixel::bytes);
+  tft.drawString(0, 48, "0101", 4, 2, WHITE, BLACK);
+  expect((tft.getGlyphCacheMisses() == 4) && (tft.getGlyphCacheHits() == 0), "glyph cache counts of a one glyph budget");
+  tft.setGlyphCacheBudget(0);
+}
+
+static void sceneLines(ILI9341& tft)
+{
+  uint16_t w = ILI9341_TFTWIDTH;
+  uint16_t h = ILI9341_TFTHEIGHT;
+
+  for(uint16_t x = 0; x < w; x += 6)
+  {
+    tft.drawLine(0, 0, x, h - 1, CYAN);
+  }
+  for(uint16_t y = 0; y < h; y += 6)
+  {
+    tft.drawLine(0, 0, w - 1, y, CYAN);
+  }
+  for(uint16_t i = 0; i < 50; i++)
+  {
+    tft.drawLine(nextRandom(w), nextRandom(h), nextRandom(w), nextRandom(h), MAGENTA);
+  }
+}
+
+static void sceneThickLines(ILI9341& tft)
+{
+  for(uint16_t i = 0; i < 50; i++)
+  {
+    tft.drawLine(nextRandom(200) + 20, nextRandom(280) + 20, nextRandom(200) + 20, nextRandom(280) + 20, ORANGE, 3);
+  }
+}
+
+static void sceneFastLines(ILI9341& tft)
+{
+  for(uint16_t y = 0; y < ILI9341_TFTHEIGHT; y += 5)
+  {
+    tft.drawHLine(0, y, ILI9341_TFTWIDTH, RED);
+  }
+  for(uint16_t x = 0; x < ILI9341_TFTWIDTH; x += 5)
+  {
+    tft.drawVLine(x, 0, ILI9341_TFTHEIGHT, BLUE);
+  }
+}
+
+static void sceneRects(ILI9341& tft)
+{
+  for(uint16_t i = 2; i < 120; i += 6)
+  {
+    tft.drawRectangle(120 - i / 2, 160 - i / 2, i, i, GREEN);
+  }
+}
+
+static void sceneFilledRects(ILI9341& tft)
+{
+  for(uint16_t i = 118; i > 6; i -= 6)
+  {
+    tft.fillRectangle(120 - i / 2, 160 - i / 2, i, i, YELLOW);
+    tft.drawRectangle(120 - i / 2, 160 - i / 2, i, i, MAGENTA);
+  }
+}
+
+static void sceneFilledCircles(ILI9341& tft)
+{
+  for(uint16_t x = 10; x < ILI9341_TFTWIDTH; x += 20)
+  {
+    for(uint16_t y = 10; y < ILI9341_TFTHEIGHT; y += 20)
+    {
+      tft.fillCircle(x, y, 10, MAGENTA);
+    }
+  }
+}
+
+static void sceneCircles(ILI9341& tft)
+{
+  for(uint16_t x = 10; x < ILI9341_TFTWIDTH; x += 20)
+  {
+    for(uint16_t y = 10; y < ILI9341_TFTHEIGHT; y += 20)
+    {
+      tft.drawCircle(x, y, 10, WHITE);
+    }
+  }
+}
+
+static void sceneEllipsesArcs(ILI9341& tft)
+{
+  for(uint16_t r = 10; r < 110; r += 10)
+  {
+    tft.drawEllipse(120, 160, r, r / 2 + 5, GREEN_YELLOW);
+    tft.drawArc(120, 160, r + 5, -45, 225, CYAN);
+  }
+  tft.fillEllipse(120, 160, 50, 30, NAVY);
+}
+
+static void sceneTriangles(ILI9341& tft)
+{
+  for(uint16_t i = 0; i < 120; i += 5)
+  {
+    tft.drawTriangle(120, 160 - i, 120 - i, 160 + i, 120 + i, 160 + i, DARK_CYAN);
+  }
+}
+
+static void sceneFilledTriangles(ILI9341& tft)
+{
+  for(uint16_t i = 120; i > 10; i -= 5)
+  {
+    tft.fillTriangle(120, 160 - i, 120 - i, 160 + i, 120 + i, 160 + i, OLIVE);
+    tft.drawTriangle(120, 160 - i, 120 - i, 160 + i, 120 + i, 160 + i, MAROON);
+  }
+}
+
+// Gauge needle, arrow and a concave map region, as vertex lists
+static const ILI9341Point needle[] = {{118, 160}, {120, 40}, {122, 160}, {126, 170}, {114, 170}};
+static const ILI9341Point arrow[] = {{20, 200}, {140, 200}, {140, 180}, {220, 230}, {140, 280}, {140, 260}, {20, 260}};
+static const ILI9341Point region[] = {{10, 10}, {110, 20}, {60, 50}, {120, 90}, {90, 140}, {40, 100}, {20, 130}};
+
+/*
+  void fillFan(ILI9341&, const ILI9341Point*, uint16_t, uint16_t) fills a polygon the way it was done before
+  fillPolygon, as a fan of triangles around the first vertex (only correct for convex polygons).
+*/
+static void fillFan(ILI9341& tft, const ILI9341Point* points, uint16_t count, uint16_t color)
+{
+  for(uint16_t i = 1; i + 1 < count; i++)
+  {
+    tft.fillTriangle(points[0].x, points[0].y, points[i].x, points[i].y, points[i + 1].x, points[i + 1].y, color);
+  }
+}
+
+static void scenePolygonFans(ILI9341& tft)
+{
+  for(uint16_t i = 0; i < 10; i++)
+  {
+    fillFan(tft, needle, 5, RED);
+    fillFan(tft, arrow, 7, GREEN);
+    fillFan(tft, region, 7, BLUE);
+  }
+}
+
+static void scenePolygons(ILI9341& tft)
+{
+  static const ILI9341Point polyline[] = {{10, 300}, {60, 240}, {110, 300}, {160, 240}, {210, 300}};
+
+  for(uint16_t i = 0; i < 10; i++)
+  {
+    tft.fillPolygon(needle, 5, RED);
+    tft.fillPolygon(arrow, 7, GREEN);
+    tft.fillPolygon(region, 7, BLUE);
+  }
+  tft.fillRoundRectangle(130, 20, 100, 60, 12, NAVY);
+  tft.drawRoundRectangle(130, 90, 100, 60, 20, WHITE);
+  tft.drawPolyline(polyline, 5, ORANGE, 5);
+}
+
+static void scenePixels(ILI9341& tft)
+{
+  static uint16_t row[ILI9341_TFTWIDTH];
+
+  for(uint16_t i = 0; i < 500; i++)
+  {
+    tft.drawPixel(nextRandom(ILI9341_TFTWIDTH), nextRandom(ILI9341_TFTHEIGHT), WHITE);
+  }
+
+  for(uint16_t x = 0; x < ILI9341_TFTWIDTH; x++)
+  {
+    row[x] = (x << 8) | x;
+  }
+
+  tft.setAddrWindow(0, 100, ILI9341_TFTWIDTH, 64);
+  for(uint16_t y = 0; y < 32; y++)
+  {
+    tft.writePixels(row, ILI9341_TFTWIDTH);
+  }
+  tft.writeColor(DARK_GREEN, ILI9341_TFTWIDTH * 32);
+  tft.endWrite();
+}
+
+static void sceneBatched(ILI9341& tft)
+{
+  ILI9341::WriteScope scope(tft);
+
+  for(uint16_t i = 0; i < 200; i++)
+  {
+    tft.fillRectangle(nextRandom(220), nextRandom(300), 20, 20, nextRandom(0xFFFF));
+  }
+}
+
+static void sceneWindowCache(ILI9341& tft)
+{
+  uint32_t skipped = tft.getSkippedCommands();
+
+  // Same columns: every window after the first only sends PASET
+  for(uint16_t i = 0; i < 40; i++)
+  {
+    tft.fillRectangle(20, i * 8, 200, 8, (uint16_t)(i * 0x0821));
+  }
+  expect(tft.getSkippedCommands() - skipped == 39, "CASET commands skipped by the window cache");
+}
+
+static void sceneRotation(ILI9341& tft)
+{
+  for(uint8_t rotation = 0; rotation < 4; rotation++)
+  {
+    tft.setRotation(rotation);
+    tft.drawString(0, 0, "Rotation", 8, 2, WHITE, BLUE);
+  }
+  tft.setRotation(0);
+}
+
+static void sceneClipped(ILI9341& tft)
+{
+  tft.fillCircle(-40, 160, 80, RED);
+  tft.fillRectangle(200, -30, 100, 100, GREEN);
+  tft.drawString(-30, 300, "Partially visible", 17, 3, WHITE, BLUE);
+
+  tft.pushClipRect(40, 60, 160, 200);
+  for(uint16_t i = 0; i < 20; i++)
+  {
+    tft.drawLine(0, i * 16, 239, 319 - i * 16, CYAN);
+    tft.fillTriangle(120, i * 16 - 40, 0, 319, 239, 319, (uint16_t)(i * 0x0841));
+  }
+  tft.popClipRect();
+}
+
+static void sceneClipQueries(ILI9341& tft)
+{
+  int16_t x, y;
+  uint16_t w, h;
+
+  tft.setRotation(1);
+  expect((tft.getWidth() == ILI9341_TFTHEIGHT) && (tft.getHeight() == ILI9341_TFTWIDTH), "landscape size");
+  tft.getClipRect(x, y, w, h);
+  expect((x == 0) && (y == 0) && (w == tft.getWidth()) && (h == tft.getHeight()), "clip rectangle of a new rotation");
+
+  tft.pushClipRect(-20, 100, 100, 300);
+  tft.pushClipRect(40, 50, 100, 100);
+  tft.getClipRect(x, y, w, h);
+  expect((x == 40) && (y == 100) && (w == 40) && (h == 50), "nested clip rectangle");
+  tft.fillRectangle(x, y, w, h, GREEN);
+  tft.pushClipRect(200, 0, 10, 10);
+  tft.getClipRect(x, y, w, h);
+  expect((w == 0) && (h == 0), "empty clip rectangle");
+  tft.popClipRect();
+  tft.popClipRect();
+  tft.popClipRect();
+  tft.getClipRect(x, y, w, h);
+  expect((w == tft.getWidth()) && (h == tft.getHeight()), "clip rectangle after popping all levels");
+  tft.setRotation(0);
+}
+
+static void sceneBitmaps(ILI9341& tft)
+{
+  static uint16_t icon[32 * 32];
+  static uint8_t mask[4 * 32];
+  static const uint16_t arrowData[] =
+  {
+    ILI9341_RLE_SKIP(6), ILI9341_RLE_REPEAT(4), WHITE, ILI9341_RLE_SKIP(6),
+    ILI9341_RLE_SKIP(4), ILI9341_RLE_REPEAT(8), WHITE, ILI9341_RLE_SKIP(4),
+    ILI9341_RLE_SKIP(2), ILI9341_RLE_LITERAL(3), RED, GREEN, BLUE, ILI9341_RLE_REPEAT(6), WHITE, ILI9341_RLE_SKIP(5),
+    ILI9341_RLE_REPEAT(16), YELLOW,
+  };
+  static const ILI9341Sprite arrow = {16, 4, arrowData};
+
+  for(uint16_t y = 0; y < 32; y++)
+  {
+    for(uint16_t x = 0; x < 32; x++)
+    {
+      bool inside = ((x - 16) * (x - 16) + (y - 16) * (y - 16)) < 196;
+      icon[y * 32 + x] = inside ? (uint16_t)((x << 11) | (y << 6)) : MAGENTA;
+      if(inside)
+      {
+        mask[y * 4 + x / 8] |= 0x80 >> (x % 8);
+      }
+    }
+  }
+
+  for(uint16_t i = 0; i < 7; i++)
+  {
+    tft.drawBitmap(i * 34, 0, icon, 32, 32);
+    tft.drawBitmap(i * 34, 40, icon, 32, 32, MAGENTA);
+    tft.drawBitmap(i * 34, 80, mask, 32, 32, WHITE, NAVY);
+    tft.drawBitmap(i * 34, 120, mask, 32, 32, ORANGE, ORANGE);
+    tft.drawSprite(i * 34, 160, arrow);
+  }
+  tft.drawBitmap(224, 304, icon, 32, 32);
+}
+
+static void sceneScroll(ILI9341& tft)
+{
+  tft.setScrollArea(16, 16);
+  for(uint16_t offset = 0; offset < 288; offset += 8)
+  {
+    tft.fillRectangle(0, 16 + offset, ILI9341_TFTWIDTH, 8, (offset & 8) ? NAVY : BLACK);
+    tft.setScrollOffset(offset + 8);
+  }
+  tft.setScrollArea(0, 0);
+}
+
+static void sceneScrollOffset(ILI9341& tft)
+{
+  tft.setScrollArea(16, 16);
+  for(uint16_t offset = 0; offset < 600; offset += 50)
+  {
+    tft.setScrollOffset(offset);
+    expect(tft.getScrollOffset() == offset % (ILI9341_TFTHEIGHT - 32), "scroll offset wraps within the scroll area");
+  }
+  tft.setScrollArea(0, 0);
+  expect(tft.getScrollOffset() == 0, "scroll offset after the scroll area is removed");
+}
+
+static void sceneReadback(ILI9341& tft)
+{
+  static uint16_t block[64 * 64];
+
+  tft.readPixels(88, 128, 64, 64, block);
+  tft.setAddrWindow(0, 0, 64, 64);
+  tft.writePixels(block, 64 * 64);
+  tft.endWrite();
+}
+
+static void sceneCanvas(ILI9341& tft)
+{
+  static uint16_t band[ILI9341_TFTWIDTH * 40];
+
+  tft.setCanvas(band, 0, 140, ILI9341_TFTWIDTH, 40);
+  tft.fillRectangle(0, 140, ILI9341_TFTWIDTH, 40, NAVY);
+  tft.fillCircle(120, 160, 18, ORANGE);
+  tft.drawString(10, 150, "Canvas", 6, 2, WHITE, WHITE);
+  tft.flush();
+  tft.setCanvas(NULL, 0, 0, 0, 0);
+}
+
+/*
+  void drawDashboard(Target&) draws an overlapping gauge scene on a display or records it in a display list.
+*/
+template<typename Target>
+static void drawDashboard(Target& target)
+{
+  static const ILI9341Point pointer[] = {{116, 130}, {124, 130}, {170, 70}};
+
+  target.fillRoundRectangle(10, 10, 220, 36, 8, NAVY);
+  target.drawString(22, 22, "Speed", 5, 2, WHITE, WHITE);
+  target.fillCircle(120, 130, 70, DARK_GRAY);
+  target.drawCircle(120, 130, 72, WHITE);
+  for(uint16_t i = 0; i < 9; i++)
+  {
+    target.drawLine(120, 130, 60 + i * 15, 70, LIGHT_GRAY);
+  }
+  target.fillCircle(120, 130, 50, BLACK);
+  target.fillPolygon(pointer, 3, RED);
+  target.fillCircle(120, 130, 6, WHITE);
+  for(uint16_t i = 0; i < 6; i++)
+  {
+    target.fillRectangle(20 + i * 35, 220, 30, 80, (uint16_t)(0x07E0 + i * 0x0800));
+    target.drawRectangle(20 + i * 35, 220, 30, 80, WHITE);
+  }
+  target.fillTriangle(10, 310, 40, 250, 70, 310, ORANGE);
+  target.drawString(80, 206, "42 km/h", 7, 1, YELLOW, BLACK);
+}
+
+static void sceneDashboardDirect(ILI9341& tft)
+{
+  tft.fillBackground(PURPLE);
+  drawDashboard(tft);
+}
+
+static void sceneDashboardBanded(ILI9341& tft)
+{
+  static ILI9341DisplayList list;
+
+  list.clear();
+  list.setBackground(PURPLE);
+  drawDashboard(list);
+  list.render(tft);
+}
+
+static void sceneSharedBus(ILI9341& tft)
+{
+  static uint16_t pixels[ILI9341_TFTWIDTH * 40];
+
+  emulator.setShared(true);
+  tft.fillBackground(NAVY);
+  tft.startWrite();
+  for(uint16_t i = 0; i < 40; i++)
+  {
+    tft.fillRectangle(i * 5, i * 7, 40, 30, (uint16_t)(i * 1601));
+  }
+  tft.endWrite();
+  tft.readPixels(0, 0, ILI9341_TFTWIDTH, 40, pixels);
+  emulator.setShared(false);
+}
+
+static void sceneYieldBytes(ILI9341& tft)
+{
+  ILI9341Stats stats;
+
+  emulator.setShared(true);
+  tft.setYieldBytes(1024);
+  tft.fillBackground(NAVY);
+  tft.getStats(stats);
+  expect(stats.longestHold.dataBytes <= 1024 + ILI9341_LINE_BUFFER_PIXELS * ILI9341Pixel::bytes, "chip select hold with 1 KB yields");
+  tft.setYieldBytes(ILI9341_YIELD_BYTES);
+  emulator.setShared(false);
+}
+
+// Collects an encoded image in memory
+class BufferSink : public ILI9341CaptureSink
+{
+  public:
+    uint8_t data[65536];
+    size_t length = 0;
+
+    bool write(const uint8_t* bytes, size_t count)
+    {
+      if(length + count > sizeof(data))
+      {
+        return false;
+      }
+      memcpy(&data[length], bytes, count);
+      length += count;
+      return true;
+    }
+};
+
+// Image source on the display's bus, like a file on an SD card: it can only be read while the display is deselected
+class SharedBusSource : public ILI9341ImageSource
+{
+  public:
+    SharedBusSource(const uint8_t* data, size_t length) : reads(0), conflicts(0), memory(data, length) {}
+
+    size_t read(uint8_t* data, size_t length)
+    {
+      reads++;
+      conflicts += emulator.isSelected() ? 1 : 0;
+      return memory.read(data, length);
+    }
+
+    uint32_t reads;
+    uint32_t conflicts;             // Reads while the display held the chip select
+
+  private:
+    ILI9341MemorySource memory;
+};
+
+static void sceneQ565SharedBus(ILI9341& tft)
+{
+  static uint16_t image[160 * 120];
+  static BufferSink sink;
+  ILI9341Q565Encoder encoder(sink);
+
+  for(uint16_t y = 0; y < 120; y++)
+  {
+    for(uint16_t x = 0; x < 160; x++)
+    {
+      image[y * 160 + x] = ((x / 20 + y / 20) & 1) ? (uint16_t)((x << 11) | (y << 5) | (x ^ y)) : nextRandom(0xFFFF);
+    }
+  }
+  sink.length = 0;
+  encoder.begin(160, 120);
+  encoder.write(image, 160 * 120);
+  encoder.end();
+
+  // Drawn on its own, then inside two nested batches like a render queue call() command
+  for(uint8_t depth = 0; depth <= 2; depth += 2)
+  {
+    SharedBusSource source(sink.data, sink.length);
+
+    tft.fillRectangle(40, 100, 160, 120, BLACK);
+    emulator.setShared(true);
+    for(uint8_t i = 0; i < depth; i++)
+    {
+      tft.startWrite();
+    }
+    expect(ILI9341DrawQ565(tft, 40, 100, source), "Q565 image decoded from a shared bus source");
+    expect((source.reads > 1) && (source.conflicts == 0), (depth > 0) ? "display deselected while the Q565 source is read in a batch" : "display deselected while the Q565 source is read");
+    for(uint8_t i = 0; i < depth; i++)
+    {
+      tft.endWrite();
+    }
+    emulator.setShared(false);
+
+    bool same = true;
+    for(uint16_t y = 0; y < 120; y++)
+    {
+      for(uint16_t x = 0; x < 160; x++)
+      {
+        same &= emulator.getPixel(40 + x, 100 + y) == image[y * 160 + x];
+      }
+    }
+    expect(same, "Q565 image continued across source reads");
+  }
+}
+
+static void sceneAsync(ILI9341& tft)
+{
+  tft.setAsync(true);
+  tft.fillRectangle(0, 0, ILI9341_TFTWIDTH, 160, PURPLE);
+  while(tft.isBusy())
+  {
+  }
+  tft.flush();
+  tft.setAsync(false);
+}
+
+/*
+  void recordScene(ILI9341&, const char*, void (*)(ILI9341&)) renders one scene on the display as it is and records
+  its bus traffic and delays.
+*/
+static void recordScene(ILI9341& tft, const char* name, void (*scene)(ILI9341&))
+{
+  ILI9341Stats stats;
+  SceneResult& result = results[resultCount++];
+  uint32_t elapsedMs = emulator.getElapsedMs();
+
+  tft.resetStats();
+  scene(tft);
+  tft.getStats(stats);
+
+  strncpy(result.name, name, sizeof(result.name) - 1);
+  result.name[sizeof(result.name) - 1] = '\0';
+  result.stats = stats.total;
+  result.micros = tft.estimateMicros(stats.total) + (emulator.getElapsedMs() - elapsedMs) * 1000;
+  result.holdMicros = tft.estimateMicros(stats.longestHold);
+}
+
+/*
+  void runScene(ILI9341&, const char*, void (*)(ILI9341&)) initializes the display and records one scene, so no
+  scene depends on controller state left by the one before.
+*/
+static void runScene(ILI9341& tft, const char* name, void (*scene)(ILI9341&))
+{
+  tft.initialize();
+  recordScene(tft, name, scene);
+}
+
+/*
+  void printResults(bool) writes all scene results as CSV or JSON.
+*/
+static void printResults(bool json)
+{
+  if(json)
+  {
+    printf("[\n");
+  }
+  else
+  {
+    printf("scene,commands,data_bytes,transfers,cs_toggles,window_setups,micros,hold_micros\n");
+  }
+
+  for(int i = 0; i < resultCount; i++)
+  {
+    SceneResult& r = results[i];
+
+    if(json)
+    {
+      printf("  {\"scene\": \"%s\", \"commands\": %u, \"data_bytes\": %u, \"transfers\": %u, \"cs_toggles\": %u, \"window_setups\": %u, \"micros\": %u, \"hold_micros\": %u}%s\n",
+        r.name, r.stats.commands, r.stats.dataBytes, r.stats.transfers, r.stats.csToggles, r.stats.windowSetups, r.micros,
+        r.holdMicros, (i + 1 < resultCount) ? "," : "");
+    }
+    else
+    {
+      printf("%s,%u,%u,%u,%u,%u,%u,%u\n", r.name, r.stats.commands, r.stats.dataBytes, r.stats.transfers,
+        r.stats.csToggles, r.stats.windowSetups, r.micros, r.holdMicros);
+    }
+  }
+
+  if(json)
+  {
+    printf("]\n");
+  }
+}
+
+/*
+  bool regressed(const char*, const char*, uint32_t, uint32_t, double) reports a counter of a scene that grew by
+  more than tolerance percent over its baseline value.
+*/
+static bool regressed(const char* scene, const char* counter, uint32_t value, uint32_t baseline, double tolerance)
+{
+  if(value <= baseline * (1.0 + tolerance / 100.0))
+  {
+    return false;
+  }
+
+  fprintf(stderr, "graphicstest: %s regressed: %u %s (baseline %u)\n", scene, value, counter, baseline);
+  return true;
+}
+
+/*
+  int compareBaseline(const char*, double) compares the results against a baseline CSV written by this tool.
+  Bus counters must not grow at all; the time estimates may grow by tolerance percent. A scene that is only in
+  the baseline or only in the results counts as regressed, so the baseline has to be regenerated when scenes
+  are added or removed. Returns the number of regressed scenes, or -1 if the baseline can not be read.
+*/
+static int compareBaseline(const char* path, double tolerance)
+{
+  FILE* file = fopen(path, "r");
+  char line[256];
+  bool compared[MAX_SCENES] = {};
+  int regressions = 0;
+
+  if(file == NULL)
+  {
+    fprintf(stderr, "graphicstest: can not open baseline %s\n", path);
+    return -1;
+  }
+
+  while(fgets(line, sizeof(line), file) != NULL)
+  {
+    char name[32];
+    unsigned commands, dataBytes, transfers, csToggles, windowSetups, micros, holdMicros;
+
+    if(sscanf(line, "%31[^,],%u,%u,%u,%u,%u,%u,%u", name, &commands, &dataBytes, &transfers, &csToggles, &windowSetups, &micros, &holdMicros) != 8)
+    {
+      continue;
+    }
+
+    int i = 0;
+    while((i < resultCount) && (strcmp(results[i].name, name) != 0))
+    {
+      i++;
+    }
+
+    if(i == resultCount)
+    {
+      fprintf(stderr, "graphicstest: %s is in the baseline but was not run\n", name);
+      regressions++;
+      continue;
+    }
+
+    SceneResult& r = results[i];
+    bool worse = false;
+
+    compared[i] = true;
+    worse |= regressed(name, "commands", r.stats.commands, commands, 0);
+    worse |= regressed(name, "data bytes", r.stats.dataBytes, dataBytes, 0);
+    worse |= regressed(name, "transfers", r.stats.transfers, transfers, 0);
+    worse |= regressed(name, "chip select toggles", r.stats.csToggles, csToggles, 0);
+    worse |= regressed(name, "window setups", r.stats.windowSetups, windowSetups, 0);
+    worse |= regressed(name, "us", r.micros, micros, tolerance);
+    worse |= regressed(name, "us chip select hold", r.holdMicros, holdMicros, tolerance);
+    regressions += worse ? 1 : 0;
+  }
+
+  fclose(file);
+
+  for(int i = 0; i < resultCount; i++)
+  {
+    if(!compared[i])
+    {
+      fprintf(stderr, "graphicstest: %s is missing from the baseline\n", results[i].name);
+      regressions++;
+    }
+  }
+  return regressions;
+}
+
+int main(int argc, char** argv)
+{
+  bool json = false;
+  const char* baseline = NULL;
+  double tolerance = 2.0;
+
+  for(int i = 1; i < argc; i++)
+  {
+    if(strcmp(argv[i], "--json") == 0)
+    {
+      json = true;
+    }
+    else if(strcmp(argv[i], "--csv") == 0)
+    {
+      json = false;
+    }
+    else if((strcmp(argv[i], "--baseline") == 0) && (i + 1 < argc))
+    {
+      baseline = argv[++i];
+    }
+    else if((strcmp(argv[i], "--tolerance") == 0) && (i + 1 < argc))
+    {
+      tolerance = atof(argv[++i]);
+    }
+    else
+    {
+      fprintf(stderr, "usage: %s [--csv|--json] [--baseline file] [--tolerance percent]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  ILI9341 tft(emulator);
+
+  // Time to first pixel of a panel coming out of power-on
+  recordScene(tft, "first_pixel", [](ILI9341& display) { display.initialize(); display.drawPixel(0, 0, WHITE); });
+  runScene(tft, "initialize", [](ILI9341& display) { display.initialize(); });
+  recordScene(tft, "stepped_initialize", sceneSteppedInitialize);
+  runScene(tft, "fill_screen", sceneFillScreen);
+  runScene(tft, "text", sceneText);
+  runScene(tft, "text_cached", sceneTextCached);
+  runScene(tft, "glyph_cache_stats", sceneGlyphCacheStats);
+  runScene(tft, "lines", sceneLines);
+  runScene(tft, "thick_lines", sceneThickLines);
+  runScene(tft, "hv_lines", sceneFastLines);
+  runScene(tft, "rects", sceneRects);
+  runScene(tft, "filled_rects", sceneFilledRects);
+  runScene(tft, "filled_circles", sceneFilledCircles);
+  runScene(tft, "circles", sceneCircles);
+  runScene(tft, "ellipses_arcs", sceneEllipsesArcs);
+  runScene(tft, "triangles", sceneTriangles);
+  runScene(tft, "filled_triangles", sceneFilledTriangles);
+  runScene(tft, "polygon_fans", scenePolygonFans);
+  runScene(tft, "polygons", scenePolygons);
+  runScene(tft, "pixels", scenePixels);
+  runScene(tft, "batched_rects", sceneBatched);
+  runScene(tft, "window_cache", sceneWindowCache);
+  runScene(tft, "rotation", sceneRotation);
+  runScene(tft, "clipped", sceneClipped);
+  runScene(tft, "clip_queries", sceneClipQueries);
+  runScene(tft, "bitmaps", sceneBitmaps);
+  runScene(tft, "scroll", sceneScroll);
+  runScene(tft, "scroll_offset", sceneScrollOffset);
+  runScene(tft, "readback", sceneReadback);
+  runScene(tft, "canvas", sceneCanvas);
+  runScene(tft, "dashboard_direct", sceneDashboardDirect);
+  runScene(tft, "dashboard_banded", sceneDashboardBanded);
+  runScene(tft, "async", sceneAsync);
+  runScene(tft, "shared_bus", sceneSharedBus);
+  runScene(tft, "yield_bytes", sceneYieldBytes);
+  runScene(tft, "q565_shared_bus", sceneQ565SharedBus);
+
+  printResults(json);
+
+  if(baseline != NULL)
+  {
+    int regressions = compareBaseline(baseline, tolerance);
+    return ((regressions == 0) && (sceneErrors == 0)) ? 0 : 1;
+  }
+
+  return (sceneErrors == 0) ? 0 : 1;
+}
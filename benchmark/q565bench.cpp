@@ -0,0 +1,137 @@
+/*
+  Host benchmark of the Q565 streaming decoder against pushing the same frame raw with drawBitmap. A splash
+  screen is rendered on the ILI9341Emulator, captured as Q565 and then drawn repeatedly on a bus that discards
+  the data, so the timings show the CPU cost of the driver and decoder rather than the emulated panel.
+
+  Build and run from the repository root:
+
+    g++ -std=c++11 -O2 -I. benchmark/q565bench.cpp ILI9341.cpp ILI9341Emulator.cpp ILI9341Capture.cpp ILI9341Q565.cpp -o q565bench
+    ./q565bench [iterations]
+*/
+#include "ILI9341.h"
+#include "ILI9341Capture.h"
+#include "ILI9341Emulator.h"
+#include "ILI9341Q565.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+// Bus that accepts everything and sends nothing
+class NullBus : public ILI9341Bus
+{
+  public:
+    void begin(void) {}
+    uint32_t getFrequency(void) { return 40000000; }
+    void setReset(bool level) { (void)level; }
+    void delay(uint32_t ms) { (void)ms; }
+    void select(bool active) { (void)active; }
+    void writeCommand(uint8_t cmd) { (void)cmd; }
+    void writeData(const uint8_t* data, size_t length) { (void)data; (void)length; }
+};
+
+// Collects the captured image in memory
+class VectorSink : public ILI9341CaptureSink
+{
+  public:
+    std::vector<uint8_t> data;
+
+    bool write(const uint8_t* bytes, size_t length)
+    {
+      data.insert(data.end(), bytes, bytes + length);
+      return true;
+    }
+};
+
+static uint16_t frame[ILI9341_TFTWIDTH * ILI9341_TFTHEIGHT];
+static uint16_t check[ILI9341_TFTWIDTH * ILI9341_TFTHEIGHT];
+
+/*
+  void renderSplash(ILI9341&) draws a splash screen with gradients, flat shapes and text.
+*/
+static void renderSplash(ILI9341& tft)
+{
+  static uint16_t row[ILI9341_TFTWIDTH];
+
+  tft.setAddrWindow(0, 0, ILI9341_TFTWIDTH, ILI9341_TFTHEIGHT);
+  for(uint16_t y = 0; y < ILI9341_TFTHEIGHT; y++)
+  {
+    for(uint16_t x = 0; x < ILI9341_TFTWIDTH; x++)
+    {
+      row[x] = ((x >> 3) << 11) | ((y >> 3) << 5) | ((x + y) >> 4);
+    }
+    tft.writePixels(row, ILI9341_TFTWIDTH);
+  }
+  tft.endWrite();
+
+  tft.fillRectangle(0, 0, ILI9341_TFTWIDTH, 40, NAVY);
+  tft.drawString(10, 12, "Splash screen", 13, 2, WHITE, NAVY);
+  tft.fillCircle(120, 170, 60, ORANGE);
+  tft.drawCircle(120, 170, 70, WHITE);
+  tft.fillTriangle(20, 300, 120, 250, 220, 300, DARK_GREEN);
+  tft.drawString(40, 160, "v1.0", 4, 4, BLACK, ORANGE);
+}
+
+/*
+  double timeMs(F, int) returns the average wall time of one call of draw in milliseconds.
+*/
+template<typename F>
+static double timeMs(F draw, int iterations)
+{
+  auto start = std::chrono::steady_clock::now();
+  for(int i = 0; i < iterations; i++)
+  {
+    draw();
+  }
+  std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count() / iterations;
+}
+
+int main(int argc, char** argv)
+{
+  int iterations = (argc > 1) ? atoi(argv[1]) : 50;
+  size_t rawBytes = sizeof(frame);
+
+  // Render and capture the splash screen
+  ILI9341Emulator emulator;
+  ILI9341 panel(emulator);
+  VectorSink sink;
+
+  panel.initialize();
+  renderSplash(panel);
+  panel.readPixels(0, 0, ILI9341_TFTWIDTH, ILI9341_TFTHEIGHT, frame);
+  ILI9341Capture(panel, sink, ILI9341_CAPTURE_Q565);
+
+  // Decoding onto the emulated panel must give the same frame back
+  ILI9341MemorySource verifySource(sink.data.data(), sink.data.size());
+  panel.fillBackground(BLACK);
+  bool ok = ILI9341DrawQ565(panel, 0, 0, verifySource);
+  panel.readPixels(0, 0, ILI9341_TFTWIDTH, ILI9341_TFTHEIGHT, check);
+  for(size_t i = 0; i < ILI9341_TFTWIDTH * ILI9341_TFTHEIGHT; i++)
+  {
+    ok = ok && (check[i] == frame[i]);
+  }
+
+  NullBus bus;
+  ILI9341 tft(bus);
+  tft.initialize();
+
+  double rawMs = timeMs([&]() { tft.drawBitmap(0, 0, frame, ILI9341_TFTWIDTH, ILI9341_TFTHEIGHT); }, iterations);
+  double q565Ms = timeMs([&]()
+  {
+    ILI9341MemorySource source(sink.data.data(), sink.data.size());
+    ILI9341DrawQ565(tft, 0, 0, source);
+  }, iterations);
+
+  printf("path,stored_bytes,ratio_percent,ms_per_frame,mpixels_per_s\n");
+  printf("raw,%u,100,%.3f,%.1f\n", (unsigned)rawBytes, rawMs, ILI9341_TFTWIDTH * ILI9341_TFTHEIGHT / rawMs / 1000.0);
+  printf("q565,%u,%u,%.3f,%.1f\n", (unsigned)sink.data.size(), (unsigned)(100 * sink.data.size() / rawBytes), q565Ms,
+    ILI9341_TFTWIDTH * ILI9341_TFTHEIGHT / q565Ms / 1000.0);
+
+  if(!ok)
+  {
+    fprintf(stderr, "q565bench: decoded frame differs from the captured frame\n");
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,242 @@
+/*
+  Host test of ILI9341Blender on the emulator:
+  - translucent fills and bitmaps (the two-pixels-per-word kernels, odd widths included) match a per-component
+    reference blend for random colors, backdrops and alphas;
+  - a translucent scene gives the same frame with the display read back, with the canvas read back and with the
+    canvas as buffer backdrop;
+  - the two pixels an anti-aliased line covers per column (flat) or row (steep) add up to one full pixel.
+
+  Build and run from the repository root:
+
+    g++ -std=c++11 -O2 -I. test/blend.cpp ILI9341.cpp ILI9341Emulator.cpp ILI9341Blend.cpp -o blend
+    ./blend
+*/
+#include "ILI9341.h"
+#include "ILI9341Blend.h"
+#include "ILI9341Emulator.h"
+#include "test/check.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#define PIXELS (ILI9341_TFTWIDTH * ILI9341_TFTHEIGHT)
+#define AREA_W 199
+#define AREA_H 101
+
+static ILI9341Emulator emulator;
+static uint16_t backdrop[AREA_W * AREA_H];
+static uint16_t bitmap[AREA_W * AREA_H];
+static uint16_t canvas[PIXELS];
+static uint16_t frames[3][PIXELS];
+static uint32_t randomState = 1;
+
+/*
+  uint16_t nextRandom(uint32_t) returns a reproducible pseudo random number below limit.
+*/
+static uint16_t nextRandom(uint32_t limit)
+{
+  randomState = randomState * 1103515245 + 12345;
+  return (uint16_t)((randomState >> 8) % limit);
+}
+
+/*
+  uint16_t referenceBlend(uint16_t, uint16_t, uint8_t) blends fg over bg one component at a time with the alpha
+  steps of the blender (0-255 mapped to 0-32).
+*/
+static uint16_t referenceBlend(uint16_t fg, uint16_t bg, uint8_t alpha)
+{
+  uint32_t a = (alpha + 4) >> 3;
+  uint32_t r = ((fg >> 11) * a + (bg >> 11) * (32 - a)) >> 5;
+  uint32_t g = (((fg >> 5) & 0x3F) * a + ((bg >> 5) & 0x3F) * (32 - a)) >> 5;
+  uint32_t b = ((fg & 0x1F) * a + (bg & 0x1F) * (32 - a)) >> 5;
+
+  return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+/*
+  void checkKernels(ILI9341&) blends random fills and bitmaps over a random buffer backdrop and compares every
+  pixel with the reference.
+*/
+static void checkKernels(ILI9341& tft)
+{
+  ILI9341Blender blender(tft);
+  uint32_t mismatches = 0;
+
+  blender.setBackdrop(backdrop, 0, 0, AREA_W, AREA_H);
+
+  for(int iteration = 0; iteration < 100; iteration++)
+  {
+    uint8_t alpha = nextRandom(256);
+    uint16_t color = nextRandom(0x10000);
+    bool fill = (iteration & 1) != 0;
+
+    for(size_t i = 0; i < AREA_W * AREA_H; i++)
+    {
+      backdrop[i] = nextRandom(0x10000);
+      bitmap[i] = nextRandom(0x10000);
+    }
+
+    // A whole number of blocks per row is avoided by the odd width, so the single pixel tail is used as well
+    if(fill)
+    {
+      blender.fillRectangle(0, 0, AREA_W, AREA_H, color, alpha);
+    }
+    else
+    {
+      blender.drawBitmap(0, 0, bitmap, AREA_W, AREA_H, alpha);
+    }
+
+    for(uint16_t y = 0; y < AREA_H; y++)
+    {
+      for(uint16_t x = 0; x < AREA_W; x++)
+      {
+        uint16_t fg = fill ? color : bitmap[y * AREA_W + x];
+        uint16_t expected = ((alpha + 4) >> 3 == 0) ? emulator.getPixel(x, y) : referenceBlend(fg, backdrop[y * AREA_W + x], alpha);
+
+        if(emulator.getPixel(x, y) != expected)
+        {
+          if(mismatches++ < 5)
+          {
+            CHECK(false, "%s alpha %u: pixel %u,%u is %04x, reference %04x", fill ? "fill" : "bitmap", alpha, x, y,
+              emulator.getPixel(x, y), expected);
+          }
+        }
+      }
+    }
+  }
+
+  CHECK(mismatches == 0, "%u pixels differ from the per-component reference", (unsigned)mismatches);
+}
+
+/*
+  void drawScene(ILI9341Blender&) draws overlapping translucent primitives.
+*/
+static void drawScene(ILI9341Blender& blender)
+{
+  static const uint16_t spriteData[] =
+  {
+    ILI9341_RLE_SKIP(2), ILI9341_RLE_REPEAT(12), YELLOW, ILI9341_RLE_SKIP(2),
+    ILI9341_RLE_LITERAL(4), RED, GREEN, BLUE, WHITE, ILI9341_RLE_SKIP(8), ILI9341_RLE_REPEAT(4), CYAN,
+  };
+  static const ILI9341Sprite sprite = {16, 2, spriteData};
+
+  blender.fillRectangle(10, 10, 150, 120, RED, 128);
+  blender.fillRectangle(60, 60, 150, 120, BLUE, 96);
+  blender.drawBitmap(30, 150, bitmap, 64, 64, 200);
+  blender.drawSprite(100, 200, sprite, 160);
+  blender.fillCircle(120, 160, 60, GREEN, 100);
+  blender.drawCircle(120, 160, 80, WHITE, 220);
+  blender.drawLine(0, 0, 239, 319, YELLOW);
+  blender.drawLine(5, 300, 230, 250, CYAN, 180);
+  blender.drawLine(200, 10, 180, 300, MAGENTA, 140);
+}
+
+/*
+  void drawBase(ILI9341&) draws the opaque picture the scene is blended over.
+*/
+static void drawBase(ILI9341& tft)
+{
+  tft.fillBackground(NAVY);
+  for(uint16_t i = 0; i < 12; i++)
+  {
+    tft.fillRectangle(i * 20, 0, 10, ILI9341_TFTHEIGHT, (uint16_t)(i * 0x1863));
+  }
+  tft.drawString(10, 140, "Backdrop", 8, 3, WHITE, BLACK);
+}
+
+/*
+  void checkBackdrops(ILI9341&) renders the scene with each way of fetching the screen contents.
+*/
+static void checkBackdrops(ILI9341& tft)
+{
+  ILI9341Blender blender(tft);
+
+  // The display read back with RAMRD
+  drawBase(tft);
+  blender.setBackdropReadback();
+  drawScene(blender);
+  tft.readPixels(0, 0, ILI9341_TFTWIDTH, ILI9341_TFTHEIGHT, frames[0]);
+
+  // The canvas read back
+  tft.setCanvas(canvas, 0, 0, ILI9341_TFTWIDTH, ILI9341_TFTHEIGHT);
+  drawBase(tft);
+  drawScene(blender);
+  tft.setCanvas(NULL, 0, 0, 0, 0);
+  tft.readPixels(0, 0, ILI9341_TFTWIDTH, ILI9341_TFTHEIGHT, frames[1]);
+
+  // The canvas as buffer backdrop
+  tft.setCanvas(canvas, 0, 0, ILI9341_TFTWIDTH, ILI9341_TFTHEIGHT);
+  drawBase(tft);
+  blender.setBackdrop(canvas, 0, 0, ILI9341_TFTWIDTH, ILI9341_TFTHEIGHT);
+  drawScene(blender);
+  tft.setCanvas(NULL, 0, 0, 0, 0);
+  tft.readPixels(0, 0, ILI9341_TFTWIDTH, ILI9341_TFTHEIGHT, frames[2]);
+
+  CHECK(memcmp(frames[0], frames[1], sizeof(frames[0])) == 0, "canvas readback frame differs from display readback");
+  CHECK(memcmp(frames[0], frames[2], sizeof(frames[0])) == 0, "canvas buffer frame differs from display readback");
+}
+
+/*
+  void checkCoverage(ILI9341&) draws random green lines on black and adds up the alphas of each column (flat
+  lines) or row (steep lines), recovered from the green component.
+*/
+static void checkCoverage(ILI9341& tft)
+{
+  ILI9341Blender blender(tft);
+  int8_t alphaOfGreen[64];
+
+  // Green over black gives floor(63 * alpha / 32), which is different for every alpha of 0-32
+  memset(alphaOfGreen, -1, sizeof(alphaOfGreen));
+  for(uint8_t a = 0; a <= 32; a++)
+  {
+    alphaOfGreen[63 * a / 32] = a;
+  }
+
+  blender.setBackdrop(BLACK);
+  for(int i = 0; i < 500; i++)
+  {
+    int16_t x0 = 2 + nextRandom(ILI9341_TFTWIDTH - 4);
+    int16_t y0 = 2 + nextRandom(ILI9341_TFTHEIGHT - 4);
+    int16_t x1 = 2 + nextRandom(ILI9341_TFTWIDTH - 4);
+    int16_t y1 = 2 + nextRandom(ILI9341_TFTHEIGHT - 4);
+    bool steep = abs(y1 - y0) > abs(x1 - x0);
+
+    tft.fillBackground(BLACK);
+    blender.drawLine(x0, y0, x1, y1, GREEN);
+
+    int16_t first = steep ? std::min(y0, y1) : std::min(x0, x1);
+    int16_t last = steep ? std::max(y0, y1) : std::max(x0, x1);
+    int16_t across = steep ? ILI9341_TFTWIDTH : ILI9341_TFTHEIGHT;
+
+    for(int16_t along = first; along <= last; along++)
+    {
+      int32_t sum = 0;
+
+      for(int16_t j = 0; j < across; j++)
+      {
+        uint16_t pixel = steep ? emulator.getPixel(j, along) : emulator.getPixel(along, j);
+        int8_t alpha = alphaOfGreen[(pixel >> 5) & 0x3F];
+
+        CHECK((alpha >= 0) && ((pixel & 0xF81F) == 0), "line (%d,%d)-(%d,%d): unexpected pixel %04x", x0, y0, x1, y1, pixel);
+        sum += alpha;
+      }
+
+      if(abs(sum - 32) > 1)
+      {
+        CHECK(false, "line (%d,%d)-(%d,%d): coverage %d/32 at %d", x0, y0, x1, y1, (int)sum, along);
+        break;
+      }
+    }
+  }
+}
+
+int main(void)
+{
+  ILI9341 tft(emulator);
+
+  tft.initialize();
+  checkKernels(tft);
+  checkBackdrops(tft);
+  checkCoverage(tft);
+  return TEST_RESULT;
+}
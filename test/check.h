@@ -0,0 +1,24 @@
+#include <cstdio>
+
+#ifndef ILI9341_TEST_CHECK_H
+#define ILI9341_TEST_CHECK_H
+/*
+  Minimal assertions shared by the host tests. A failed CHECK prints its location and message and is counted;
+  main() returns TEST_RESULT, which is non-zero if any check failed.
+*/
+static int testFailures = 0;
+
+#define CHECK(condition, ...) \
+  do \
+  { \
+    if(!(condition)) \
+    { \
+      fprintf(stderr, "%s:%d: ", __FILE__, __LINE__); \
+      fprintf(stderr, __VA_ARGS__); \
+      fputc('\n', stderr); \
+      testFailures++; \
+    } \
+  } while(0)
+
+#define TEST_RESULT ((testFailures == 0) ? (printf("%s: all checks passed\n", __FILE__), 0) : 1)
+#endif
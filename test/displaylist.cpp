@@ -0,0 +1,134 @@
+/*
+  Host test of the banded display list renderer. A scene using every recorded command is drawn once directly
+  and once through ILI9341DisplayList::render(), in portrait and landscape, on the whole screen and inside a
+  clip rectangle; both must leave the same panel contents. render() must replay every command in the band it
+  reaches into and send each band through one address window.
+
+  Build and run from the repository root:
+
+    g++ -std=c++11 -O2 -DILI9341_STATS=1 -I. test/displaylist.cpp ILI9341.cpp ILI9341Emulator.cpp ILI9341DisplayList.cpp -o displaylist
+    ./displaylist
+*/
+#include "ILI9341.h"
+#include "ILI9341DisplayList.h"
+#include "ILI9341Emulator.h"
+#include "test/check.h"
+
+#if !ILI9341_STATS
+#error "the display list test needs the driver statistics, build with -DILI9341_STATS=1"
+#endif
+
+#define PIXELS (ILI9341_TFTWIDTH * ILI9341_TFTHEIGHT)
+#define COMMANDS 21
+
+static ILI9341Emulator emulator;
+static ILI9341DisplayList list;
+static uint16_t bitmap[40 * 30];
+static uint16_t direct[PIXELS];
+
+static const ILI9341Point star[] = {{60, 120}, {110, 250}, {0, 170}, {130, 170}, {20, 250}};
+static const ILI9341Point path[] = {{-10, 300}, {50, 200}, {90, 330}, {150, 210}, {250, 260}};
+
+/*
+  void drawScene(T&) draws every primitive a display list records, with commands crossing band boundaries and
+  reaching past the screen edges.
+*/
+template <typename T>
+static void drawScene(T& target)
+{
+  target.drawPixel(3, 4, WHITE);
+  target.drawVLine(200, -20, 400, YELLOW);
+  target.drawHLine(-30, 15, 300, CYAN);
+  target.drawLine(0, 0, 319, 239, RED);
+  target.drawLine(230, 10, 20, 300, GREEN, 5);
+  target.drawRectangle(10, 30, 150, 90, WHITE);
+  target.fillRectangle(40, 40, 100, 100, BLUE);
+  target.drawRoundRectangle(120, 20, 110, 70, 15, MAGENTA);
+  target.fillRoundRectangle(150, 120, 80, 60, 20, ORANGE);
+  target.drawCircle(160, 240, 70, GRAY);
+  target.fillCircle(-10, 100, 40, OLIVE);
+  target.drawArc(120, 160, 100, 30, 250, GREEN_YELLOW);
+  target.drawTriangle(5, 310, 60, 200, 120, 315, WHITE);
+  target.fillTriangle(180, 300, 240, 180, 300, 330, DARK_CYAN);
+  target.fillPolygon(star, 5, MAROON, ILI9341_FILL_EVEN_ODD);
+  target.fillPolygon(star, 5, NAVY, ILI9341_FILL_NONZERO);
+  target.drawPolyline(path, 5, LIGHT_GRAY);
+  target.drawPolyline(path, 5, PURPLE, 7);
+  target.drawString(20, 150, "Banded", 6, 2, YELLOW, BLACK);
+  target.drawString(150, 10, "ok", 2, 1, BLACK, WHITE);
+  target.drawBitmap(170, 60, bitmap, 40, 30);
+}
+
+/*
+  void checkScene(ILI9341&, const char*, int16_t, int16_t, uint16_t, uint16_t) draws the scene directly and
+  banded inside the clip rectangle (x, y, w, h) and compares the panels.
+*/
+static void checkScene(ILI9341& tft, const char* name, int16_t x, int16_t y, uint16_t w, uint16_t h)
+{
+  // Outside the clip rectangle both ways must leave the screen as it was
+  tft.fillBackground(DARK_GRAY);
+  tft.pushClipRect(x, y, w, h);
+  tft.fillRectangle(0, 0, tft.getWidth(), tft.getHeight(), DARK_GREEN);
+  drawScene(tft);
+  tft.popClipRect();
+  for(uint16_t row = 0; row < ILI9341_TFTHEIGHT; row++)
+  {
+    for(uint16_t column = 0; column < ILI9341_TFTWIDTH; column++)
+    {
+      direct[row * ILI9341_TFTWIDTH + column] = emulator.getPixel(column, row);
+    }
+  }
+
+  list.clear();
+  list.setBackground(DARK_GREEN);
+  drawScene(list);
+  CHECK(!list.hasOverflowed(), "%s: the display list overflowed", name);
+
+  ILI9341Stats stats;
+  int16_t clipX, clipY;
+  uint16_t clipW, clipH;
+
+  tft.fillBackground(DARK_GRAY);
+  tft.pushClipRect(x, y, w, h);
+  tft.getClipRect(clipX, clipY, clipW, clipH);
+  tft.resetStats();
+  uint32_t replayed = list.render(tft);
+  tft.getStats(stats);
+  tft.popClipRect();
+
+  uint16_t rows = ILI9341_DISPLAY_LIST_STRIP / tft.getWidth();
+  uint32_t bands = (clipH + rows - 1) / rows;
+
+  CHECK(replayed >= COMMANDS, "%s: %u commands replayed", name, (unsigned)replayed);
+  CHECK(stats.total.windowSetups == bands, "%s: %u windows for %u bands", name, (unsigned)stats.total.windowSetups, (unsigned)bands);
+
+  uint32_t differing = 0;
+  for(uint16_t row = 0; row < ILI9341_TFTHEIGHT; row++)
+  {
+    for(uint16_t column = 0; column < ILI9341_TFTWIDTH; column++)
+    {
+      differing += emulator.getPixel(column, row) != direct[row * ILI9341_TFTWIDTH + column];
+    }
+  }
+  CHECK(differing == 0, "%s: %u pixels differ from direct drawing", name, (unsigned)differing);
+}
+
+int main(void)
+{
+  ILI9341 tft(emulator);
+
+  for(uint16_t i = 0; i < 40 * 30; i++)
+  {
+    bitmap[i] = (uint16_t)(i * 2731);
+  }
+
+  tft.initialize();
+  checkScene(tft, "portrait", 0, 0, ILI9341_TFTWIDTH, ILI9341_TFTHEIGHT);
+  checkScene(tft, "portrait clipped", 17, 45, 190, 201);
+
+  tft.setRotation(1);
+  checkScene(tft, "landscape", 0, 0, ILI9341_TFTHEIGHT, ILI9341_TFTWIDTH);
+  checkScene(tft, "landscape clipped", 33, 7, 250, 170);
+
+  return TEST_RESULT;
+}
@@ -0,0 +1,192 @@
+/*
+  Host test of drawLine against the per-pixel Bresenham it replaced. Every line is drawn on one emulated panel
+  with the old loop (one drawPixel per step) and on another with drawLine; the panels must stay identical and
+  drawLine must not send more bus bytes for any line, and must send fewer in total.
+
+  Build and run from the repository root:
+
+    g++ -std=c++11 -O2 -DILI9341_STATS=1 -I. test/drawline.cpp ILI9341.cpp ILI9341Emulator.cpp -o drawline
+    ./drawline
+*/
+#include "ILI9341.h"
+#include "ILI9341Emulator.h"
+#include "test/check.h"
+#include <algorithm>
+#include <cstdlib>
+
+#if !ILI9341_STATS
+#error "the drawLine test needs the driver statistics, build with -DILI9341_STATS=1"
+#endif
+
+#define LINES 2000
+
+static ILI9341Emulator referencePanel;
+static ILI9341Emulator linePanel;
+static uint32_t randomState = 1;
+
+/*
+  uint16_t nextRandom(uint16_t) returns a reproducible pseudo random number below limit.
+*/
+static uint16_t nextRandom(uint16_t limit)
+{
+  randomState = randomState * 1103515245 + 12345;
+  return (uint16_t)((randomState >> 16) % limit);
+}
+
+/*
+  void referenceLine(ILI9341&, int16_t, int16_t, int16_t, int16_t, uint16_t) is drawLine as it was before runs
+  were coalesced: Bresenham with one drawPixel per step.
+*/
+static void referenceLine(ILI9341& tft, int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color)
+{
+  int dx = abs(x1 - x0);
+  int dy = abs(y1 - y0);
+  int incx = (x1 > x0) - (x1 < x0);
+  int incy = (y1 > y0) - (y1 < y0);
+  int pdx, pdy;   // Parallel step
+  int dsd, dfd;   // Delta in the slow and the fast direction
+
+  if(dx > dy)
+  {
+    pdx = incx; pdy = 0;
+    dsd = dy;
+    dfd = dx;
+  }
+  else
+  {
+    pdx = 0; pdy = incy;
+    dsd = dx;
+    dfd = dy;
+  }
+
+  int x = x0;
+  int y = y0;
+  int err = dfd / 2;
+  tft.drawPixel(x, y, color);
+
+  for(int t = 0; t < dfd; ++t)
+  {
+    err -= dsd;
+
+    if(err < 0)
+    {
+      err += dfd;
+      x += incx;
+      y += incy;
+    }
+    else
+    {
+      x += pdx;
+      y += pdy;
+    }
+
+    tft.drawPixel(x, y, color);
+  }
+}
+
+/*
+  uint32_t busBytes(ILI9341&) returns the command and data bytes sent since the last resetStats().
+*/
+static uint32_t busBytes(ILI9341& tft)
+{
+  ILI9341Stats stats;
+
+  tft.getStats(stats);
+  return stats.total.commands + stats.total.dataBytes;
+}
+
+/*
+  void checkLine(ILI9341&, ILI9341&, int16_t, int16_t, int16_t, int16_t, uint16_t, uint64_t&, uint64_t&) draws one
+  line both ways and compares the pixels around it and the bus bytes.
+*/
+static void checkLine(ILI9341& reference, ILI9341& tft, int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color, uint64_t& referenceTotal, uint64_t& lineTotal)
+{
+  // Both drivers start from the same cached address window
+  reference.drawPixel(ILI9341_TFTWIDTH - 1, ILI9341_TFTHEIGHT - 1, BLACK);
+  tft.drawPixel(ILI9341_TFTWIDTH - 1, ILI9341_TFTHEIGHT - 1, BLACK);
+
+  reference.resetStats();
+  referenceLine(reference, x0, y0, x1, y1, color);
+  uint32_t referenceBytes = busBytes(reference);
+
+  tft.resetStats();
+  tft.drawLine(x0, y0, x1, y1, color);
+  uint32_t lineBytes = busBytes(tft);
+
+  referenceTotal += referenceBytes;
+  lineTotal += lineBytes;
+  CHECK(lineBytes <= referenceBytes, "line (%d,%d)-(%d,%d): %u bus bytes, per-pixel %u", x0, y0, x1, y1, (unsigned)lineBytes, (unsigned)referenceBytes);
+
+  int16_t dx = (int16_t)ILI9341_TFTWIDTH - 1;
+  int16_t dy = (int16_t)ILI9341_TFTHEIGHT - 1;
+  for(int16_t y = std::max<int16_t>(std::min(y0, y1) - 1, 0); y <= std::min<int16_t>(std::max(y0, y1) + 1, dy); y++)
+  {
+    for(int16_t x = std::max<int16_t>(std::min(x0, x1) - 1, 0); x <= std::min<int16_t>(std::max(x0, x1) + 1, dx); x++)
+    {
+      if(linePanel.getPixel(x, y) != referencePanel.getPixel(x, y))
+      {
+        CHECK(false, "line (%d,%d)-(%d,%d): pixel %d,%d is %04x, per-pixel %04x", x0, y0, x1, y1, x, y,
+          linePanel.getPixel(x, y), referencePanel.getPixel(x, y));
+        return;
+      }
+    }
+  }
+}
+
+int main(void)
+{
+  ILI9341 reference(referencePanel);
+  ILI9341 tft(linePanel);
+  uint64_t referenceTotal = 0;
+  uint64_t lineTotal = 0;
+
+  reference.initialize();
+  tft.initialize();
+
+  // Axis-aligned lines collapse to a single window
+  for(int16_t i = 0; i < 20; i++)
+  {
+    uint64_t referenceBytes = referenceTotal;
+    uint64_t lineBytes = lineTotal;
+
+    checkLine(reference, tft, 5, 10 + i, 200, 10 + i, WHITE, referenceTotal, lineTotal);
+    checkLine(reference, tft, 10 + i, 40, 10 + i, 300, RED, referenceTotal, lineTotal);
+    CHECK(lineTotal - lineBytes < referenceTotal - referenceBytes, "axis-aligned lines are not cheaper than per-pixel");
+  }
+
+  for(int i = 0; i < LINES; i++)
+  {
+    int16_t x0 = nextRandom(ILI9341_TFTWIDTH);
+    int16_t y0 = nextRandom(ILI9341_TFTHEIGHT);
+    int16_t x1 = nextRandom(ILI9341_TFTWIDTH);
+    int16_t y1 = nextRandom(ILI9341_TFTHEIGHT);
+
+    // Some short and diagonal lines, where runs are shortest
+    if(i % 4 == 1)
+    {
+      x1 = std::min<int16_t>(x0 + nextRandom(4), ILI9341_TFTWIDTH - 1);
+      y1 = std::min<int16_t>(y0 + nextRandom(4), ILI9341_TFTHEIGHT - 1);
+    }
+    else if(i % 4 == 2)
+    {
+      int16_t d = std::min<int16_t>(ILI9341_TFTWIDTH - 1 - x0, ILI9341_TFTHEIGHT - 1 - y0);
+      x1 = x0 + d;
+      y1 = y0 + d;
+    }
+
+    checkLine(reference, tft, x0, y0, x1, y1, nextRandom(0xFFFF) + 1, referenceTotal, lineTotal);
+  }
+
+  uint32_t differing = 0;
+  for(uint16_t y = 0; y < ILI9341_TFTHEIGHT; y++)
+  {
+    for(uint16_t x = 0; x < ILI9341_TFTWIDTH; x++)
+    {
+      differing += linePanel.getPixel(x, y) != referencePanel.getPixel(x, y);
+    }
+  }
+  CHECK(differing == 0, "%u pixels of the final frames differ", (unsigned)differing);
+  CHECK(lineTotal < referenceTotal, "drawLine sent %llu bus bytes, per-pixel %llu", (unsigned long long)lineTotal, (unsigned long long)referenceTotal);
+  printf("drawLine: %llu bus bytes, per-pixel Bresenham: %llu\n", (unsigned long long)lineTotal, (unsigned long long)referenceTotal);
+  return TEST_RESULT;
+}
@@ -0,0 +1,172 @@
+/*
+  Host test of fillPolygon against a reference rasterizer. Random polygons, partly off the screen, are filled
+  with the even-odd and the nonzero rule; a pixel must be set exactly when its center is inside the outline.
+  The driver steps every edge in 1/4096 pixel with a step rounded to the nearest 1/4096, so its crossing may be
+  off by half of that for every row stepped; pixels whose center lies that close to a crossing are skipped. The
+  same polygons filled inside a random clip rectangle must give exactly the unclipped pixels inside the rectangle
+  and leave everything else untouched.
+
+  Build and run from the repository root:
+
+    g++ -std=c++11 -O2 -I. test/polygon.cpp ILI9341.cpp ILI9341Emulator.cpp -o polygon
+    ./polygon
+*/
+#include "ILI9341.h"
+#include "ILI9341Emulator.h"
+#include "test/check.h"
+#include <algorithm>
+#include <cmath>
+
+#define POLYGONS 1000
+#define MAX_POINTS 24
+
+// Where a pixel center is relative to the outline
+enum Coverage
+{
+  OUTSIDE,
+  INSIDE,
+  TIED                              // Too close to an edge to tell
+};
+
+static ILI9341Emulator emulator;
+static uint16_t frame[ILI9341_TFTWIDTH * ILI9341_TFTHEIGHT];
+static uint32_t randomState = 1;
+
+/*
+  int16_t nextRandom(int16_t, int16_t) returns a reproducible pseudo random number from low to high.
+*/
+static int16_t nextRandom(int16_t low, int16_t high)
+{
+  randomState = randomState * 1103515245 + 12345;
+  return (int16_t)(low + (int32_t)((randomState >> 8) % (uint32_t)(high - low + 1)));
+}
+
+/*
+  Coverage referenceCoverage(const ILI9341Point*, uint16_t, bool, int16_t, int16_t) tells whether the center of
+  pixel (x, y) is inside the polygon. An edge counts on the rows whose center lies in [top, bottom) and is
+  crossed by the pixels whose center is at or right of the crossing.
+*/
+static Coverage referenceCoverage(const ILI9341Point* points, uint16_t count, bool nonZero, int16_t x, int16_t y)
+{
+  double cx = x + 0.5;
+  double cy = y + 0.5;
+  int winding = 0;
+  int crossings = 0;
+
+  for(uint16_t i = 0; i < count; i++)
+  {
+    const ILI9341Point& a = points[i];
+    const ILI9341Point& b = points[(i + 1) % count];
+    int dir = (b.y > a.y) ? 1 : -1;
+    double top = std::min(a.y, b.y);
+    double bottom = std::max(a.y, b.y);
+
+    if((a.y == b.y) || (cy < top) || (cy >= bottom))
+    {
+      continue;
+    }
+
+    double crossing = a.x + (cy - a.y) * (b.x - a.x) / (b.y - a.y);
+    double tie = (cy - top + 2) / 8192;
+
+    if(fabs(crossing - cx) <= tie)
+    {
+      return TIED;
+    }
+    if(crossing <= cx)
+    {
+      winding += dir;
+      crossings++;
+    }
+  }
+
+  return (nonZero ? (winding != 0) : (crossings & 1)) ? INSIDE : OUTSIDE;
+}
+
+/*
+  uint32_t checkPolygon(const ILI9341Point*, uint16_t, bool) compares the screen with the reference and returns
+  the number of differing pixels.
+*/
+static uint32_t checkPolygon(const ILI9341Point* points, uint16_t count, bool nonZero)
+{
+  uint32_t differing = 0;
+
+  for(int16_t y = 0; y < ILI9341_TFTHEIGHT; y++)
+  {
+    for(int16_t x = 0; x < ILI9341_TFTWIDTH; x++)
+    {
+      Coverage coverage = referenceCoverage(points, count, nonZero, x, y);
+
+      if((coverage != TIED) && (emulator.getPixel(x, y) != ((coverage == INSIDE) ? WHITE : BLACK)))
+      {
+        differing++;
+      }
+    }
+  }
+
+  return differing;
+}
+
+/*
+  uint32_t checkClipped(int16_t, int16_t, int16_t, int16_t) compares the screen with the unclipped frame inside
+  the clip rectangle (x0, y0)-(x1, y1) and with black outside. Returns the number of differing pixels.
+*/
+static uint32_t checkClipped(int16_t x0, int16_t y0, int16_t x1, int16_t y1)
+{
+  uint32_t differing = 0;
+
+  for(int16_t y = 0; y < ILI9341_TFTHEIGHT; y++)
+  {
+    for(int16_t x = 0; x < ILI9341_TFTWIDTH; x++)
+    {
+      bool clipped = (x < x0) || (x > x1) || (y < y0) || (y > y1);
+
+      differing += emulator.getPixel(x, y) != (clipped ? BLACK : frame[y * ILI9341_TFTWIDTH + x]);
+    }
+  }
+
+  return differing;
+}
+
+int main(void)
+{
+  ILI9341 tft(emulator);
+  ILI9341Point points[MAX_POINTS];
+
+  tft.initialize();
+
+  for(int i = 0; i < POLYGONS; i++)
+  {
+    uint16_t count = nextRandom(3, MAX_POINTS);
+    bool nonZero = (i & 1) != 0;
+    ILI9341FillRule rule = nonZero ? ILI9341_FILL_NONZERO : ILI9341_FILL_EVEN_ODD;
+
+    // Vertices reach past every screen edge, so edges start above and left of the screen
+    for(uint16_t j = 0; j < count; j++)
+    {
+      points[j].x = nextRandom(-120, ILI9341_TFTWIDTH + 120);
+      points[j].y = nextRandom(-120, ILI9341_TFTHEIGHT + 120);
+    }
+
+    tft.fillBackground(BLACK);
+    tft.fillPolygon(points, count, WHITE, rule);
+    uint32_t differing = checkPolygon(points, count, nonZero);
+    CHECK(differing == 0, "polygon %d (%u points, %s): %u pixels differ", i, count, nonZero ? "nonzero" : "even-odd", (unsigned)differing);
+
+    // Edges entering the clip rectangle from above must cross it where they cross the screen
+    tft.readPixels(0, 0, ILI9341_TFTWIDTH, ILI9341_TFTHEIGHT, frame);
+    int16_t x = nextRandom(0, ILI9341_TFTWIDTH - 2);
+    int16_t y = nextRandom(0, ILI9341_TFTHEIGHT - 2);
+    int16_t w = nextRandom(1, ILI9341_TFTWIDTH - x);
+    int16_t h = nextRandom(1, ILI9341_TFTHEIGHT - y);
+
+    tft.fillBackground(BLACK);
+    tft.pushClipRect(x, y, w, h);
+    tft.fillPolygon(points, count, WHITE, rule);
+    tft.popClipRect();
+    differing = checkClipped(x, y, x + w - 1, y + h - 1);
+    CHECK(differing == 0, "polygon %d clipped to %d,%d %dx%d: %u pixels differ", i, x, y, w, h, (unsigned)differing);
+  }
+
+  return TEST_RESULT;
+}
@@ -0,0 +1,219 @@
+/*
+  Host test of ILI9341RenderQueue:
+  - two producer threads and a display thread give the same frame as drawing directly;
+  - urgent commands run before the normal commands queued earlier;
+  - wait(fence()) returns only once the display has been flushed;
+  - getStalls() counts a producer waiting on a full ring.
+
+  Build and run from the repository root (add -fsanitize=thread to check for data races):
+
+    g++ -std=c++11 -O2 -pthread -I. test/renderqueue.cpp ILI9341.cpp ILI9341Emulator.cpp ILI9341RenderQueue.cpp -o renderqueue
+    ./renderqueue
+*/
+#include "ILI9341.h"
+#include "ILI9341Emulator.h"
+#include "ILI9341RenderQueue.h"
+#include "test/check.h"
+#include <chrono>
+#include <string>
+#include <thread>
+
+#define STEPS 300
+
+static ILI9341Emulator queuedPanel;
+static ILI9341Emulator directPanel;
+static uint16_t bitmap[16 * 16];
+static uint16_t canvas[ILI9341_TFTWIDTH * ILI9341_TFTHEIGHT];
+static std::string order;           // Names of the call() commands in the order they ran
+
+/*
+  void drawHalf(T&, int16_t) draws a producer's part of the scene into the half of the screen starting at column
+  left. Every producer stays in its own half, so the frame does not depend on how the producers interleave.
+*/
+template <typename T>
+static void drawHalf(T& target, int16_t left)
+{
+  for(int16_t i = 0; i < STEPS; i++)
+  {
+    int16_t x = left + (i * 37) % 100;
+    int16_t y = (i * 53) % 300;
+    uint16_t color = (uint16_t)(i * 2731 + left);
+
+    switch(i % 8)
+    {
+      case 0:
+        target.fillRectangle(x, y, 20, 20, color);
+        break;
+      case 1:
+        target.drawLine(x, y, left + 119 - x % 20, 319 - y, color);
+        break;
+      case 2:
+        target.fillCircle(x + 10, y + 10, 9, color);
+        break;
+      case 3:
+        // Longer than ILI9341_QUEUE_TEXT, so it is split into several commands
+        target.drawString(left, y, "Render queue test", 17, 1, color, BLACK);
+        break;
+      case 4:
+        target.drawBitmap(x, y, bitmap, 16, 16);
+        break;
+      case 5:
+        target.fillTriangle(x, y, x + 19, y + 5, x + 3, y + 19, color);
+        break;
+      case 6:
+        target.drawRectangle(x, y, 19, 13, color);
+        break;
+      default:
+        target.drawPixel(x, y, color);
+        break;
+    }
+  }
+}
+
+/*
+  void checkFrame(void) draws both halves from two producer threads and compares the panel with direct drawing.
+*/
+static void checkFrame(void)
+{
+  ILI9341 queued(queuedPanel);
+  ILI9341 direct(directPanel);
+  ILI9341RenderQueue queue(queued);
+
+  queued.initialize();
+  direct.initialize();
+  direct.fillBackground(NAVY);
+  drawHalf(direct, 0);
+  drawHalf(direct, 120);
+
+  std::thread display(&ILI9341RenderQueue::run, &queue);
+  queue.fillBackground(NAVY);
+  queue.finish();
+  std::thread left([&queue]() { drawHalf(queue, 0); queue.finish(); });
+  std::thread right([&queue]() { drawHalf(queue, 120); queue.finish(); });
+
+  left.join();
+  right.join();
+  queue.close();
+  display.join();
+
+  uint32_t differing = 0;
+  for(uint16_t y = 0; y < ILI9341_TFTHEIGHT; y++)
+  {
+    for(uint16_t x = 0; x < ILI9341_TFTWIDTH; x++)
+    {
+      differing += queuedPanel.getPixel(x, y) != directPanel.getPixel(x, y);
+    }
+  }
+  CHECK(differing == 0, "%u pixels differ from direct drawing", (unsigned)differing);
+}
+
+/*
+  void record(ILI9341&, void*) appends the name of a call() command to the order it ran in.
+*/
+static void record(ILI9341&, void* name)
+{
+  order += (const char*)name;
+}
+
+/*
+  void checkPriority(void) queues normal commands, then urgent ones, and runs them all with process().
+*/
+static void checkPriority(void)
+{
+  ILI9341 tft(queuedPanel);
+  ILI9341RenderQueue queue(tft);
+
+  order.clear();
+  queue.call(record, (void*)"n1");
+  queue.call(record, (void*)"n2");
+  queue.call(record, (void*)"u1", ILI9341_PRIORITY_URGENT);
+  queue.call(record, (void*)"n3");
+  queue.call(record, (void*)"u2", ILI9341_PRIORITY_URGENT);
+  CHECK(queue.process(), "process() found no commands");
+  CHECK(order == "u1u2n1n2n3", "commands ran in the order %s", order.c_str());
+  CHECK(!queue.process(), "process() found commands in an empty queue");
+}
+
+/*
+  void checkBeforeFlush(ILI9341&, void*) runs on the display thread after a fill into the canvas and notes
+  whether the fill has reached the panel yet.
+*/
+static void checkBeforeFlush(ILI9341&, void* onPanel)
+{
+  *(bool*)onPanel = queuedPanel.getPixel(50, 50) == MAGENTA;
+}
+
+/*
+  void checkFence(void) fills into the canvas of the display and waits for a fence; the canvas is only sent to
+  the panel when the fence flushes the display.
+*/
+static void checkFence(void)
+{
+  ILI9341 tft(queuedPanel);
+  ILI9341RenderQueue queue(tft);
+  bool onPanelBefore = true;
+
+  tft.initialize();
+  tft.fillBackground(BLACK);
+  tft.setCanvas(canvas, 0, 0, ILI9341_TFTWIDTH, ILI9341_TFTHEIGHT);
+
+  std::thread display(&ILI9341RenderQueue::run, &queue);
+  queue.fillRectangle(40, 40, 20, 20, MAGENTA);
+  queue.call(checkBeforeFlush, &onPanelBefore);
+  queue.wait(queue.fence());
+
+  // The fence is reached after the flush, under the queue's mutex, so the panel can be read here
+  CHECK(!onPanelBefore, "the fill reached the panel before the fence");
+  CHECK(queuedPanel.getPixel(50, 50) == MAGENTA, "wait(fence()) returned before the canvas was flushed");
+
+  queue.close();
+  display.join();
+  tft.setCanvas(NULL, 0, 0, 0, 0);
+}
+
+/*
+  void checkStalls(void) fills the normal ring without a display thread, so one more command has to wait.
+*/
+static void checkStalls(void)
+{
+  ILI9341 tft(queuedPanel);
+  ILI9341RenderQueue queue(tft);
+
+  order.clear();
+  for(uint16_t i = 0; i < ILI9341_QUEUE_DEPTH; i++)
+  {
+    queue.call(record, (void*)"n");
+  }
+  CHECK(queue.getStalls() == 0, "%u stalls before the ring was full", (unsigned)queue.getStalls());
+
+  // Urgent commands have their own ring and do not wait either
+  queue.call(record, (void*)"u", ILI9341_PRIORITY_URGENT);
+  CHECK(queue.getStalls() == 0, "%u stalls for an urgent command", (unsigned)queue.getStalls());
+
+  std::thread producer([&queue]() { queue.call(record, (void*)"x"); });
+  for(int i = 0; (i < 5000) && (queue.getStalls() == 0); i++)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  CHECK(queue.getStalls() == 1, "%u stalls with a full ring", (unsigned)queue.getStalls());
+
+  // Draining the ring lets the producer queue its command
+  queue.process();
+  producer.join();
+  queue.process();
+  CHECK(order == "u" + std::string(ILI9341_QUEUE_DEPTH, 'n') + "x", "commands ran in the order %s", order.c_str());
+}
+
+int main(void)
+{
+  for(uint16_t i = 0; i < 16 * 16; i++)
+  {
+    bitmap[i] = (uint16_t)(i * 977);
+  }
+
+  checkFrame();
+  checkPriority();
+  checkFence();
+  checkStalls();
+  return TEST_RESULT;
+}
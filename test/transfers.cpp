@@ -0,0 +1,114 @@
+/*
+  Host test of the block transfers the fill primitives make. Every fill must send its pixels in line buffer
+  blocks of ILI9341_LINE_BUFFER_PIXELS, plus one transfer for each CASET/PASET range the window cache can not
+  skip, and nothing when it is clipped away.
+
+  Build and run from the repository root:
+
+    g++ -std=c++11 -O2 -DILI9341_STATS=1 -I. test/transfers.cpp ILI9341.cpp ILI9341Emulator.cpp -o transfers
+    ./transfers
+*/
+#include "ILI9341.h"
+#include "ILI9341Emulator.h"
+#include "test/check.h"
+
+#if !ILI9341_STATS
+#error "the transfer test needs the driver statistics, build with -DILI9341_STATS=1"
+#endif
+
+/*
+  uint32_t pixelBlocks(uint32_t) returns the block transfers that send count pixels.
+*/
+static uint32_t pixelBlocks(uint32_t count)
+{
+  return (count + ILI9341_LINE_BUFFER_PIXELS - 1) / ILI9341_LINE_BUFFER_PIXELS;
+}
+
+/*
+  ILI9341BusStats counters(ILI9341&, ILI9341Primitive) returns the traffic of one primitive since the last
+  resetStats().
+*/
+static ILI9341BusStats counters(ILI9341& tft, ILI9341Primitive primitive)
+{
+  ILI9341Stats stats;
+
+  tft.getStats(stats);
+  return stats.primitive[primitive];
+}
+
+int main(void)
+{
+  ILI9341Emulator emulator;
+  ILI9341 tft(emulator);
+
+  tft.initialize();
+
+  // New window: CASET and PASET data are one transfer each
+  tft.resetStats();
+  tft.fillRectangle(10, 10, 100, 50, RED);
+  ILI9341BusStats fill = counters(tft, ILI9341_PRIMITIVE_FILL_RECTANGLE);
+  CHECK(fill.transfers == 2 + pixelBlocks(100 * 50), "fillRectangle: %u transfers", (unsigned)fill.transfers);
+  CHECK(fill.windowSetups == 1, "fillRectangle: %u windows", (unsigned)fill.windowSetups);
+
+  // Same window again: both ranges are cached
+  tft.resetStats();
+  tft.fillRectangle(10, 10, 100, 50, BLUE);
+  fill = counters(tft, ILI9341_PRIMITIVE_FILL_RECTANGLE);
+  CHECK(fill.transfers == pixelBlocks(100 * 50), "cached fillRectangle: %u transfers", (unsigned)fill.transfers);
+
+  // Same columns, other rows: only PASET is sent
+  tft.resetStats();
+  tft.fillRectangle(10, 100, 100, 1, BLUE);
+  fill = counters(tft, ILI9341_PRIMITIVE_FILL_RECTANGLE);
+  CHECK(fill.transfers == 1 + pixelBlocks(100), "fillRectangle with cached columns: %u transfers", (unsigned)fill.transfers);
+
+  // Block boundaries
+  for(uint32_t count = ILI9341_LINE_BUFFER_PIXELS - 1; count <= ILI9341_LINE_BUFFER_PIXELS + 1; count++)
+  {
+    tft.resetStats();
+    tft.drawHLine(1, (int16_t)count, (uint16_t)count, GREEN);
+    ILI9341BusStats line = counters(tft, ILI9341_PRIMITIVE_DRAW_HLINE);
+    CHECK(line.transfers == 2 + pixelBlocks(count), "drawHLine of %u pixels: %u transfers", (unsigned)count, (unsigned)line.transfers);
+  }
+
+  tft.resetStats();
+  tft.drawHLine(0, 5, 200, GREEN);
+  ILI9341BusStats hline = counters(tft, ILI9341_PRIMITIVE_DRAW_HLINE);
+  CHECK(hline.transfers == 2 + pixelBlocks(200), "drawHLine: %u transfers", (unsigned)hline.transfers);
+
+  tft.resetStats();
+  tft.drawVLine(7, 0, 300, GREEN);
+  ILI9341BusStats vline = counters(tft, ILI9341_PRIMITIVE_DRAW_VLINE);
+  CHECK(vline.transfers == 2 + pixelBlocks(300), "drawVLine: %u transfers", (unsigned)vline.transfers);
+
+  // Clipped to the screen edge, then clipped away completely
+  tft.resetStats();
+  tft.drawVLine(8, 200, 300, GREEN);
+  vline = counters(tft, ILI9341_PRIMITIVE_DRAW_VLINE);
+  CHECK(vline.transfers == 2 + pixelBlocks(ILI9341_TFTHEIGHT - 200), "clipped drawVLine: %u transfers", (unsigned)vline.transfers);
+
+  tft.resetStats();
+  tft.drawHLine(-300, 5, 200, GREEN);
+  tft.drawVLine(9, 400, 10, GREEN);
+  tft.fillRectangle(20, 20, 0, 10, GREEN);
+  ILI9341Stats hidden;
+  tft.getStats(hidden);
+  CHECK(hidden.total.transfers == 0, "invisible primitives: %u transfers", (unsigned)hidden.total.transfers);
+
+  tft.resetStats();
+  tft.fillBackground(NAVY);
+  ILI9341BusStats background = counters(tft, ILI9341_PRIMITIVE_FILL_BACKGROUND);
+  CHECK(background.transfers == 2 + pixelBlocks(ILI9341_TFTWIDTH * ILI9341_TFTHEIGHT), "fillBackground: %u transfers", (unsigned)background.transfers);
+  CHECK(emulator.getPixel(100, 100) == NAVY, "fillBackground: pixel %04x", emulator.getPixel(100, 100));
+
+  // Asynchronous transfers use the same blocks
+  tft.setAsync(true);
+  tft.resetStats();
+  tft.fillBackground(MAROON);
+  tft.flush();
+  background = counters(tft, ILI9341_PRIMITIVE_FILL_BACKGROUND);
+  CHECK(background.transfers == pixelBlocks(ILI9341_TFTWIDTH * ILI9341_TFTHEIGHT), "async fillBackground: %u transfers", (unsigned)background.transfers);
+  tft.setAsync(false);
+
+  return TEST_RESULT;
+}
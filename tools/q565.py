@@ -0,0 +1,142 @@
+#!/usr/bin/env python3
+"""
+Encodes an image into the Q565 format decoded by ILI9341DrawQ565 (see ILI9341Q565.h).
+
+  q565.py splash.ppm -o splash.q565             Binary file, e.g. for an SD card
+  q565.py splash.ppm --name splash > splash.h   C array for flash, drawn through ILI9341MemorySource
+  q565.py --decode splash.q565 -o splash.ppm    Decode back to PPM for inspection
+
+Input images are read like tools/rle565.py does (binary PPM, or anything Pillow reads when it is installed).
+"""
+import argparse
+import sys
+
+from rle565 import read_image, rgb565
+
+OP_INDEX, OP_DIFF, OP_LUMA, OP_RUN, OP_RGB = 0x00, 0x40, 0x80, 0xC0, 0xFE
+RUN_MAX = 62
+
+
+def q565_hash(c):
+    return ((c >> 11) * 3 + ((c >> 5) & 0x3F) * 5 + (c & 0x1F) * 7) & 0x3F
+
+
+def wrap(value, bits):
+    half = 1 << (bits - 1)
+    return ((value + half) & ((1 << bits) - 1)) - half
+
+
+def encode(width, height, colors):
+    out = bytearray(b"q565" + bytes([width >> 8, width & 0xFF, height >> 8, height & 0xFF]))
+    table = [0] * 64
+    previous = 0
+    run = 0
+    for c in colors:
+        if c == previous:
+            run += 1
+            if run == RUN_MAX:
+                out.append(OP_RUN | (run - 1))
+                run = 0
+            continue
+        if run:
+            out.append(OP_RUN | (run - 1))
+            run = 0
+        slot = q565_hash(c)
+        if table[slot] == c:
+            out.append(OP_INDEX | slot)
+        else:
+            table[slot] = c
+            dr = wrap((c >> 11) - (previous >> 11), 5)
+            dg = wrap(((c >> 5) & 0x3F) - ((previous >> 5) & 0x3F), 6)
+            db = wrap((c & 0x1F) - (previous & 0x1F), 5)
+            if -2 <= dr <= 1 and -2 <= dg <= 1 and -2 <= db <= 1:
+                out.append(OP_DIFF | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2))
+            elif -8 <= dr - dg <= 7 and -8 <= db - dg <= 7:
+                out += bytes([OP_LUMA | (dg + 32), ((dr - dg + 8) << 4) | (db - dg + 8)])
+            else:
+                out += bytes([OP_RGB, c >> 8, c & 0xFF])
+        previous = c
+    if run:
+        out.append(OP_RUN | (run - 1))
+    return bytes(out)
+
+
+def decode(data):
+    if data[:4] != b"q565":
+        raise ValueError("not a Q565 image")
+    width = (data[4] << 8) | data[5]
+    height = (data[6] << 8) | data[7]
+    table = [0] * 64
+    color = 0
+    colors = []
+    pos = 8
+    while len(colors) < width * height:
+        op = data[pos]
+        pos += 1
+        count = 1
+        if op == OP_RGB:
+            color = (data[pos] << 8) | data[pos + 1]
+            pos += 2
+        elif op & 0xC0 == OP_INDEX:
+            color = table[op]
+        elif op & 0xC0 == OP_DIFF:
+            r = ((color >> 11) + ((op >> 4) & 3) - 2) & 0x1F
+            g = (((color >> 5) & 0x3F) + ((op >> 2) & 3) - 2) & 0x3F
+            b = ((color & 0x1F) + (op & 3) - 2) & 0x1F
+            color = (r << 11) | (g << 5) | b
+        elif op & 0xC0 == OP_LUMA:
+            dg = (op & 0x3F) - 32
+            r = ((color >> 11) + dg + (data[pos] >> 4) - 8) & 0x1F
+            g = (((color >> 5) & 0x3F) + dg) & 0x3F
+            b = ((color & 0x1F) + dg + (data[pos] & 0x0F) - 8) & 0x1F
+            pos += 1
+            color = (r << 11) | (g << 5) | b
+        else:
+            count = (op & 0x3F) + 1
+        if op & 0xC0 != OP_RUN or op == OP_RGB:
+            table[q565_hash(color)] = color
+        colors += [color] * count
+    return width, height, colors[:width * height]
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Encode images for ILI9341DrawQ565")
+    parser.add_argument("image")
+    parser.add_argument("-o", "--output", help="output file (default: C header on stdout)")
+    parser.add_argument("--name", help="C identifier of the generated array")
+    parser.add_argument("--decode", action="store_true", help="decode a Q565 file to PPM")
+    args = parser.parse_args()
+
+    if args.decode:
+        with open(args.image, "rb") as f:
+            width, height, colors = decode(f.read())
+        pixels = bytearray()
+        for c in colors:
+            pixels += bytes([((c >> 8) & 0xF8) | (c >> 13), ((c >> 3) & 0xFC) | ((c >> 9) & 3), ((c << 3) & 0xF8) | ((c >> 2) & 7)])
+        with open(args.output, "wb") as f:
+            f.write(b"P6\n%d %d\n255\n" % (width, height) + pixels)
+        return
+
+    width, height, pixels = read_image(args.image)
+    colors = [rgb565(p) for p in pixels]
+    data = encode(width, height, colors)
+    if decode(data)[2] != colors:
+        raise AssertionError("Q565 round trip failed")
+    sys.stderr.write("%s: %d bytes (%d%% of raw RGB565)\n" % (args.image, len(data), 100 * len(data) // (2 * width * height)))
+
+    if args.output:
+        with open(args.output, "wb") as f:
+            f.write(data)
+        return
+
+    name = args.name or "image"
+    out = sys.stdout
+    out.write("// Generated by tools/q565.py from %s (%dx%d)\n" % (args.image, width, height))
+    out.write("static const uint8_t %s[] =\n{\n" % name)
+    for i in range(0, len(data), 16):
+        out.write("  " + ", ".join("0x%02X" % b for b in data[i:i + 16]) + ",\n")
+    out.write("};\n")
+
+
+if __name__ == "__main__":
+    main()
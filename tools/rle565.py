@@ -0,0 +1,133 @@
+#!/usr/bin/env python3
+"""
+Packs an image into a C header for the ILI9341 driver.
+
+  rle565.py icon.ppm --name icon [--key RRGGBB] [--format rle|raw|mono] > icon.h
+
+Formats:
+  rle   ILI9341Sprite for drawSprite (default). Pixels of the --key color become skip tokens.
+  raw   RGB565 array for drawBitmap. Pass the --key color (as RGB565) to drawBitmap for transparency.
+  mono  1-bit array for drawBitmap (rows padded to bytes, MSB first); pixels brighter than 50% are set.
+
+Binary PPM (P6) is always supported; other formats are read with Pillow when it is installed.
+"""
+import argparse
+import sys
+
+COUNT_MAX = 0x3FFF
+LITERAL, REPEAT, SKIP = 0x0000, 0x4000, 0x8000
+MIN_REPEAT = 3  # A repeat token (2 words) only pays off from three equal pixels on
+
+
+def read_ppm(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    fields = []
+    pos = 0
+    while len(fields) < 4:
+        while data[pos:pos + 1].isspace():
+            pos += 1
+        if data[pos:pos + 1] == b"#":
+            pos = data.index(b"\n", pos)
+            continue
+        end = pos
+        while not data[end:end + 1].isspace():
+            end += 1
+        fields.append(data[pos:end])
+        pos = end
+    if fields[0] != b"P6" or int(fields[3]) != 255:
+        raise ValueError("only 8-bit binary PPM (P6) is supported without Pillow")
+    width, height = int(fields[1]), int(fields[2])
+    pixels = data[pos + 1:pos + 1 + width * height * 3]
+    return width, height, [tuple(pixels[i:i + 3]) for i in range(0, len(pixels), 3)]
+
+
+def read_image(path):
+    try:
+        return read_ppm(path)
+    except ValueError:
+        from PIL import Image
+        image = Image.open(path).convert("RGB")
+        return image.width, image.height, list(image.getdata())
+
+
+def rgb565(pixel):
+    r, g, b = pixel
+    return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3)
+
+
+def encode_row(row, key):
+    words = []
+    i = 0
+    while i < len(row):
+        if row[i] == key:
+            start = i
+            while i < len(row) and row[i] == key and i - start < COUNT_MAX:
+                i += 1
+            words.append(SKIP | (i - start))
+            continue
+
+        run = 1
+        while i + run < len(row) and row[i + run] == row[i] and run < COUNT_MAX:
+            run += 1
+        if run >= MIN_REPEAT:
+            words += [REPEAT | run, row[i]]
+            i += run
+            continue
+
+        start = i
+        while i < len(row) and row[i] != key and i - start < COUNT_MAX:
+            if i + MIN_REPEAT <= len(row) and len(set(row[i:i + MIN_REPEAT])) == 1:
+                break
+            i += 1
+        words += [LITERAL | (i - start)] + row[start:i]
+    return words
+
+
+def emit_array(out, ctype, name, values, per_line, digits):
+    out.write("static const %s %s[] =\n{\n" % (ctype, name))
+    for i in range(0, len(values), per_line):
+        chunk = values[i:i + per_line]
+        out.write("  " + ", ".join("0x%0*X" % (digits, v) for v in chunk) + ",\n")
+    out.write("};\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Pack an image for the ILI9341 driver")
+    parser.add_argument("image")
+    parser.add_argument("--name", required=True, help="C identifier of the generated image")
+    parser.add_argument("--key", help="transparent color as RRGGBB (rle format)")
+    parser.add_argument("--format", choices=["rle", "raw", "mono"], default="rle")
+    args = parser.parse_args()
+
+    width, height, pixels = read_image(args.image)
+    out = sys.stdout
+    out.write("// Generated by tools/rle565.py from %s (%dx%d, %s)\n" % (args.image, width, height, args.format))
+
+    if args.format == "mono":
+        stride = (width + 7) // 8
+        data = [0] * (stride * height)
+        for y in range(height):
+            for x in range(width):
+                r, g, b = pixels[y * width + x]
+                if r * 299 + g * 587 + b * 114 > 127500:
+                    data[y * stride + x // 8] |= 0x80 >> (x % 8)
+        emit_array(out, "uint8_t", args.name, data, 16, 2)
+        return
+
+    colors = [rgb565(p) for p in pixels]
+    if args.format == "raw":
+        emit_array(out, "uint16_t", args.name, colors, 12, 4)
+        return
+
+    key = rgb565(tuple(bytes.fromhex(args.key))) if args.key else None
+    words = []
+    for y in range(height):
+        words += encode_row(colors[y * width:(y + 1) * width], key)
+    emit_array(out, "uint16_t", args.name + "Data", words, 12, 4)
+    out.write("static const ILI9341Sprite %s = {%d, %d, %sData};\n" % (args.name, width, height, args.name))
+    sys.stderr.write("%s: %d words (%d%% of raw)\n" % (args.name, len(words), 100 * len(words) // (width * height)))
+
+
+if __name__ == "__main__":
+    main()